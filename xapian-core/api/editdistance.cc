@@ -8,6 +8,11 @@
  *  and David Roach, Acxiom Corporation
  *
  *  http://berghel.net/publications/asm/asm.php
+ *
+ *  EditDistanceCalculator uses the bit-parallel algorithm described in:
+ *
+ *  "A Bit-Vector Algorithm for Computing Levenshtein and Damerau Edit
+ *  Distances" by Heikki Hyyrö, Nordic Journal of Computing 10 (2003).
  */
 /* Copyright (C) 2003 Richard Boulton
  * Copyright (C) 2007,2008,2009 Olly Betts
@@ -35,6 +40,7 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
 using namespace std;
 
@@ -213,3 +219,74 @@ edit_distance_unsigned(const unsigned * ptr1, int len1,
 {
     return seqcmp_editdist<unsigned>(ptr1, len1, ptr2, len2, max_distance);
 }
+
+EditDistanceCalculator::EditDistanceCalculator(const vector<unsigned> & target_)
+    : target(target_)
+{
+    memset(peq_low, 0, sizeof(peq_low));
+    if (target.size() > 64) return;
+    for (size_t i = 0; i != target.size(); ++i) {
+	uint64_t bit = uint64_t(1) << i;
+	unsigned ch = target[i];
+	if (ch < 256) {
+	    peq_low[ch] |= bit;
+	    continue;
+	}
+	auto j = peq_high.begin();
+	while (j != peq_high.end() && j->first != ch) ++j;
+	if (j == peq_high.end()) {
+	    peq_high.push_back(make_pair(ch, bit));
+	} else {
+	    j->second |= bit;
+	}
+    }
+}
+
+int
+EditDistanceCalculator::operator()(const unsigned * ptr, int len,
+				   int max_distance) const
+{
+    int target_len = int(target.size());
+    if (target_len > 64) {
+	return edit_distance_unsigned(ptr, len, &target[0], target_len,
+				      max_distance);
+    }
+
+    int lendiff = abs(len - target_len);
+    if (lendiff > max_distance) return lendiff;
+    if (target_len == 0) return len;
+
+    // Bit i of VP (VN) is set if the vertical delta between rows i and i + 1
+    // of the current column is +1 (-1).  We only need to track the distance
+    // in the bottom row.  Bits above the target length are junk, but carries
+    // only propagate upwards so they don't affect the bits we care about.
+    const uint64_t top = uint64_t(1) << (target_len - 1);
+    uint64_t VP = ~uint64_t(0);
+    uint64_t VN = 0;
+    uint64_t D0 = 0;
+    uint64_t PM_prev = 0;
+    int score = target_len;
+    for (int j = 0; j != len; ++j) {
+	uint64_t PM = get_peq(ptr[j]);
+	// Diagonal zero deltas due to a transposition.
+	uint64_t TR = (((~D0) & PM) << 1) & PM_prev;
+	D0 = (((PM & VP) + VP) ^ VP) | PM | VN | TR;
+	uint64_t HP = VN | ~(D0 | VP);
+	uint64_t HN = D0 & VP;
+	if (HP & top) {
+	    ++score;
+	} else if (HN & top) {
+	    --score;
+	}
+	// The top row increases by one in each column.
+	uint64_t X = (HP << 1) | 1;
+	VN = X & D0;
+	VP = (HN << 1) | ~(X | D0);
+	PM_prev = PM;
+
+	// The score can only decrease by one per remaining column.
+	int lower_bound = score - (len - 1 - j);
+	if (lower_bound > max_distance) return lower_bound;
+    }
+    return score;
+}
@@ -22,6 +22,10 @@
 #ifndef XAPIAN_INCLUDED_EDITDISTANCE_H
 #define XAPIAN_INCLUDED_EDITDISTANCE_H
 
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 /** Calculate the edit distance between two sequences.
  *
  *  Edit distance is defined as the minimum number of edit operations
@@ -49,4 +53,61 @@ int edit_distance_unsigned(const unsigned* ptr1, int len1,
 			   const unsigned* ptr2, int len2,
 			   int max_distance);
 
+/** Calculate edit distances from many sequences to a fixed target.
+ *
+ *  The edit operations considered are the same as for
+ *  edit_distance_unsigned().
+ *
+ *  If the target is at most 64 characters long, this uses the bit-parallel
+ *  algorithm described in "A Bit-Vector Algorithm for Computing Levenshtein
+ *  and Damerau Edit Distances" by Heikki Hyyrö, which processes a whole
+ *  column of the dynamic programming matrix in a few word operations, so the
+ *  cost is linear in the length of the sequence being compared.  The
+ *  per-character bitmasks are built once by the constructor and reused for
+ *  every sequence compared.  Longer targets fall back to
+ *  edit_distance_unsigned().
+ */
+class EditDistanceCalculator {
+    /// Don't allow assignment.
+    void operator=(const EditDistanceCalculator &);
+
+    /// Don't allow copying.
+    EditDistanceCalculator(const EditDistanceCalculator &);
+
+    /// The target sequence.
+    std::vector<unsigned> target;
+
+    /// Bitmasks of the positions in target of each character < 256.
+    uint64_t peq_low[256];
+
+    /// Bitmasks of the positions in target of each character >= 256.
+    std::vector<std::pair<unsigned, uint64_t>> peq_high;
+
+    /// Return the bitmask of the positions of @a ch in the target.
+    uint64_t get_peq(unsigned ch) const {
+	if (ch < 256) return peq_low[ch];
+	for (auto i = peq_high.begin(); i != peq_high.end(); ++i) {
+	    if (i->first == ch) return i->second;
+	}
+	return 0;
+    }
+
+  public:
+    /// Construct for target sequence @a target_.
+    explicit EditDistanceCalculator(const std::vector<unsigned> & target_);
+
+    /** Calculate the edit distance from a sequence to the target.
+     *
+     *  @param ptr A pointer to the start of the sequence.
+     *  @param len The length of the sequence.
+     *  @param max_distance The greatest edit distance that's interesting to
+     *			us.  As for edit_distance_unsigned(), if the true
+     *			edit distance is > max_distance, any value >
+     *			max_distance may be returned instead.
+     *
+     *  @return The edit distance from the sequence to the target.
+     */
+    int operator()(const unsigned * ptr, int len, int max_distance) const;
+};
+
 #endif // XAPIAN_INCLUDED_EDITDISTANCE_H
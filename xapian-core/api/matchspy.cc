@@ -25,6 +25,7 @@
 
 #include <xapian/document.h>
 #include <xapian/error.h>
+#include <xapian/mset.h>
 #include <xapian/queryparser.h>
 #include <xapian/registry.h>
 
@@ -297,18 +298,105 @@ get_most_frequent_items(vector<StringAndFrequency> & result,
     }
 }
 
+void
+ValueCountMatchSpy::Internal::count(const string & val)
+{
+    // Runs of documents with the same value are common (e.g. when the
+    // database was built in order of the faceted field), so check against
+    // the last value first to avoid hashing it.
+    if (last_ordinal != doccount(-1) && val == last_value) {
+	++counts[last_ordinal];
+	return;
+    }
+    auto r = ordinals.insert(make_pair(val, doccount(counts.size())));
+    if (r.second) {
+	counts.push_back(1);
+    } else {
+	++counts[r.first->second];
+    }
+    last_ordinal = r.first->second;
+    last_value = val;
+}
+
+void
+ValueCountMatchSpy::Internal::fold_counts()
+{
+    for (auto i = ordinals.begin(); i != ordinals.end(); ++i) {
+	doccount & c = counts[i->second];
+	if (c) {
+	    values[i->first] += c;
+	    c = 0;
+	}
+    }
+}
+
 void
 ValueCountMatchSpy::operator()(const Document &doc, double) {
     Assert(internal.get());
     ++(internal->total);
+    if (internal->sample_stride > 1 &&
+	internal->total > internal->sample_exact &&
+	(internal->total - internal->sample_exact) % internal->sample_stride) {
+	return;
+    }
+    ++(internal->sampled);
+    // The matcher passes a document which reads values from streams over
+    // each slot, so this is a sequential read rather than a lookup.  We
+    // count into a flat array indexed by a per-spy ordinal for each value,
+    // and only build the sorted map when the results are asked for.
     string val(doc.get_value(internal->slot));
-    if (!val.empty()) ++(internal->values[val]);
+    if (!val.empty()) internal->count(val);
+}
+
+void
+ValueCountMatchSpy::set_sampling(doccount exact, doccount stride)
+{
+    Assert(internal.get());
+    if (stride == 0)
+	throw InvalidArgumentError("ValueCountMatchSpy sampling stride must be > 0");
+    internal->sample_exact = exact;
+    internal->sample_stride = stride;
+}
+
+doccount
+ValueCountMatchSpy::get_value_freq_lower_bound(const string & value) const
+{
+    Assert(internal.get());
+    internal->fold_counts();
+    auto i = internal->values.find(value);
+    return i == internal->values.end() ? 0 : i->second;
+}
+
+doccount
+ValueCountMatchSpy::get_value_freq_upper_bound(const string & value,
+					       const MSet & mset) const
+{
+    doccount lb = get_value_freq_lower_bound(value);
+    // Any matching document whose value wasn't counted could have this value.
+    doccount uncounted = mset.get_matches_upper_bound();
+    if (uncounted <= internal->sampled) return lb;
+    uncounted -= internal->sampled;
+    return lb + uncounted;
+}
+
+doccount
+ValueCountMatchSpy::get_value_freq_estimated(const string & value,
+					     const MSet & mset) const
+{
+    doccount lb = get_value_freq_lower_bound(value);
+    if (lb == 0 || internal->sampled == 0) return lb;
+    double est = double(lb) * mset.get_matches_estimated() / internal->sampled;
+    doccount result = static_cast<doccount>(est + 0.5);
+    if (result < lb) return lb;
+    doccount ub = get_value_freq_upper_bound(value, mset);
+    return result > ub ? ub : result;
 }
 
 TermIterator
 ValueCountMatchSpy::values_begin() const
 {
     Assert(internal.get());
+    internal->fold_counts();
     return Xapian::TermIterator(new ValueCountTermList(internal.get()));
 }
 
@@ -316,6 +404,7 @@ TermIterator
 ValueCountMatchSpy::top_values_begin(size_t maxvalues) const
 {
     Assert(internal.get());
+    internal->fold_counts();
     AutoPtr<StringAndFreqTermList> termlist(new StringAndFreqTermList);
     get_most_frequent_items(termlist->values, internal->values, maxvalues);
     termlist->init();
@@ -325,7 +414,10 @@ ValueCountMatchSpy::top_values_begin(size_t maxvalues) const
 MatchSpy *
 ValueCountMatchSpy::clone() const {
     Assert(internal.get());
-    return new ValueCountMatchSpy(internal->slot);
+    ValueCountMatchSpy * spy = new ValueCountMatchSpy(internal->slot);
+    spy->internal->sample_exact = internal->sample_exact;
+    spy->internal->sample_stride = internal->sample_stride;
+    return spy;
 }
 
 string
@@ -338,6 +430,10 @@ ValueCountMatchSpy::serialise() const {
     Assert(internal.get());
     string result;
     result += encode_length(internal->slot);
+    if (internal->sample_stride > 1) {
+	result += encode_length(internal->sample_exact);
+	result += encode_length(internal->sample_stride);
+    }
     return result;
 }
 
@@ -349,19 +445,28 @@ ValueCountMatchSpy::unserialise(const string & s, const Registry &) const
 
     valueno new_slot;
     decode_length(&p, end, new_slot);
+    AutoPtr<ValueCountMatchSpy> spy(new ValueCountMatchSpy(new_slot));
+    if (p != end) {
+	decode_length(&p, end, spy->internal->sample_exact);
+	decode_length(&p, end, spy->internal->sample_stride);
+	if (spy->internal->sample_stride == 0)
+	    throw NetworkError("Bad sample stride in serialised ValueCountMatchSpy");
+    }
     if (p != end) {
 	throw NetworkError("Junk at end of serialised ValueCountMatchSpy");
     }
 
-    return new ValueCountMatchSpy(new_slot);
+    return spy.release();
 }
 
 string
 ValueCountMatchSpy::serialise_results() const {
     LOGCALL(REMOTE, string, "ValueCountMatchSpy::serialise_results", NO_ARGS);
     Assert(internal.get());
+    internal->fold_counts();
     string result;
     result += encode_length(internal->total);
+    result += encode_length(internal->sampled);
     result += encode_length(internal->values.size());
     for (map<string, doccount>::const_iterator i = internal->values.begin();
 	 i != internal->values.end(); ++i) {
@@ -382,6 +487,8 @@ ValueCountMatchSpy::merge_results(const string & s) {
     Xapian::doccount n;
     decode_length(&p, end, n);
     internal->total += n;
+    decode_length(&p, end, n);
+    internal->sampled += n;
 
     map<string, doccount>::size_type items;
     decode_length(&p, end, items);
@@ -403,6 +510,7 @@ string
 ValueCountMatchSpy::get_description() const {
     string d = "ValueCountMatchSpy(";
     if (internal.get()) {
+	internal->fold_counts();
 	d += str(internal->total);
 	d += " docs seen, looking in ";
 	d += str(internal->values.size());
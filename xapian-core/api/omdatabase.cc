@@ -579,7 +579,70 @@ Database::get_spelling_suggestion(const string &word,
 {
     LOGCALL(API, string, "Database::get_spelling_suggestion", word | max_edit_distance);
     if (word.size() <= 1) return string();
+
+    // Convert word to UTF-32.
+    // Extra brackets needed to avoid this being misparsed as a function
+    // prototype.
+    vector<unsigned> utf32_word((Utf8Iterator(word)), Utf8Iterator());
+    EditDistanceCalculator edcalc(utf32_word);
+
+    vector<unsigned> utf32_term;
+
     AutoPtr<TermList> merger;
+    if (max_edit_distance >= 1) {
+	// If all the databases have a deletion index, we can find all
+	// candidates within one edit cheaply.  The best suggestion is always
+	// one with the smallest edit distance, so if there are any such
+	// candidates we needn't look further.
+	bool usable = true;
+	for (size_t i = 0; i < internal.size(); ++i) {
+	    TermList * tl = internal[i]->open_spelling_deletion_termlist(word);
+	    if (!tl) {
+		usable = false;
+		break;
+	    }
+	    if (merger.get()) {
+		merger.reset(new OrTermList(merger.release(), tl));
+	    } else {
+		merger.reset(tl);
+	    }
+	}
+
+	if (usable && merger.get()) {
+	    string result;
+	    Xapian::doccount freq_best = 0;
+	    Xapian::doccount freq_exact = 0;
+	    while (true) {
+		TermList *ret = merger->next();
+		if (ret) merger.reset(ret);
+
+		if (merger->at_end()) break;
+
+		string term = merger->get_termname();
+		utf32_term.assign(Utf8Iterator(term), Utf8Iterator());
+		int edist = edcalc(&utf32_term[0], int(utf32_term.size()), 1);
+		LOGLINE(SPELLING, "Term \"" << term << "\" edit distance " << edist);
+		if (edist > 1) continue;
+
+		Xapian::doccount freq = 0;
+		for (size_t j = 0; j < internal.size(); ++j)
+		    freq += internal[j]->get_spelling_frequency(term);
+		if (edist == 0) {
+		    freq_exact = freq;
+		} else if (freq > freq_best) {
+		    result = term;
+		    freq_best = freq;
+		}
+	    }
+	    if (!result.empty() || max_edit_distance == 1) {
+		if (freq_best < freq_exact)
+		    RETURN(string());
+		RETURN(result);
+	    }
+	}
+	merger.reset();
+    }
+
     for (size_t i = 0; i < internal.size(); ++i) {
 	TermList * tl = internal[i]->open_spelling_termlist(word);
 	LOGLINE(SPELLING, "Sub db " << i << " tl = " << (void*)tl);
@@ -593,13 +656,6 @@ Database::get_spelling_suggestion(const string &word,
     }
     if (!merger.get()) RETURN(string());
 
-    // Convert word to UTF-32.
-    // Extra brackets needed to avoid this being misparsed as a function
-    // prototype.
-    vector<unsigned> utf32_word((Utf8Iterator(word)), Utf8Iterator());
-
-    vector<unsigned> utf32_term;
-
     Xapian::termcount best = 1;
     string result;
     int edist_best = max_edit_distance;
@@ -644,11 +700,8 @@ Database::get_spelling_suggestion(const string &word,
 		continue;
 	    }
 
-	    int edist = edit_distance_unsigned(&utf32_term[0],
-					       int(utf32_term.size()),
-					       &utf32_word[0],
-					       int(utf32_word.size()),
-					       edist_best);
+	    int edist = edcalc(&utf32_term[0], int(utf32_term.size()),
+			       edist_best);
 	    LOGLINE(SPELLING, "Edit distance " << edist);
 
 	    if (edist <= edist_best) {
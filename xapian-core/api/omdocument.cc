@@ -347,12 +347,14 @@ Xapian::Document::Internal::add_posting(const string & tname, Xapian::termpos tp
     need_terms();
     positions_modified = true;
 
+    // Find the insertion point with a single lookup, and construct any new
+    // entry in place rather than copying an OmDocumentTerm (and its
+    // positions) into the map.
     map<string, OmDocumentTerm>::iterator i;
-    i = terms.find(tname);
-    if (i == terms.end()) {
-	OmDocumentTerm newterm(wdfinc);
-	newterm.add_position(tpos);
-	terms.insert(make_pair(tname, newterm));
+    i = terms.lower_bound(tname);
+    if (i == terms.end() || i->first != tname) {
+	i = terms.emplace_hint(i, tname, OmDocumentTerm(wdfinc));
+	i->second.add_position(tpos);
     } else {
 	i->second.add_position(tpos);
 	if (wdfinc) i->second.inc_wdf(wdfinc);
@@ -365,10 +367,9 @@ Xapian::Document::Internal::add_term(const string & tname, Xapian::termcount wdf
     need_terms();
 
     map<string, OmDocumentTerm>::iterator i;
-    i = terms.find(tname);
-    if (i == terms.end()) {
-	OmDocumentTerm newterm(wdfinc);
-	terms.insert(make_pair(tname, newterm));
+    i = terms.lower_bound(tname);
+    if (i == terms.end() || i->first != tname) {
+	terms.emplace_hint(i, tname, OmDocumentTerm(wdfinc));
     } else {
 	if (wdfinc) i->second.inc_wdf(wdfinc);
     }
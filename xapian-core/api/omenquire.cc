@@ -332,6 +332,22 @@ MSet::snippet(const string & text,
 			     hi_start, hi_end, omit);
 }
 
+string
+MSet::snippet(const string & text,
+	      Xapian::docid did,
+	      Xapian::valueno slot,
+	      size_t length,
+	      const Xapian::Stem & stemmer,
+	      unsigned flags,
+	      const string & hi_start,
+	      const string & hi_end,
+	      const string & omit) const
+{
+    Assert(internal.get() != 0);
+    return internal->snippet(text, did, slot, length, stemmer, flags,
+			     hi_start, hi_end, omit);
+}
+
 Xapian::doccount
 MSet::size() const
 {
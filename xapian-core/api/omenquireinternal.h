@@ -34,6 +34,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <list>
 #include <map>
 #include <set>
 #include <unordered_map>
@@ -224,6 +225,44 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 
 	mutable std::unordered_map<std::string, double> snippet_bg_relevance;
 
+	/** Analysis of the query for snippet().
+	 *
+	 *  This only depends on the query and the weighting statistics, so we
+	 *  build it on the first call to snippet() and reuse it for the other
+	 *  documents in the MSet.
+	 */
+	struct SnippetQueryInfo {
+	    /// Has this been built yet?
+	    bool built = false;
+
+	    /// The query it was built from, so we notice if that changes.
+	    Xapian::Query query;
+
+	    /// The tight phrases of terms in the query.
+	    std::list<std::vector<std::string>> exact_phrases;
+
+	    /// Map from each query term with weight information to its index
+	    /// in term_relevance.
+	    std::unordered_map<std::string, size_t> loose_terms;
+
+	    /// The initial relevance of each term in loose_terms.
+	    std::vector<double> term_relevance;
+
+	    /// Wildcard patterns in the query.
+	    std::list<std::string> wildcards;
+
+	    /// Length of the longest phrase in exact_phrases.
+	    size_t longest_phrase = 0;
+
+	    /// Bounds on the termweights of the query terms.
+	    double min_tw = 0, max_tw = 0;
+	};
+
+	mutable SnippetQueryInfo snippet_query_info;
+
+	/// Return snippet_query_info, (re)building it if necessary.
+	const SnippetQueryInfo & get_snippet_query_info() const;
+
     public:
 	/// Xapian::Enquire reference, for getting documents.
 	Xapian::Internal::intrusive_ptr<const Enquire::Internal> enquire;
@@ -300,7 +339,29 @@ class MSet::Internal : public Xapian::Internal::intrusive_base {
 	/// Converts a weight to a percentage weight
 	int convert_to_percent_internal(double wt) const;
 
+	/** Generate a snippet from the part of @a text between byte offsets
+	 *  @a text_start and @a text_end.
+	 *
+	 *  Offsets in the snippet are still relative to the start of @a text,
+	 *  so whether the snippet starts or ends mid-sentence is judged on
+	 *  the whole text.
+	 */
 	std::string snippet(const std::string & text, size_t length,
+			    const Xapian::Stem & stemmer,
+			    unsigned flags,
+			    const std::string & hi_start,
+			    const std::string & hi_end,
+			    const std::string & omit,
+			    size_t text_start = 0,
+			    size_t text_end = std::string::npos) const;
+
+	/** Generate a snippet using the term offsets stored in value slot
+	 *  @a slot of document @a did to find where to look in @a text.
+	 */
+	std::string snippet(const std::string & text,
+			    Xapian::docid did,
+			    Xapian::valueno slot,
+			    size_t length,
 			    const Xapian::Stem & stemmer,
 			    unsigned flags,
 			    const std::string & hi_start,
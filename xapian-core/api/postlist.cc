@@ -40,6 +40,12 @@ PostingIterator::Internal::get_termfreq_est_using_stats(
      "get_termfreq_est_using_stats() not meaningful for this PostingIterator");
 }
 
+double
+PostingIterator::Internal::get_cost_est() const
+{
+    return get_termfreq_est();
+}
+
 Xapian::termcount
 PostingIterator::Internal::get_wdf() const
 {
@@ -58,6 +64,12 @@ PostingIterator::Internal::get_collapse_key() const
     return NULL;
 }
 
+const DocIdBitmap *
+PostingIterator::Internal::get_bitmap() const
+{
+    return NULL;
+}
+
 PositionList *
 PostList::read_position_list()
 {
@@ -31,6 +31,7 @@
 #include "backends/positionlist.h"
 #include "weight/weightinternal.h"
 
+class DocIdBitmap;
 class OrPositionList;
 
 /// Abstract base class for postlists.
@@ -73,6 +74,18 @@ class Xapian::PostingIterator::Internal : public Xapian::Internal::intrusive_bas
     virtual TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
+    /** Get an estimate of the cost of iterating this postlist with next().
+     *
+     *  The cost is measured in postings read, so for a postlist which reads
+     *  a list of exactly the documents it matches it's the termfreq.  This
+     *  is used to pick which postlist drives an AND - a postlist with a
+     *  small termfreq but a high cost (such as a value range, which has to
+     *  scan every value in the slot) is better used only via check().
+     *
+     *  The default implementation returns get_termfreq_est().
+     */
+    virtual double get_cost_est() const;
+
     /// Return an upper bound on what get_weight() can return.
     virtual double get_maxweight() const = 0;
 
@@ -107,6 +120,14 @@ class Xapian::PostingIterator::Internal : public Xapian::Internal::intrusive_bas
      */
     virtual const std::string * get_collapse_key() const;
 
+    /** If this postlist iterates a bitmap of docids, return it.
+     *
+     *  This is implemented by BitmapPostList, so that the query optimiser
+     *  can combine boolean filters as bitmaps.  Other subclasses rely on the
+     *  default implementation which just returns NULL.
+     */
+    virtual const DocIdBitmap * get_bitmap() const;
+
     /// Return true if the current position is past the last entry in this list.
     virtual bool at_end() const = 0;
 
@@ -28,13 +28,16 @@
 #include "xapian/query.h"
 
 #include "leafpostlist.h"
+#include "backends/bitmappostlist.h"
 #include "matcher/andmaybepostlist.h"
 #include "matcher/andnotpostlist.h"
+#include "matcher/blockorpostlist.h"
 #include "emptypostlist.h"
 #include "matcher/exactphrasepostlist.h"
 #include "matcher/externalpostlist.h"
 #include "matcher/maxpostlist.h"
 #include "matcher/multiandpostlist.h"
+#include "matcher/multiorpostlist.h"
 #include "matcher/multixorpostlist.h"
 #include "matcher/nearpostlist.h"
 #include "matcher/orpospostlist.h"
@@ -54,6 +57,7 @@
 #include "unicode/description_append.h"
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <list>
 #include <string>
@@ -143,6 +147,14 @@ class Context {
     }
 
     void reset();
+
+    /** Combine any postlists which are bitmaps.
+     *
+     *  If at least two of the postlists are bitmaps, they're replaced by a
+     *  single BitmapPostList for the result of combining them with @a op.
+     *  This may reorder the postlists.
+     */
+    void combine_bitmaps(QueryOptimiser * qopt, DocIdBitmap::op op);
 };
 
 Context::Context(size_t reserve) {
@@ -161,6 +173,28 @@ Context::~Context()
     reset();
 }
 
+void
+Context::combine_bitmaps(QueryOptimiser * qopt, DocIdBitmap::op op)
+{
+    auto b = partition(pls.begin(), pls.end(),
+		       [](const PostList * pl) { return !pl->get_bitmap(); });
+    if (pls.end() - b < 2)
+	return;
+
+    // For AND, start with the smallest bitmaps to keep the intermediate
+    // results small.
+    sort(b, pls.end(), [](const PostList * x, const PostList * y) {
+	return x->get_termfreq_est() < y->get_termfreq_est();
+    });
+    intrusive_ptr<const DocIdBitmap> bitmap((*b)->get_bitmap());
+    for (auto i = b + 1; i != pls.end(); ++i) {
+	bitmap = DocIdBitmap::combine(*bitmap, *(*i)->get_bitmap(), op);
+    }
+    for_each(b, pls.end(), delete_ptr<PostList>());
+    pls.erase(b, pls.end());
+    pls.push_back(new BitmapPostList(bitmap.get(), &qopt->db, string()));
+}
+
 class OrContext : public Context {
   public:
     explicit OrContext(size_t reserve) : Context(reserve) { }
@@ -172,10 +206,58 @@ class OrContext : public Context {
     /// Select the set_size postlists with the highest term frequency.
     void select_most_frequent(QueryOptimiser * qopt, size_t set_size);
 
-    PostList * postlist(QueryOptimiser* qopt);
+    /** Build an OR postlist from the postlists added.
+     *
+     *  @param weighted	Are the weights of the postlists used?  If not, we
+     *			can use a MultiOrPostList for a wide OR, since it
+     *			doesn't need to decay into AND-like postlists based
+     *			on w_min.
+     */
+    PostList * postlist(QueryOptimiser* qopt, bool weighted);
     PostList * postlist_max(QueryOptimiser* qopt);
+
+    /** Build a weighted OR postlist which will only be advanced by next().
+     *
+     *  For a few postlists which match a lot of documents, this uses a
+     *  BlockOrPostList, provided the matcher has to check every match or
+     *  the postlists have similar maxweights, since otherwise decaying to
+     *  AND_MAYBE as w_min rises is likely to be better.  Otherwise it's the
+     *  same as postlist(qopt, true).
+     */
+    PostList * postlist_root(QueryOptimiser* qopt);
 };
 
+/** Minimum number of postlists to combine with a MultiOrPostList.
+ *
+ *  Below this, a tree of OrPostList objects is shallow enough that the
+ *  overhead of maintaining a heap isn't worthwhile.
+ */
+static const size_t MULTI_OR_THRESHOLD = 4;
+
+/** Maximum number of postlists to combine with a BlockOrPostList.
+ *
+ *  With more, the per-document merging saved is outweighed by only being
+ *  able to skip documents using w_min once they're accumulated.
+ */
+static const size_t BLOCK_OR_MAX = 5;
+
+/** Minimum density of postings for using a BlockOrPostList.
+ *
+ *  We want at least one posting per BLOCK_OR_DENSITY docids on average,
+ *  otherwise the cost of clearing and scanning each block dominates.
+ */
+static const Xapian::doccount BLOCK_OR_DENSITY = 16;
+
+/** Maximum ratio between subquery maxweights for using a BlockOrPostList.
+ *
+ *  A tree of OrPostList objects can decay to AND_MAYBE once w_min exceeds
+ *  the maxweight of a subquery, which a BlockOrPostList can't do.  When the
+ *  maxweights are this close together, w_min exceeding the smallest means
+ *  it's close to exceeding them all, and the block scan already skips those
+ *  candidates cheaply.
+ */
+static const double BLOCK_OR_MAXWEIGHT_RATIO = 1.5;
+
 void
 OrContext::select_elite_set(QueryOptimiser * qopt,
 			    size_t set_size, size_t out_of)
@@ -219,16 +301,26 @@ OrContext::select_most_frequent(QueryOptimiser * qopt, size_t set_size)
 }
 
 PostList *
-OrContext::postlist(QueryOptimiser* qopt)
+OrContext::postlist(QueryOptimiser* qopt, bool weighted)
 {
     Assert(!pls.empty());
 
+    if (!weighted)
+	combine_bitmaps(qopt, DocIdBitmap::OR);
+
     if (pls.size() == 1) {
 	PostList * pl = pls[0];
 	pls.clear();
 	return pl;
     }
 
+    if (!weighted && pls.size() >= MULTI_OR_THRESHOLD) {
+	PostList * pl = new MultiOrPostList(pls.begin(), pls.end(),
+					    qopt->matcher, qopt->db_size);
+	pls.clear();
+	return pl;
+    }
+
     // Make postlists into a heap so that the postlist with the greatest term
     // frequency is at the top of the heap.
     make_heap(pls.begin(), pls.end(), ComparePostListTermFreqAscending());
@@ -264,6 +356,36 @@ OrContext::postlist(QueryOptimiser* qopt)
     }
 }
 
+PostList *
+OrContext::postlist_root(QueryOptimiser* qopt)
+{
+    Assert(!pls.empty());
+
+    if (pls.size() >= 2 && pls.size() <= BLOCK_OR_MAX) {
+	double total_tf = 0.0;
+	for (const PostList * pl : pls) {
+	    total_tf += pl->get_termfreq_est();
+	}
+	double min_max = HUGE_VAL, max_max = 0.0;
+	for (const PostList * pl : pls) {
+	    double w = pl->get_maxweight();
+	    min_max = min(min_max, w);
+	    max_max = max(max_max, w);
+	}
+	// Don't give up on w_min decay unless it can't help.
+	bool decay_useless = qopt->check_all ||
+			     max_max <= min_max * BLOCK_OR_MAXWEIGHT_RATIO;
+	if (decay_useless && total_tf * BLOCK_OR_DENSITY >= qopt->db_size) {
+	    PostList * pl = new BlockOrPostList(pls.begin(), pls.end(),
+						qopt->matcher, qopt->db);
+	    pls.clear();
+	    return pl;
+	}
+    }
+
+    return postlist(qopt, true);
+}
+
 PostList *
 OrContext::postlist_max(QueryOptimiser* qopt)
 {
@@ -314,12 +436,19 @@ class AndContext : public Context {
 
 	Xapian::termcount window;
 
+	/// Estimated cost of checking the positions for a candidate.
+	double cost;
+
       public:
 	PosFilter(Xapian::Query::op op__, size_t begin_, size_t end_,
-		  Xapian::termcount window_)
-	    : op_(op__), begin(begin_), end(end_), window(window_) { }
+		  Xapian::termcount window_, double cost_)
+	    : op_(op__), begin(begin_), end(end_), window(window_),
+	      cost(cost_) { }
 
 	PostList * postlist(PostList * pl, const vector<PostList*>& pls) const;
+
+	/// Order by ascending cost.
+	bool operator<(const PosFilter & o) const { return cost < o.cost; }
     };
 
     list<PosFilter> pos_filters;
@@ -329,7 +458,8 @@ class AndContext : public Context {
 
     void add_pos_filter(Query::op op_,
 			size_t n_subqs,
-			Xapian::termcount window);
+			Xapian::termcount window,
+			double cost);
 
     PostList * postlist(QueryOptimiser* qopt);
 };
@@ -358,12 +488,13 @@ try {
 void
 AndContext::add_pos_filter(Query::op op_,
 			   size_t n_subqs,
-			   Xapian::termcount window)
+			   Xapian::termcount window,
+			   double cost)
 {
     Assert(n_subqs > 1);
     size_t end = pls.size();
     size_t begin = end - n_subqs;
-    pos_filters.push_back(PosFilter(op_, begin, end, window));
+    pos_filters.push_back(PosFilter(op_, begin, end, window, cost));
 }
 
 PostList *
@@ -376,12 +507,24 @@ AndContext::postlist(QueryOptimiser* qopt)
 	return new EmptyPostList;
     }
 
+    if (pos_filters.empty()) {
+	// The positional filters refer to postlists by their index in pls, so
+	// we can only combine bitmaps if there aren't any.
+	combine_bitmaps(qopt, DocIdBitmap::AND);
+	if (pls.size() == 1) {
+	    PostList * pl = pls[0];
+	    pls.clear();
+	    return pl;
+	}
+    }
+
     AutoPtr<PostList> pl(new MultiAndPostList(pls.begin(), pls.end(),
 					      qopt->matcher, qopt->db_size));
 
-    // Sort the positional filters to try to apply them in an efficient order.
-    // FIXME: We need to figure out what that is!  Try applying lowest cf/tf
-    // first?
+    // The positional filters are applied after the AND, so only to documents
+    // which contain all the terms.  Each filter only sees documents which
+    // passed those applied before it, so apply the cheapest first.
+    pos_filters.sort();
 
     // Apply any positional filters.
     list<PosFilter>::const_iterator i;
@@ -1038,7 +1181,7 @@ QueryWildcard::postlist(QueryOptimiser * qopt, double factor) const
     if (op == Query::OP_MAX)
 	RETURN(ctx.postlist_max(qopt));
 
-    PostList * pl = ctx.postlist(qopt);
+    PostList * pl = ctx.postlist(qopt, or_factor != 0.0);
     if (op == Query::OP_OR)
 	RETURN(pl);
 
@@ -1238,13 +1381,13 @@ QueryBranch::do_synonym(QueryOptimiser * qopt, double factor) const
 	// If we have a factor of 0, we don't care about the weights, so
 	// we're just like a normal OR query.
 	do_or_like(ctx, qopt, 0.0);
-	return ctx.postlist(qopt);
+	return ctx.postlist(qopt, false);
     }
 
     bool old_in_synonym = qopt->in_synonym;
     qopt->in_synonym = true;
     do_or_like(ctx, qopt, 0.0);
-    PostList * pl = ctx.postlist(qopt);
+    PostList * pl = ctx.postlist(qopt, false);
     qopt->in_synonym = old_in_synonym;
 
     // We currently assume wqf is 1 for calculating the synonym's weight
@@ -1266,7 +1409,7 @@ QueryBranch::do_max(QueryOptimiser * qopt, double factor) const
     if (factor == 0.0) {
 	// If we have a factor of 0, we don't care about the weights, so
 	// we're just like a normal OR query.
-	RETURN(ctx.postlist(qopt));
+	RETURN(ctx.postlist(qopt, false));
     }
 
     // We currently assume wqf is 1 for calculating the OP_MAX's weight
@@ -1538,9 +1681,13 @@ PostingIterator::Internal *
 QueryOr::postlist(QueryOptimiser * qopt, double factor) const
 {
     LOGCALL(QUERY, PostingIterator::Internal *, "QueryOr::postlist", qopt | factor);
+    bool root = qopt->root_or;
+    qopt->root_or = false;
     OrContext ctx(subqueries.size());
     do_or_like(ctx, qopt, factor);
-    RETURN(ctx.postlist(qopt));
+    if (root && factor != 0.0)
+	RETURN(ctx.postlist_root(qopt));
+    RETURN(ctx.postlist(qopt, factor != 0.0));
 }
 
 void
@@ -1557,7 +1704,14 @@ QueryAndNot::postlist(QueryOptimiser * qopt, double factor) const
     AutoPtr<PostList> l(subqueries[0].internal->postlist(qopt, factor));
     OrContext ctx(subqueries.size() - 1);
     do_or_like(ctx, qopt, 0.0, 0, 1);
-    AutoPtr<PostList> r(ctx.postlist(qopt));
+    AutoPtr<PostList> r(ctx.postlist(qopt, false));
+    const DocIdBitmap * l_bitmap = l->get_bitmap();
+    const DocIdBitmap * r_bitmap = r->get_bitmap();
+    if (l_bitmap && r_bitmap) {
+	RETURN(new BitmapPostList(DocIdBitmap::combine(*l_bitmap, *r_bitmap,
+						       DocIdBitmap::AND_NOT),
+				  &qopt->db, string()));
+    }
     RETURN(new AndNotPostList(l.release(), r.release(),
 			      qopt->matcher, qopt->db_size));
 }
@@ -1590,7 +1744,7 @@ QueryAndMaybe::postlist(QueryOptimiser * qopt, double factor) const
     AutoPtr<PostList> l(subqueries[0].internal->postlist(qopt, factor));
     OrContext ctx(subqueries.size() - 1);
     do_or_like(ctx, qopt, factor, 0, 1);
-    AutoPtr<PostList> r(ctx.postlist(qopt));
+    AutoPtr<PostList> r(ctx.postlist(qopt, factor != 0.0));
     RETURN(new AndMaybePostList(l.release(), r.release(),
 				qopt->matcher, qopt->db_size));
 }
@@ -1640,18 +1794,31 @@ QueryWindowed::postlist_windowed(Query::op op, AndContext& ctx, QueryOptimiser *
     bool old_need_positions = qopt->need_positions;
     qopt->need_positions = true;
 
+    // The cost of checking a candidate is roughly the number of positions we
+    // need to read, which for a term is on average its cf/tf.
+    double cost = 0.0;
     QueryVector::const_iterator i;
     for (i = subqueries.begin(); i != subqueries.end(); ++i) {
 	// MatchNothing subqueries should have been removed by done().
 	Assert((*i).internal.get());
 	bool is_term = ((*i).internal->get_type() == Query::LEAF_TERM);
 	PostList* pl = (*i).internal->postlist(qopt, factor);
-	if (!is_term)
+	if (is_term) {
+	    const QueryTerm & qt = static_cast<const QueryTerm&>(*(*i).internal);
+	    Xapian::doccount tf;
+	    Xapian::termcount cf;
+	    qopt->db.get_freqs(qt.get_term(), &tf, &cf);
+	    if (tf) cost += double(cf) / tf;
+	} else {
+	    // We don't know how many positions an OR of terms will have, so
+	    // assume it's fairly expensive.
+	    cost += 2.0;
 	    pl = new OrPosPostList(pl);
+	}
 	ctx.add_postlist(pl);
     }
     // Record the positional filter to apply higher up the tree.
-    ctx.add_pos_filter(op, subqueries.size(), window);
+    ctx.add_pos_filter(op, subqueries.size(), window, cost);
 
     qopt->need_positions = old_need_positions;
 }
@@ -1674,7 +1841,7 @@ QueryEliteSet::postlist(QueryOptimiser * qopt, double factor) const
     LOGCALL(QUERY, PostingIterator::Internal *, "QueryEliteSet::postlist", qopt | factor);
     OrContext ctx(subqueries.size());
     do_or_like(ctx, qopt, factor, set_size);
-    RETURN(ctx.postlist(qopt));
+    RETURN(ctx.postlist(qopt, factor != 0.0));
 }
 
 void
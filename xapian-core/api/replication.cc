@@ -32,24 +32,34 @@
 #include "backends/database.h"
 #include "backends/databasereplicator.h"
 #include "debuglog.h"
+#include "fd.h"
 #include "filetests.h"
 #include "fileutils.h"
 #include "io_utils.h"
 #include "omassert.h"
+#include "pack.h"
+#include "posixy_wrapper.h"
 #include "realtime.h"
 #include "net/remoteconnection.h"
 #include "noreturn.h"
 #include "replicationprotocol.h"
+#include "safedirent.h"
 #include "safeerrno.h"
+#include "safefcntl.h"
 #include "safesysstat.h"
 #include "safeunistd.h"
+#include "sha256.h"
 #include "net/length.h"
 #include "str.h"
+#include "stringutils.h"
 #include "unicode/description_append.h"
 
 #include "autoptr.h"
 #include <fstream>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace Xapian;
@@ -71,9 +81,11 @@ throw_connection_closed_unexpectedly()
 void
 DatabaseMaster::write_changesets_to_fd(int fd,
 				       const string & start_revision,
-				       ReplicationInfo * info) const
+				       ReplicationInfo * info,
+				       const string & basis,
+				       bool request_basis) const
 {
-    LOGCALL_VOID(REPLICA, "DatabaseMaster::write_changesets_to_fd", fd | start_revision | info);
+    LOGCALL_VOID(REPLICA, "DatabaseMaster::write_changesets_to_fd", fd | start_revision | info | basis.size() | request_basis);
 #ifdef XAPIAN_HAS_REMOTE_BACKEND
     if (info != NULL)
 	info->clear();
@@ -110,11 +122,51 @@ DatabaseMaster::write_changesets_to_fd(int fd,
 	revision.assign(ptr, end - ptr);
     }
 
-    db.internal[0]->write_changesets_to_fd(fd, revision, need_whole_db, info);
+    db.internal[0]->write_changesets_to_fd(fd, revision, need_whole_db, info,
+					   basis, request_basis);
 #else
     (void)fd;
     (void)start_revision;
     (void)info;
+    (void)basis;
+    (void)request_basis;
+    throw Xapian::FeatureUnavailableError("Replication requires remote backend to be enabled");
+#endif
+}
+
+bool
+DatabaseMaster::has_changes_since(const string & start_revision) const
+{
+    LOGCALL(REPLICA, bool, "DatabaseMaster::has_changes_since", start_revision);
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    if (start_revision.empty())
+	RETURN(true);
+    if (poll_db.internal.empty()) {
+	poll_db = Database(path);
+    } else {
+	try {
+	    poll_db.reopen();
+	} catch (const Xapian::DatabaseError &) {
+	    // The master may have been replaced by a new database.
+	    poll_db = Database(path);
+	}
+    }
+    if (poll_db.internal.size() != 1) {
+	throw Xapian::InvalidOperationError("DatabaseMaster needs to be pointed at exactly one subdatabase");
+    }
+
+    const char * ptr = start_revision.data();
+    const char * end = ptr + start_revision.size();
+    size_t uuid_length;
+    decode_length_and_check(&ptr, end, uuid_length);
+    if (start_revision.compare(ptr - start_revision.data(), uuid_length,
+			       poll_db.internal[0]->get_uuid()) != 0) {
+	RETURN(true);
+    }
+    ptr += uuid_length;
+    RETURN(poll_db.internal[0]->get_revision_info() != string(ptr, end - ptr));
+#else
+    (void)start_revision;
     throw Xapian::FeatureUnavailableError("Replication requires remote backend to be enabled");
 #endif
 }
@@ -181,6 +233,21 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
     /// The remote connection we're using.
     RemoteConnection * conn;
 
+    /** The directory which the last get_copy_basis() call checksummed.
+     *
+     *  Empty if there isn't one, or once it has been used for a copy.
+     */
+    string basis_path;
+
+    /// The chunk size used for each file in basis_path.
+    map<string, size_t> basis_chunk_sizes;
+
+    /// The fd to send checksums to if the master asks, or -1 if not offered.
+    int basis_fd;
+
+    /// The use_live setting to use when the master asks for checksums.
+    bool basis_use_live;
+
     /** Update the stub database which points to a single database.
      *
      *  The stub database file is created at a separate path, and then
@@ -196,6 +263,17 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
      */
     void apply_db_copy(double end_time);
 
+    /** Receive a file in a DB copy which is being sent as deltas.
+     *
+     *  @param basis_file	The existing copy of the file which the
+     *				deltas are against.
+     *  @param chunk_size	The chunk size the deltas are in.
+     *  @param filepath		The path to write the new file to.
+     */
+    void receive_file_delta(const string & basis_file, size_t chunk_size,
+			    const string & filepath,
+			    double end_time);
+
     /** Check that a message type is as expected.
      *
      *  Throws a NetworkError if the type is not the expected one.
@@ -227,6 +305,12 @@ class DatabaseReplica::Internal : public Xapian::Internal::intrusive_base {
     /// Get a string describing the current revision of the replica.
     string get_revision_info() const;
 
+    /// Get checksums of files which a copy of the database could reuse.
+    string get_copy_basis(bool use_live);
+
+    /// Offer to send checksums of the replica's files to the master.
+    bool offer_copy_basis(int fd, bool use_live);
+
     /// Set the file descriptor to read changesets from.
     void set_read_fd(int fd);
 
@@ -259,6 +343,20 @@ DatabaseReplica::get_revision_info() const
     RETURN(internal->get_revision_info());
 }
 
+string
+DatabaseReplica::get_copy_basis(bool use_live)
+{
+    LOGCALL(REPLICA, string, "DatabaseReplica::get_copy_basis", use_live);
+    RETURN(internal->get_copy_basis(use_live));
+}
+
+bool
+DatabaseReplica::offer_copy_basis(int fd, bool use_live)
+{
+    LOGCALL(REPLICA, bool, "DatabaseReplica::offer_copy_basis", fd | use_live);
+    RETURN(internal->offer_copy_basis(fd, use_live));
+}
+
 void
 DatabaseReplica::set_read_fd(int fd)
 {
@@ -309,7 +407,8 @@ DatabaseReplica::Internal::update_stub_database() const
 DatabaseReplica::Internal::Internal(const string & path_)
 	: path(path_), live_id(0), live_db(), have_offline_db(false),
 	  need_copy_next(false), offline_revision(), offline_needed_revision(),
-	  last_live_changeset_time(), conn(NULL)
+	  last_live_changeset_time(), conn(NULL), basis_path(),
+	  basis_chunk_sizes(), basis_fd(-1), basis_use_live(false)
 {
     LOGCALL_CTOR(REPLICA, "DatabaseReplica::Internal", path_);
 #if !defined XAPIAN_HAS_REMOTE_BACKEND || !defined XAPIAN_HAS_GLASS_BACKEND
@@ -378,6 +477,180 @@ DatabaseReplica::Internal::get_revision_info() const
 #endif
 }
 
+string
+DatabaseReplica::Internal::get_copy_basis(bool use_live)
+{
+    LOGCALL(REPLICA, string, "DatabaseReplica::Internal::get_copy_basis", use_live);
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    basis_path.resize(0);
+    basis_chunk_sizes.clear();
+    string offline_path = get_replica_path(live_id ^ 1);
+    if (!have_offline_db && dir_exists(offline_path)) {
+	// Left behind by a copy which was interrupted.
+	basis_path = offline_path;
+    } else if (use_live) {
+	basis_path = get_replica_path(live_id);
+    } else {
+	RETURN(string());
+    }
+
+    set<string> filenames;
+    {
+	DIR * dir = opendir(basis_path.c_str());
+	if (dir == NULL) {
+	    basis_path.resize(0);
+	    RETURN(string());
+	}
+	struct dirent * entry;
+	while ((entry = readdir(dir)) != NULL) {
+	    string name(entry->d_name);
+	    if (name == "." || name == "..")
+		continue;
+	    if (basis_path == offline_path && endswith(name, ".tmp")) {
+		// A file which was being received when the copy was
+		// interrupted.  What we got of it is likely to be more useful
+		// than any older version.
+		string tmp_path = basis_path + "/" + name;
+		name.resize(name.size() - CONST_STRLEN(".tmp"));
+		if (!io_tmp_rename(tmp_path, basis_path + "/" + name))
+		    continue;
+	    }
+	    filenames.insert(name);
+	}
+	closedir(dir);
+    }
+
+    string result;
+    string buf;
+    for (const string & name : filenames) {
+	string filepath = basis_path + "/" + name;
+	FD fd(posixy_open(filepath.c_str(), O_RDONLY | O_CLOEXEC));
+	if (fd < 0 || !file_exists(filepath))
+	    continue;
+	size_t chunk_size = repl_chunk_size(file_size(fd));
+	buf.resize(chunk_size);
+	string sums;
+	while (true) {
+	    size_t len = io_read(fd, &buf[0], chunk_size);
+	    if (len == 0) break;
+	    repl_append_chunk_checksum(sums, buf.data(), len);
+	    if (len < chunk_size) break;
+	}
+	basis_chunk_sizes[name] = chunk_size;
+	result += encode_length(name.size());
+	result += name;
+	result += encode_length(chunk_size);
+	result += encode_length(sums.size() / 8);
+	result += sums;
+    }
+    RETURN(result);
+#else
+    (void)use_live;
+    throw Xapian::FeatureUnavailableError("Replication requires remote backend to be enabled");
+#endif
+}
+
+bool
+DatabaseReplica::Internal::offer_copy_basis(int fd, bool use_live)
+{
+    LOGCALL(REPLICA, bool, "DatabaseReplica::Internal::offer_copy_basis", fd | use_live);
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    // This needs to match the choice of files in get_copy_basis(), without
+    // reading them.
+    if ((have_offline_db || !dir_exists(get_replica_path(live_id ^ 1))) &&
+	(!use_live || !dir_exists(get_replica_path(live_id)))) {
+	basis_fd = -1;
+	RETURN(false);
+    }
+    basis_fd = fd;
+    basis_use_live = use_live;
+    RETURN(true);
+#else
+    (void)fd;
+    (void)use_live;
+    throw Xapian::FeatureUnavailableError("Replication requires remote backend to be enabled");
+#endif
+}
+
+void
+DatabaseReplica::Internal::receive_file_delta(const string & basis_file,
+					      size_t chunk_size,
+					      const string & filepath,
+					      double end_time)
+{
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    FD fd(posixy_open(filepath.c_str(),
+		      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+    if (fd < 0) {
+	throw Xapian::DatabaseError("Couldn't open file for writing: " +
+				    filepath, errno);
+    }
+    // The basis file is only opened if there's something to copy from it.
+    FD basis_file_fd;
+    string buf;
+    string chunk;
+    SHA256 digest;
+    unsigned long long pos = 0;
+    while (true) {
+	int type = conn->get_message(buf, end_time);
+	if (type != REPL_REPLY_DB_FILEDELTA_END)
+	    check_message_type(type, REPL_REPLY_DB_FILEDELTA);
+	const char * ptr = buf.data();
+	const char * end = ptr + buf.size();
+	size_t reuse;
+	if (!unpack_uint(&ptr, end, &reuse))
+	    throw NetworkError("Bad delta copy message");
+	if (reuse) {
+	    // Copy the chunks which are unchanged.  Only whole chunks are sent,
+	    // so pos is always at a chunk boundary here.
+	    if (basis_file_fd < 0) {
+		basis_file_fd = posixy_open(basis_file.c_str(),
+					    O_RDONLY | O_CLOEXEC);
+		if (basis_file_fd < 0) {
+		    throw Xapian::DatabaseError("Couldn't open file: " +
+						basis_file, errno);
+		}
+	    }
+	    if (lseek(basis_file_fd, off_t(pos), SEEK_SET) < 0) {
+		throw Xapian::DatabaseError("Couldn't seek in file: " +
+					    basis_file, errno);
+	    }
+	    chunk.resize(chunk_size);
+	    while (reuse--) {
+		size_t len = io_read(basis_file_fd, &chunk[0], chunk_size);
+		if (len == 0)
+		    throw NetworkError("Delta copy refers past end of file");
+		io_write(fd, chunk.data(), len);
+		digest.update(chunk.data(), len);
+		pos += len;
+	    }
+	}
+	if (type == REPL_REPLY_DB_FILEDELTA_END) {
+	    unsigned long long size;
+	    if (!unpack_uint(&ptr, end, &size) ||
+		size_t(end - ptr) != SHA256_DIGEST_LEN)
+		throw NetworkError("Bad delta copy message");
+	    if (size != pos)
+		throw NetworkError("Delta copy produced a file of the wrong size");
+	    // The chunk checksums are only good enough to spot changed chunks,
+	    // so check the whole file matches the master's copy.
+	    if (digest.digest() != string(ptr, end - ptr))
+		throw NetworkError("Delta copy produced a file with the wrong contents");
+	    return;
+	}
+	io_write(fd, ptr, end - ptr);
+	digest.update(ptr, end - ptr);
+	pos += end - ptr;
+    }
+#else
+    (void)basis_file;
+    (void)chunk_size;
+    (void)filepath;
+    (void)end_time;
+    throw Xapian::FeatureUnavailableError("Replication requires remote backend to be enabled");
+#endif
+}
+
 void
 DatabaseReplica::Internal::remove_offline_db()
 {
@@ -397,15 +670,24 @@ DatabaseReplica::Internal::apply_db_copy(double end_time)
     have_offline_db = true;
     last_live_changeset_time = 0;
     string offline_path = get_replica_path(live_id ^ 1);
-    // If there's already an offline database, discard it.  This happens if one
-    // copy of the database was sent, but further updates were needed before it
-    // could be made live, and the remote end was then unable to send those
-    // updates (probably due to not having changesets available, or the remote
-    // database being replaced by a new database).
-    removedir(offline_path);
-    if (mkdir(offline_path.c_str(), 0777)) {
-	throw Xapian::DatabaseError("Cannot make directory '" +
-				    offline_path + "'", errno);
+    // The checksums the master has only describe the basis files as they are
+    // now, so they can't be used again once this copy has been applied.
+    string basis;
+    swap(basis, basis_path);
+    map<string, size_t> chunk_sizes;
+    swap(chunk_sizes, basis_chunk_sizes);
+    if (basis != offline_path) {
+	// If there's already an offline database, discard it.  This happens
+	// if one copy of the database was sent, but further updates were
+	// needed before it could be made live, and the remote end was then
+	// unable to send those updates (probably due to not having changesets
+	// available, or the remote database being replaced by a new
+	// database).
+	removedir(offline_path);
+	if (mkdir(offline_path.c_str(), 0777)) {
+	    throw Xapian::DatabaseError("Cannot make directory '" +
+					offline_path + "'", errno);
+	}
     }
 
     {
@@ -421,6 +703,10 @@ DatabaseReplica::Internal::apply_db_copy(double end_time)
     }
 
     // Now, read the files for the database from the connection and create it.
+    // Each file is written to a temporary name and then renamed into place,
+    // so that if the copy is interrupted get_copy_basis() can use both
+    // what we've received and any older version of the file.
+    set<string> received;
     while (true) {
 	string filename;
 	int type = conn->sniff_next_message_type(end_time);
@@ -443,10 +729,46 @@ DatabaseReplica::Internal::apply_db_copy(double end_time)
 	    return;
 
 	string filepath = offline_path + "/" + filename;
-	type = conn->receive_file(filepath, end_time);
-	if (type < 0)
-	    throw_connection_closed_unexpectedly();
-	check_message_type(type, REPL_REPLY_DB_FILEDATA);
+	string tmp_path = filepath + ".tmp";
+	if (type == REPL_REPLY_DB_FILEDELTA ||
+	    type == REPL_REPLY_DB_FILEDELTA_END) {
+	    auto i = chunk_sizes.find(filename);
+	    if (i == chunk_sizes.end())
+		throw NetworkError("Delta copy sent without checksums");
+	    receive_file_delta(basis + "/" + filename, i->second, tmp_path,
+			       end_time);
+	} else {
+	    type = conn->receive_file(tmp_path, end_time);
+	    if (type < 0)
+		throw_connection_closed_unexpectedly();
+	    check_message_type(type, REPL_REPLY_DB_FILEDATA);
+	}
+	if (!io_tmp_rename(tmp_path, filepath)) {
+	    throw Xapian::DatabaseError("Cannot rename '" + tmp_path + "'",
+					errno);
+	}
+	received.insert(filename);
+    }
+
+    if (basis == offline_path) {
+	// Remove any files from the interrupted copy which weren't part of
+	// this one.
+	DIR * dir = opendir(offline_path.c_str());
+	if (dir == NULL) {
+	    throw Xapian::DatabaseError("Cannot open directory '" +
+					offline_path + "'", errno);
+	}
+	vector<string> stale;
+	struct dirent * entry;
+	while ((entry = readdir(dir)) != NULL) {
+	    string name(entry->d_name);
+	    if (name != "." && name != ".." && received.count(name) == 0)
+		stale.push_back(name);
+	}
+	closedir(dir);
+	for (const string & name : stale) {
+	    (void)io_unlink(offline_path + "/" + name);
+	}
     }
     int type = conn->get_message(offline_needed_revision, end_time);
     check_message_type(type, REPL_REPLY_DB_FOOTER);
@@ -543,6 +865,10 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 		string buf;
 		type = conn->get_message(buf, 0.0);
 		check_message_type(type, REPL_REPLY_END_OF_CHANGES);
+		// If there's a copy left from an interrupted attempt, we don't
+		// need it now we're up to date.
+		if (!have_offline_db)
+		    removedir(get_replica_path(live_id ^ 1));
 		RETURN(false);
 	    }
 	    case REPL_REPLY_DB_HEADER:
@@ -567,6 +893,11 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 			// corruption.
 			need_copy_next = true;
 		    }
+		} catch (const Xapian::NetworkError &) {
+		    // Keep what we've received, so that get_copy_basis() can
+		    // let the next attempt resume from here.
+		    have_offline_db = false;
+		    throw;
 		} catch (...) {
 		    remove_offline_db();
 		    throw;
@@ -632,6 +963,18 @@ DatabaseReplica::Internal::apply_next_changeset(ReplicationInfo * info,
 			info->changed = true;
 		}
 		RETURN(true);
+	    case REPL_REPLY_DB_BASIS_REQUEST: {
+		// The master needs to send a copy, so send the checksums we
+		// offered.
+		string buf;
+		type = conn->get_message(buf, 0.0);
+		check_message_type(type, REPL_REPLY_DB_BASIS_REQUEST);
+		if (basis_fd < 0)
+		    throw NetworkError("Checksums requested but not offered");
+		RemoteConnection basis_conn(-1, basis_fd);
+		basis_conn.send_message('C', get_copy_basis(basis_use_live), 0.0);
+		break;
+	    }
 	    case REPL_REPLY_FAIL: {
 		string buf;
 		if (conn->get_message(buf, 0.0) < 0)
@@ -23,6 +23,7 @@
 #ifndef XAPIAN_INCLUDED_REPLICATION_H
 #define XAPIAN_INCLUDED_REPLICATION_H
 
+#include "xapian/database.h"
 #include "xapian/visibility.h"
 
 #include <string>
@@ -62,6 +63,13 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
     /// The path to the master database.
     std::string path;
 
+    /** The master database, as used by has_changes_since().
+     *
+     *  This is opened by the first call and reopened by later ones, so that
+     *  polling doesn't open the database afresh every time.
+     */
+    mutable Database poll_db;
+
   public:
     /** Create a new DatabaseMaster for the database at the specified path.
      *
@@ -97,10 +105,39 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseMaster {
      *  @param info     If non-NULL, the supplied structure will be updated
      *                  to reflect the changes written to the file
      *                  descriptor.
+     *
+     *  @param basis    Checksums of the replica's existing files, as
+     *                  returned by DatabaseReplica::get_copy_basis().  If
+     *                  a copy of the database needs to be sent, only the
+     *                  parts of files which differ from these are sent.
+     *                  Specify an empty string to always send whole files.
+     *
+     *  @param request_basis If true, the replica has offered to send
+     *                  checksums of its files (see
+     *                  DatabaseReplica::offer_copy_basis()).  If a copy of
+     *                  the database needs to be sent, they're requested and
+     *                  read from @a fd, which must be a socket connected to
+     *                  the replica.
      */
     void write_changesets_to_fd(int fd,
 				const std::string & start_revision,
-				ReplicationInfo * info) const;
+				ReplicationInfo * info,
+				const std::string & basis = std::string(),
+				bool request_basis = false) const;
+
+    /** Check if the database has changed since a revision.
+     *
+     *  This is cheap compared to write_changesets_to_fd(), so is suitable
+     *  for polling to see if there's anything to send to a replica.  The
+     *  database is kept open between calls.
+     *
+     *  @param start_revision The revision of the replica, as passed to
+     *                  write_changesets_to_fd().
+     *
+     *  @return true if the database's UUID or revision differs from that
+     *          in @a start_revision (or @a start_revision is empty).
+     */
+    bool has_changes_since(const std::string & start_revision) const;
 
     /// Return a string describing this object.
     std::string get_description() const;
@@ -151,6 +188,47 @@ class XAPIAN_VISIBILITY_DEFAULT DatabaseReplica {
      */
     std::string get_revision_info() const;
 
+    /** Get checksums of files which a copy of the database could reuse.
+     *
+     *  If the master needs to send a whole copy of the database, passing
+     *  the result to DatabaseMaster::write_changesets_to_fd() means only
+     *  the parts of files which differ from the replica's copies are sent.
+     *
+     *  If an earlier copy was interrupted, the files received so far are
+     *  used, so the copy effectively resumes where it left off.  Otherwise
+     *  the live database's files are used if @a use_live is true, which is
+     *  useful if the replica has fallen too far behind for changesets to
+     *  be used.
+     *
+     *  This reads the whole of every file it checksums, so only ask for the
+     *  live database's files if a copy is likely to be needed.
+     *
+     *  @param use_live	Use the live database if there's no interrupted
+     *			copy (default: false).
+     *
+     *  @return The checksums, or an empty string if there's nothing useful
+     *	    to send.
+     */
+    std::string get_copy_basis(bool use_live = false);
+
+    /** Offer to send the master checksums of the replica's files.
+     *
+     *  If the master then needs to send a whole copy of the database, it
+     *  asks for the result of get_copy_basis(@a use_live), which
+     *  apply_next_changeset() writes to @a fd.  So the replica is only read
+     *  to checksum it if a copy is actually needed.
+     *
+     *  The caller must tell the master about the offer (by passing
+     *  request_basis to DatabaseMaster::write_changesets_to_fd()).
+     *
+     *  @param fd	The file descriptor to write the checksums to.
+     *  @param use_live	As for get_copy_basis().
+     *
+     *  @return false if there are no files which the checksums could
+     *	    usefully cover, in which case nothing is offered.
+     */
+    bool offer_copy_basis(int fd, bool use_live = false);
+
     /** Set the file descriptor to read changesets from.
      *
      *  This will be remembered in the DatabaseReplica, but the caller is still
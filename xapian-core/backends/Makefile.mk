@@ -1,6 +1,7 @@
 noinst_HEADERS +=\
 	backends/alltermslist.h\
 	backends/backends.h\
+	backends/bitmappostlist.h\
 	backends/byte_length_strings.h\
 	backends/contiguousalldocspostlist.h\
 	backends/database.h\
@@ -19,6 +20,7 @@ EXTRA_DIST +=\
 
 lib_src +=\
 	backends/alltermslist.cc\
+	backends/bitmappostlist.cc\
 	backends/dbcheck.cc\
 	backends/database.cc\
 	backends/databasereplicator.cc\
@@ -0,0 +1,116 @@
+/** @file bitmappostlist.cc
+ * @brief PostList which iterates a DocIdBitmap
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "bitmappostlist.h"
+
+#include "xapian/error.h"
+
+#include "omassert.h"
+#include "str.h"
+
+using namespace std;
+
+Xapian::doccount
+BitmapPostList::get_termfreq() const
+{
+    return bitmap->size();
+}
+
+const DocIdBitmap *
+BitmapPostList::get_bitmap() const
+{
+    return bitmap.get();
+}
+
+Xapian::docid
+BitmapPostList::get_docid() const
+{
+    Assert(did != 0);
+    return did;
+}
+
+Xapian::termcount
+BitmapPostList::get_doclength() const
+{
+    Assert(did != 0);
+    return db->get_doclength(did);
+}
+
+Xapian::termcount
+BitmapPostList::get_unique_terms() const
+{
+    Assert(did != 0);
+    return db->get_unique_terms(did);
+}
+
+PositionList *
+BitmapPostList::read_position_list()
+{
+    // Throws the same exception.
+    return BitmapPostList::open_position_list();
+}
+
+PositionList *
+BitmapPostList::open_position_list() const
+{
+    throw Xapian::InvalidOperationError("Position lists not meaningful for BitmapPostList");
+}
+
+PostList *
+BitmapPostList::next(double)
+{
+    Assert(!at_end());
+    if (rare(did == Xapian::docid(-1))) {
+	hint = size_t(-1);
+	return NULL;
+    }
+    did = bitmap->lower_bound(did + 1, hint);
+    if (did == 0) hint = size_t(-1);
+    return NULL;
+}
+
+PostList *
+BitmapPostList::skip_to(Xapian::docid target, double)
+{
+    Assert(!at_end());
+    if (target > did) {
+	did = bitmap->lower_bound(target, hint);
+	if (did == 0) hint = size_t(-1);
+    }
+    return NULL;
+}
+
+bool
+BitmapPostList::at_end() const
+{
+    // We use hint == size_t(-1) to flag that we've reached the end.
+    return hint == size_t(-1);
+}
+
+string
+BitmapPostList::get_description() const
+{
+    string msg("BitmapPostList(");
+    msg += term;
+    msg += ", termfreq=";
+    msg += str(bitmap->size());
+    msg += ')';
+    return msg;
+}
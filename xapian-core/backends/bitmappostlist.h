@@ -0,0 +1,92 @@
+/** @file bitmappostlist.h
+ * @brief PostList which iterates a DocIdBitmap
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BITMAPPOSTLIST_H
+#define XAPIAN_INCLUDED_BITMAPPOSTLIST_H
+
+#include <string>
+
+#include "database.h"
+#include "docidbitmap.h"
+#include "api/leafpostlist.h"
+
+/** A PostList which iterates a DocIdBitmap.
+ *
+ *  This is used for boolean terms which a database has cached as bitmaps,
+ *  and for the result of combining such terms with AND, OR and AND_NOT.
+ *  It has no wdf or positional information.
+ */
+class BitmapPostList : public LeafPostList {
+    /// Don't allow assignment.
+    void operator=(const BitmapPostList &);
+
+    /// Don't allow copying.
+    BitmapPostList(const BitmapPostList &);
+
+    /// The bitmap we're iterating.
+    Xapian::Internal::intrusive_ptr<const DocIdBitmap> bitmap;
+
+    /// The database, which we need for get_doclength(), etc.
+    Xapian::Internal::intrusive_ptr<const Xapian::Database::Internal> db;
+
+    /// The current docid, or 0 if we haven't started or are at_end.
+    Xapian::docid did;
+
+    /// Hint for DocIdBitmap::lower_bound().
+    size_t hint;
+
+  public:
+    /** Constructor.
+     *
+     *  @param bitmap_	The bitmap to iterate.
+     *  @param db_	The database the docids are in.
+     *  @param term_	The term, or empty if @a bitmap_ is a combination of
+     *			terms.
+     */
+    BitmapPostList(const DocIdBitmap * bitmap_,
+		   const Xapian::Database::Internal * db_,
+		   const std::string & term_)
+	: LeafPostList(term_), bitmap(bitmap_), db(db_), did(0), hint(0) { }
+
+    /// Return the term frequency, which is exact for a bitmap.
+    Xapian::doccount get_termfreq() const;
+
+    const DocIdBitmap * get_bitmap() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_unique_terms() const;
+
+    /// Throws InvalidOperationError.
+    PositionList *read_position_list();
+
+    /// Throws InvalidOperationError.
+    PositionList * open_position_list() const;
+
+    PostList * next(double w_min);
+
+    PostList * skip_to(Xapian::docid target, double w_min);
+
+    bool at_end() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_BITMAPPOSTLIST_H
@@ -225,6 +225,12 @@ Database::Internal::replace_document(const string & unique_term,
     return did;
 }
 
+LeafPostList *
+Database::Internal::open_bitmap_post_list(const string &) const
+{
+    return NULL;
+}
+
 ValueList *
 Database::Internal::open_value_list(Xapian::valueno slot) const
 {
@@ -240,6 +246,14 @@ Database::Internal::open_spelling_termlist(const string &) const
     return NULL;
 }
 
+TermList *
+Database::Internal::open_spelling_deletion_termlist(const string &) const
+{
+    // Only implemented for some database backends - others will fall back to
+    // using open_spelling_termlist().
+    return NULL;
+}
+
 TermList *
 Database::Internal::open_spelling_wordlist() const
 {
@@ -350,7 +364,9 @@ Database::Internal::collect_document(Xapian::docid did) const
 }
 
 void
-Database::Internal::write_changesets_to_fd(int, const string &, bool, ReplicationInfo *)
+Database::Internal::write_changesets_to_fd(int, const string &, bool,
+					   ReplicationInfo *, const string &,
+					   bool)
 {
     throw Xapian::UnimplementedError("This backend doesn't provide changesets");
 }
@@ -223,6 +223,21 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual LeafPostList * open_post_list(const string & tname) const = 0;
 
+	/** Open a posting list as a bitmap, if the backend has one cached.
+	 *
+	 *  The returned postlist has no wdf or positional information, so
+	 *  this is only suitable for boolean terms.
+	 *
+	 *  The default implementation returns NULL.
+	 *
+	 *  @param tname  The term whose posting list is being requested.
+	 *
+	 *  @return       A pointer to a new BitmapPostList which should be
+	 *		  deleted by the caller after use, or NULL if there's
+	 *		  no bitmap for @a tname.
+	 */
+	virtual LeafPostList * open_bitmap_post_list(const string & tname) const;
+
 	/** Open a value stream.
 	 *
 	 *  This returns the value in a particular slot for each document.
@@ -297,6 +312,19 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual TermList * open_spelling_termlist(const string & word) const;
 
+	/** Create a termlist of spelling targets within one edit of @a word.
+	 *
+	 *  The termlist may also return words which are further away, so the
+	 *  caller needs to check the edit distance of each.
+	 *
+	 *  You can assume word.size() > 1.
+	 *
+	 *  If this database has no index which allows all such targets to be
+	 *  found, returns NULL.  If the index just has no entries for @a word,
+	 *  an empty termlist is returned.
+	 */
+	virtual TermList * open_spelling_deletion_termlist(const string & word) const;
+
 	/** Return a termlist which returns the words which are spelling
 	 *  correction targets.
 	 *
@@ -475,11 +503,21 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 *
 	 *  This call may reopen the database, leaving it pointing to a more
 	 *  recent version of the database.
+	 *
+	 *  @param basis	Checksums of files the replica already has (as
+	 *			returned by DatabaseReplica::get_copy_basis()),
+	 *			which a whole database copy can be sent as deltas
+	 *			against.  May be empty.
+	 *  @param request_basis	If true, ask the replica for checksums
+	 *				of its files before sending a whole
+	 *				database copy, and read them from @a fd.
 	 */
 	virtual void write_changesets_to_fd(int fd,
 					    const std::string & start_revision,
 					    bool need_whole_db,
-					    Xapian::ReplicationInfo * info);
+					    Xapian::ReplicationInfo * info,
+					    const std::string & basis,
+					    bool request_basis);
 
 	/// Get a string describing the current revision of the database.
 	virtual string get_revision_info() const;
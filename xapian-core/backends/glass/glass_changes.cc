@@ -24,6 +24,7 @@
 #include "glass_changes.h"
 
 #include "glass_replicate_internal.h"
+#include "glass_table.h"
 #include "fd.h"
 #include "io_utils.h"
 #include "pack.h"
@@ -82,38 +83,76 @@ GlassChanges::start(glass_revision_number_t old_rev,
 	throw Xapian::DatabaseError(message, errno);
     }
 
-    // Write header for changeset file.
-    string header = CHANGES_MAGIC_STRING;
-    header += char(CHANGES_VERSION);
-    pack_uint(header, old_rev);
-    pack_uint(header, rev);
+    // Prepare the header for the changeset file.  The version is filled in
+    // by write_header().
+    pending_header = CHANGES_MAGIC_STRING;
+    pending_header += char(CHANGES_VERSION_UNCOMPRESSED);
+    pack_uint(pending_header, old_rev);
+    pack_uint(pending_header, rev);
 
     if (flags & Xapian::DB_DANGEROUS) {
-	header += '\x01'; // Changes can't be applied to a live database.
+	pending_header += '\x01'; // Changes can't be applied to a live database.
     } else {
-	header += '\x00'; // Changes can be applied to a live database.
+	pending_header += '\x00'; // Changes can be applied to a live database.
     }
 
-    io_write(changes_fd, header.data(), header.size());
-    // FIXME: save the block stream as a single zlib stream...
-
-    // bool compressed = CHANGES_VERSION != 1; FIXME: always true for glass, but make optional?
     return this;
 }
 
+void
+GlassChanges::write_header()
+{
+    // Changed blocks are only compressed if XAPIAN_CHANGESETS_COMPRESS is
+    // set (and not to 0), since replicas running older versions can't apply
+    // compressed changesets.  We check here rather than in start() so the
+    // setting applies to the changes being made when it's set.
+    const char * p = getenv("XAPIAN_CHANGESETS_COMPRESS");
+    compress = (p && *p && *p != '0');
+    if (compress)
+	pending_header[CONST_STRLEN(CHANGES_MAGIC_STRING)] =
+	    char(CHANGES_VERSION);
+    io_write(changes_fd, pending_header.data(), pending_header.size());
+    pending_header.resize(0);
+}
+
 void
 GlassChanges::write_block(const char * p, size_t len)
 {
+    if (!pending_header.empty())
+	write_header();
     io_write(changes_fd, p, len);
 }
 
+void
+GlassChanges::write_changed_block(unsigned char code, uint4 n,
+				  const char * p, size_t block_size)
+{
+    string buf;
+    if (compress) {
+	size_t size = block_size;
+	const char * res = comp_stream.compress(p, &size);
+	if (res) {
+	    buf += char(code | CHANGES_BLOCK_COMPRESSED);
+	    pack_uint(buf, n);
+	    pack_uint(buf, size);
+	    buf.append(res, size);
+	    write_block(buf);
+	    return;
+	}
+    }
+    buf += char(code);
+    pack_uint(buf, n);
+    buf.append(p, block_size);
+    write_block(buf);
+}
+
 void
 GlassChanges::commit(glass_revision_number_t new_rev, int flags)
 {
     if (changes_fd < 0)
 	return;
 
-    io_write(changes_fd, "\xff", 1);
+    write_block("\xff", 1);
 
     string changes_tmp = changes_stem;
     changes_tmp += "tmp";
@@ -160,6 +199,29 @@ GlassChanges::commit(glass_revision_number_t new_rev, int flags)
     }
 }
 
+/// Size of the revision and level at the start of each block.
+static const int BLOCK_HEADER_SIZE = 5;
+
+/** Check the revision and level at the start of a changed block.
+ *
+ *  @param p	Pointer to the start of the block.
+ *  @param rev	The revision the changeset updates to.
+ */
+static void
+check_block_header(const char * p, glass_revision_number_t rev)
+{
+    // Although the revision number is aligned within the block, the block
+    // data may not be aligned to a word boundary here.
+    uint4 block_rev = unaligned_read4(reinterpret_cast<const byte*>(p));
+    if (block_rev > rev)
+	throw Xapian::DatabaseError("Changes file - block revision > changes file new revision");
+    // Freelist blocks get copied too.
+    unsigned level = static_cast<unsigned char>(p[4]);
+    if (level >= unsigned(Glass::BTREE_CURSOR_LEVELS) &&
+	level != unsigned(Glass::LEVEL_FREELIST))
+	throw Xapian::DatabaseError("Changes file - bad block level");
+}
+
 void
 GlassChanges::check(const string & changes_file)
 {
@@ -171,6 +233,7 @@ GlassChanges::check(const string & changes_file)
     }
 
     char buf[10240];
+    CompressionStream decomp_stream;
 
     size_t n = io_read(fd, buf, sizeof(buf), CONST_STRLEN(CHANGES_MAGIC_STRING) + 4);
     if (memcmp(buf, CHANGES_MAGIC_STRING,
@@ -179,7 +242,9 @@ GlassChanges::check(const string & changes_file)
     }
 
     const char * p = buf + CONST_STRLEN(CHANGES_MAGIC_STRING);
-    if (*p++ != CHANGES_VERSION) {
+    unsigned char changes_version = *p++;
+    if (changes_version != CHANGES_VERSION &&
+	changes_version != CHANGES_VERSION_UNCOMPRESSED) {
 	throw Xapian::DatabaseError("Changes file has unknown version");
     }
     const char * end = buf + n;
@@ -233,9 +298,12 @@ GlassChanges::check(const string & changes_file)
 	    continue;
 	}
 	unsigned table = (v & 0x7);
-	v >>= 3;
+	bool compressed = (v & CHANGES_BLOCK_COMPRESSED);
+	v = (v >> 3) & 0x7;
 	if (table > 5)
 	    throw Xapian::DatabaseError("Changes file - bad table code");
+	if (compressed && changes_version == CHANGES_VERSION_UNCOMPRESSED)
+	    throw Xapian::DatabaseError("Changes file - unexpected compressed block");
 	// Changed block.
 	if (v > 5)
 	    throw Xapian::DatabaseError("Changes file - bad block size");
@@ -243,13 +311,41 @@ GlassChanges::check(const string & changes_file)
 	uint4 block_number;
 	if (!unpack_uint(&p, end, &block_number))
 	    throw Xapian::DatabaseError("Changes file - bad block number");
-	// Although the revision number is aligned within the block, the block
-	// data may not be aligned to a word boundary here.
-	uint4 block_rev = unaligned_read4(reinterpret_cast<const byte*>(p));
-	(void)block_rev; // FIXME: Sanity check value.
-	p += 4;
-	unsigned level = static_cast<unsigned char>(*p++);
-	(void)level; // FIXME: Sanity check value.
+	if (compressed) {
+	    size_t len;
+	    if (!unpack_uint(&p, end, &len) || len >= block_size)
+		throw Xapian::DatabaseError("Changes file - bad compressed block length");
+	    string data;
+	    if (len <= size_t(end - p)) {
+		data.assign(p, len);
+		p += len;
+	    } else {
+		data.assign(p, end - p);
+		size_t got = data.size();
+		data.resize(len);
+		try {
+		    (void)io_read(fd, &data[got], len - got, len - got);
+		} catch (const Xapian::DatabaseCorruptError &) {
+		    throw Xapian::DatabaseError("Changes file - block data truncated");
+		}
+		p = end = buf;
+		n = 0;
+	    }
+	    // Check the block decompresses to the right size.
+	    string block;
+	    decomp_stream.decompress_start();
+	    if (!decomp_stream.decompress_chunk(data.data(), len, block) ||
+		block.size() != block_size)
+		throw Xapian::DatabaseError("Changes file - bad compressed block");
+	    check_block_header(block.data(), rev);
+	    continue;
+	}
+	if (end - p < BLOCK_HEADER_SIZE)
+	    throw Xapian::DatabaseError("Changes file - block data truncated");
+	check_block_header(p, rev);
+	// Skip the rest of the block.
+	p += BLOCK_HEADER_SIZE;
+	block_size -= BLOCK_HEADER_SIZE;
 	if (block_size <= unsigned(end - p)) {
 	    p += block_size;
 	} else {
@@ -23,6 +23,8 @@
 #define XAPIAN_INCLUDED_GLASS_CHANGES_H
 
 #include "glass_defs.h"
+#include "compression_stream.h"
+#include "internaltypes.h"
 #include <string>
 
 class GlassChanges {
@@ -46,14 +48,31 @@ class GlassChanges {
      */
     glass_revision_number_t oldest_changeset;
 
+    /** The header for the changeset being written, until it's written.
+     *
+     *  start() is called at the end of the previous commit, so we wait for
+     *  the first change to be written before deciding on the format.
+     */
+    std::string pending_header;
+
+    /// Should changed blocks be compressed in the changeset being written?
+    bool compress;
+
+    /// Stream used to compress changed blocks.
+    CompressionStream comp_stream;
+
   public:
     explicit GlassChanges(const std::string & db_dir)
 	: changes_fd(-1),
 	  changes_stem(db_dir + "/changes"),
-	  oldest_changeset(0) { }
+	  oldest_changeset(0),
+	  compress(false) { }
 
     ~GlassChanges();
 
+    /// Decide whether to compress, and write the changeset header.
+    void write_header();
+
     GlassChanges * start(glass_revision_number_t old_rev,
 			 glass_revision_number_t rev,
 			 int flags);
@@ -64,6 +83,21 @@ class GlassChanges {
 	write_block(s.data(), s.size());
     }
 
+    /** Write a changed B-tree block.
+     *
+     *  @param code	    Chunk type (block size code and table code).
+     *  @param n	    The block number.
+     *  @param p	    The block data.
+     *  @param block_size   The size of the block in bytes.
+     *
+     *  The block is compressed if XAPIAN_CHANGESETS_COMPRESS is enabled for
+     *  this changeset and it makes the block smaller, so that the cost is
+     *  paid once here rather than each time the changeset is sent to a
+     *  replica.
+     */
+    void write_changed_block(unsigned char code, uint4 n,
+			     const char * p, size_t block_size);
+
     void set_oldest_changeset(glass_revision_number_t rev) {
 	oldest_changeset = rev;
     }
@@ -78,16 +78,54 @@ is_doclenchunk_key(const string & key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xe0';
 }
 
+/// Return the largest wdf in postlist chunk @a tag (without the key's header).
+static Xapian::termcount
+max_wdf_in_chunk(const string & tag)
+{
+    const char * p = tag.data();
+    const char * e = p + tag.size();
+    bool is_last_chunk;
+    Xapian::docid increase_to_last;
+    Xapian::termcount wdf;
+    if (!unpack_bool(&p, e, &is_last_chunk) ||
+	!unpack_uint(&p, e, &increase_to_last) ||
+	!unpack_uint(&p, e, &wdf)) {
+	throw Xapian::DatabaseCorruptError("Bad postlist chunk");
+    }
+    Xapian::termcount result = wdf;
+    while (p != e) {
+	Xapian::docid did_increase;
+	if (!unpack_uint(&p, e, &did_increase) ||
+	    !unpack_uint(&p, e, &wdf)) {
+	    throw Xapian::DatabaseCorruptError("Bad postlist chunk");
+	}
+	if (wdf > result) result = wdf;
+    }
+    return result;
+}
+
 class PostlistCursor : private GlassCursor {
     Xapian::docid offset;
 
+    /// Does the input store a wdf bound in the first chunk of each term?
+    bool term_wdf_bounds;
+
   public:
     string key, tag;
     Xapian::docid firstdid;
-    Xapian::termcount tf, cf;
 
-    PostlistCursor(GlassTable *in, Xapian::docid offset_)
-	: GlassCursor(in), offset(offset_), firstdid(0)
+    /** The termfreq, collfreq and largest wdf in this chunk.
+     *
+     *  The termfreq and collfreq are for the whole postlist, and are only
+     *  set for its first chunk.  The largest wdf is found from the postings
+     *  rather than any stored bound, so the bound in the output is exact.
+     */
+    Xapian::termcount tf, cf, wdfmax;
+
+    PostlistCursor(GlassTable *in, Xapian::docid offset_,
+		   bool term_wdf_bounds_)
+	: GlassCursor(in), offset(offset_), term_wdf_bounds(term_wdf_bounds_),
+	  firstdid(0)
     {
 	find_entry(string());
 	next();
@@ -100,7 +138,7 @@ class PostlistCursor : private GlassCursor {
 	read_tag();
 	key = current_key;
 	tag = current_tag;
-	tf = cf = 0;
+	tf = cf = wdfmax = 0;
 	if (is_user_metadata_key(key)) return true;
 	if (is_valuestats_key(key)) return true;
 	if (is_valuechunk_key(key)) {
@@ -138,8 +176,10 @@ class PostlistCursor : private GlassCursor {
 	    // This is an initial chunk for a term, so adjust tag header.
 	    d = tag.data();
 	    e = d + tag.size();
+	    Xapian::termcount stored_wdfmax;
 	    if (!unpack_uint(&d, e, &tf) ||
 		!unpack_uint(&d, e, &cf) ||
+		(term_wdf_bounds && !unpack_uint(&d, e, &stored_wdfmax)) ||
 		!unpack_uint(&d, e, &firstdid)) {
 		throw Xapian::DatabaseCorruptError("Bad postlist key");
 	    }
@@ -157,6 +197,7 @@ class PostlistCursor : private GlassCursor {
 	    }
 	}
 	firstdid += offset;
+	if (!is_doclenchunk_key(key)) wdfmax = max_wdf_in_chunk(tag);
 	return true;
     }
 };
@@ -189,18 +230,19 @@ encode_valuestats(Xapian::doccount freq,
 static void
 merge_postlists(Xapian::Compactor * compactor,
 		GlassTable * out, vector<Xapian::docid>::const_iterator offset,
+		vector<bool>::const_iterator wdf_bounds,
 		vector<GlassTable*>::const_iterator b,
 		vector<GlassTable*>::const_iterator e)
 {
     priority_queue<PostlistCursor *, vector<PostlistCursor *>, PostlistCursorGt> pq;
-    for ( ; b != e; ++b, ++offset) {
+    for ( ; b != e; ++b, ++offset, ++wdf_bounds) {
 	GlassTable *in = *b;
 	if (in->empty()) {
 	    // Skip empty tables.
 	    continue;
 	}
 
-	pq.push(new PostlistCursor(in, *offset));
+	pq.push(new PostlistCursor(in, *offset, *wdf_bounds));
     }
 
     string last_key;
@@ -335,7 +377,8 @@ merge_postlists(Xapian::Compactor * compactor,
 	}
     }
 
-    Xapian::termcount tf = 0, cf = 0; // Initialise to avoid warnings.
+    // Initialise to avoid warnings.
+    Xapian::termcount tf = 0, cf = 0, wdfmax = 0;
     vector<pair<Xapian::docid, string> > tags;
     while (true) {
 	PostlistCursor * cur = NULL;
@@ -349,6 +392,7 @@ merge_postlists(Xapian::Compactor * compactor,
 		string first_tag;
 		pack_uint(first_tag, tf);
 		pack_uint(first_tag, cf);
+		pack_uint(first_tag, wdfmax);
 		pack_uint(first_tag, tags[0].first - 1);
 		string tag = tags[0].second;
 		tag[0] = (tags.size() == 1) ? '1' : '0';
@@ -373,11 +417,12 @@ merge_postlists(Xapian::Compactor * compactor,
 	    }
 	    tags.clear();
 	    if (cur == NULL) break;
-	    tf = cf = 0;
+	    tf = cf = wdfmax = 0;
 	    last_key = cur->key;
 	}
 	tf += cur->tf;
 	cf += cur->cf;
+	wdfmax = max(wdfmax, cur->wdfmax);
 	tags.push_back(make_pair(cur->firstdid, cur->tag));
 	if (cur->next()) {
 	    pq.push(cur);
@@ -409,9 +454,14 @@ merge_spellings(GlassTable * out,
 		vector<GlassTable*>::const_iterator e)
 {
     priority_queue<MergeCursor *, vector<MergeCursor *>, CursorGt> pq;
+    // The output only has a complete deletion index if every non-empty input
+    // does.
+    bool deletion_index = true;
     for ( ; b != e; ++b) {
 	GlassTable *in = *b;
 	if (!in->empty()) {
+	    if (!in->key_exists(Glass::SPELLING_DELETION_INDEX_KEY))
+		deletion_index = false;
 	    pq.push(new MergeCursor(in));
 	}
     }
@@ -421,6 +471,22 @@ merge_spellings(GlassTable * out,
 	pq.pop();
 
 	string key = cur->current_key;
+	if (key == Glass::SPELLING_DELETION_INDEX_KEY) {
+	    // Skip the marker in all the inputs which have it.
+	    while (true) {
+		if (cur->next()) {
+		    pq.push(cur);
+		} else {
+		    delete cur;
+		}
+		if (pq.empty() || pq.top()->current_key != key) break;
+		cur = pq.top();
+		pq.pop();
+	    }
+	    if (deletion_index) out->add(key, string());
+	    continue;
+	}
+
 	if (pq.empty() || pq.top()->current_key > key) {
 	    // No need to merge the tags, just copy the (possibly compressed)
 	    // tag value.
@@ -597,7 +663,8 @@ static void
 multimerge_postlists(Xapian::Compactor * compactor,
 		     GlassTable * out, const char * tmpdir,
 		     vector<GlassTable *> tmp,
-		     vector<Xapian::docid> off)
+		     vector<Xapian::docid> off,
+		     vector<bool> wdf_bounds)
 {
     unsigned int c = 0;
     while (tmp.size() > 3) {
@@ -605,6 +672,8 @@ multimerge_postlists(Xapian::Compactor * compactor,
 	tmpout.reserve(tmp.size() / 2);
 	vector<Xapian::docid> newoff;
 	newoff.resize(tmp.size() / 2);
+	// The temporary tables always store wdf bounds.
+	vector<bool> new_wdf_bounds(tmp.size() / 2, true);
 	for (unsigned int i = 0, j; i < tmp.size(); i = j) {
 	    j = i + 2;
 	    if (j == tmp.size() - 1) ++j;
@@ -626,6 +695,7 @@ multimerge_postlists(Xapian::Compactor * compactor,
 	    tmptab->create_and_open(flags, root_info);
 
 	    merge_postlists(compactor, tmptab, off.begin() + i,
+			    wdf_bounds.begin() + i,
 			    tmp.begin() + i, tmp.begin() + j);
 	    if (c > 0) {
 		for (unsigned int k = i; k < j; ++k) {
@@ -641,9 +711,11 @@ multimerge_postlists(Xapian::Compactor * compactor,
 	}
 	swap(tmp, tmpout);
 	swap(off, newoff);
+	swap(wdf_bounds, new_wdf_bounds);
 	++c;
     }
-    merge_postlists(compactor, out, off.begin(), tmp.begin(), tmp.end());
+    merge_postlists(compactor, out, off.begin(), wdf_bounds.begin(),
+		    tmp.begin(), tmp.end());
     if (c > 0) {
 	for (size_t k = 0; k < tmp.size(); ++k) {
 	    unlink(tmp[k]->get_path().c_str());
@@ -997,11 +1069,20 @@ GlassDatabase::compact(Xapian::Compactor * compactor,
 
 	switch (t->type) {
 	    case Glass::POSTLIST: {
+		// Inputs in the older format don't store wdf bounds, but we
+		// always write them since we recalculate them anyway.
+		vector<bool> wdf_bounds;
+		wdf_bounds.reserve(sources.size());
+		for (auto src : sources) {
+		    GlassDatabase * db = static_cast<GlassDatabase*>(src);
+		    wdf_bounds.push_back(db->version_file.has_term_wdf_bounds());
+		}
 		if (multipass && inputs.size() > 3) {
 		    multimerge_postlists(compactor, out, destdir,
-					 inputs, offset);
+					 inputs, offset, wdf_bounds);
 		} else {
 		    merge_postlists(compactor, out, offset.begin(),
+				    wdf_bounds.begin(),
 				    inputs.begin(), inputs.end());
 		}
 		break;
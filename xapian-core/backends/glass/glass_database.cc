@@ -33,6 +33,7 @@
 #include "xapian/error.h"
 #include "xapian/valueiterator.h"
 
+#include "backends/bitmappostlist.h"
 #include "backends/contiguousalldocspostlist.h"
 #include "glass_alldocspostlist.h"
 #include "glass_alltermslist.h"
@@ -57,6 +58,7 @@
 #include "replicationprotocol.h"
 #include "net/length.h"
 #include "posixy_wrapper.h"
+#include "sha256.h"
 #include "str.h"
 #include "stringutils.h"
 #include "backends/valuestats.h"
@@ -68,6 +70,7 @@
 #include <algorithm>
 #include "autoptr.h"
 #include <cstdlib>
+#include <map>
 #include <string>
 
 using namespace std;
@@ -211,6 +214,7 @@ GlassDatabase::create_and_open_tables(int flags, unsigned int block_size)
     docdata_table.create_and_open(flags, v.get_root(Glass::DOCDATA));
     termlist_table.create_and_open(flags, v.get_root(Glass::TERMLIST));
     postlist_table.create_and_open(flags, v.get_root(Glass::POSTLIST));
+    postlist_table.set_term_wdf_bounds(v.has_term_wdf_bounds());
 
     if (!v.sync(tmpfile, rev, flags)) {
 	throw Xapian::DatabaseCreateError("Failed to create iamglass file");
@@ -250,6 +254,7 @@ GlassDatabase::open_tables(int flags)
     termlist_table.open(flags, version_file.get_root(Glass::TERMLIST), rev);
     position_table.open(flags, version_file.get_root(Glass::POSITION), rev);
     postlist_table.open(flags, version_file.get_root(Glass::POSTLIST), rev);
+    postlist_table.set_term_wdf_bounds(version_file.has_term_wdf_bounds());
 
     Xapian::termcount swfub = version_file.get_spelling_wordfreq_upper_bound();
     spelling_table.set_wordfreq_upper_bound(swfub);
@@ -317,7 +322,8 @@ GlassDatabase::get_changeset_revisions(const string & path,
     if (!unpack_uint(&start, end, &changes_version))
 	throw Xapian::DatabaseError("Couldn't read a valid version number for "
 				    "changeset at " + path);
-    if (changes_version != CHANGES_VERSION)
+    if (changes_version != CHANGES_VERSION &&
+	changes_version != CHANGES_VERSION_UNCOMPRESSED)
 	throw Xapian::DatabaseError("Don't support version of changeset at "
 				    + path);
 
@@ -434,10 +440,61 @@ GlassDatabase::get_database_write_lock(int flags, bool creating)
     }
 }
 
+/** Send the rest of a file as a delta against the replica's copy.
+ *
+ *  The end message includes a SHA-256 digest of the whole file, so the
+ *  replica can check the file it reassembles from its own chunks is right.
+ *
+ *  @param basis	The chunk size the replica used, and the checksums of
+ *			the chunks of its copy.
+ */
+static void
+send_file_delta(RemoteConnection & conn, int fd,
+		const pair<size_t, string> & basis, double end_time)
+{
+    size_t chunk_size = basis.first;
+    const string & sums = basis.second;
+    size_t n_sums = sums.size() / 8;
+    string buf(chunk_size, '\0');
+    string sum;
+    string msg;
+    SHA256 digest;
+    unsigned long long size = 0;
+    // Number of chunks since the last one we sent which the replica has.
+    size_t reuse = 0;
+    for (size_t i = 0; ; ++i) {
+	size_t len = io_read(fd, &buf[0], chunk_size);
+	if (len == 0) break;
+	size += len;
+	digest.update(buf.data(), len);
+	if (i < n_sums) {
+	    sum.resize(0);
+	    repl_append_chunk_checksum(sum, buf.data(), len);
+	    if (sums.compare(i * 8, 8, sum) == 0) {
+		++reuse;
+		if (len < chunk_size) break;
+		continue;
+	    }
+	}
+	msg.resize(0);
+	pack_uint(msg, reuse);
+	msg.append(buf, 0, len);
+	conn.send_message(REPL_REPLY_DB_FILEDELTA, msg, end_time);
+	reuse = 0;
+	if (len < chunk_size) break;
+    }
+    msg.resize(0);
+    pack_uint(msg, reuse);
+    pack_uint(msg, size);
+    msg += digest.digest();
+    conn.send_message(REPL_REPLY_DB_FILEDELTA_END, msg, end_time);
+}
+
 void
-GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time)
+GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time,
+				   const map<string, pair<size_t, string>> & basis)
 {
-    LOGCALL_VOID(DB, "GlassDatabase::send_whole_database", conn | end_time);
+    LOGCALL_VOID(DB, "GlassDatabase::send_whole_database", conn | end_time | basis.size());
 
     // Send the current revision number in the header.
     string buf;
@@ -465,20 +522,60 @@ GlassDatabase::send_whole_database(RemoteConnection & conn, double end_time)
 	filepath.replace(db_dir.size() + 1, string::npos, p, len);
 	FD fd(posixy_open(filepath.c_str(), O_RDONLY | O_CLOEXEC));
 	if (fd >= 0) {
-	    conn.send_message(REPL_REPLY_DB_FILENAME, string(p, len), end_time);
-	    conn.send_file(REPL_REPLY_DB_FILEDATA, fd, end_time);
+	    string filename(p, len);
+	    conn.send_message(REPL_REPLY_DB_FILENAME, filename, end_time);
+	    auto i = basis.find(filename);
+	    if (i == basis.end()) {
+		conn.send_file(REPL_REPLY_DB_FILEDATA, fd, end_time);
+	    } else {
+		send_file_delta(conn, fd, i->second, end_time);
+	    }
 	}
 	p += len + 1;
     } while (*p);
 }
 
+/** Unpack the checksums of the files the replica already has.
+ *
+ *  @param basis	The checksums, as from DatabaseReplica::get_copy_basis().
+ *  @param basis_sums	Map from filename to the chunk size the replica used
+ *			and the checksums of its chunks.
+ */
+static void
+decode_copy_basis(const string & basis,
+		  map<string, pair<size_t, string>> & basis_sums)
+{
+    const char * b_ptr = basis.data();
+    const char * b_end = b_ptr + basis.size();
+    while (b_ptr != b_end) {
+	size_t len;
+	decode_length_and_check(&b_ptr, b_end, len);
+	string filename(b_ptr, len);
+	b_ptr += len;
+	size_t chunk_size, n_sums;
+	decode_length(&b_ptr, b_end, chunk_size);
+	decode_length(&b_ptr, b_end, n_sums);
+	if (chunk_size == 0 || n_sums > size_t(b_end - b_ptr) / 8)
+	    throw Xapian::NetworkError("Bad checksums for delta copy");
+	pair<size_t, string> & entry = basis_sums[filename];
+	entry.first = chunk_size;
+	entry.second.assign(b_ptr, n_sums * 8);
+	b_ptr += n_sums * 8;
+    }
+}
+
 void
 GlassDatabase::write_changesets_to_fd(int fd,
 				      const string & revision,
 				      bool need_whole_db,
-				      ReplicationInfo * info)
+				      ReplicationInfo * info,
+				      const string & basis,
+				      bool request_basis)
 {
-    LOGCALL_VOID(DB, "GlassDatabase::write_changesets_to_fd", fd | revision | need_whole_db | info);
+    LOGCALL_VOID(DB, "GlassDatabase::write_changesets_to_fd", fd | revision | need_whole_db | info | basis.size() | request_basis);
+
+    map<string, pair<size_t, string>> basis_sums;
+    decode_copy_basis(basis, basis_sums);
 
     int whole_db_copies_left = MAX_DB_COPIES_PER_CONVERSATION;
     glass_revision_number_t start_rev_num = 0;
@@ -492,7 +589,8 @@ GlassDatabase::write_changesets_to_fd(int fd,
 	need_whole_db = true;
     }
 
-    RemoteConnection conn(-1, fd, string());
+    // We only read from fd if we need to ask the replica for checksums.
+    RemoteConnection conn(request_basis ? fd : -1, fd, string());
 
     // While the starting revision number is less than the latest revision
     // number, look for a changeset, and write it.
@@ -513,13 +611,30 @@ GlassDatabase::write_changesets_to_fd(int fd,
 	    }
 	    whole_db_copies_left--;
 
+	    if (request_basis) {
+		// Checksumming the replica means reading all of it, so it's
+		// only worth asking for them now we know we're sending a copy.
+		// They're only valid for the first copy we send.
+		request_basis = false;
+		conn.send_message(REPL_REPLY_DB_BASIS_REQUEST, string(), 0.0);
+		string reply;
+		if (conn.get_message(reply, 0.0) != 'C') {
+		    throw Xapian::NetworkError("Bad replication client message "
+					       "(expected checksums)");
+		}
+		decode_copy_basis(reply, basis_sums);
+	    }
+
 	    // Send the whole database across.
 	    start_rev_num = get_revision_number();
 	    start_uuid = get_uuid();
 
-	    send_whole_database(conn, 0.0);
+	    send_whole_database(conn, 0.0, basis_sums);
 	    if (info != NULL)
 		++(info->fullcopy_count);
+	    // The replica's files will have changed once it has applied this
+	    // copy, so any further copy must be sent in full.
+	    basis_sums.clear();
 
 	    need_whole_db = false;
 
@@ -795,9 +910,10 @@ GlassDatabase::get_doclength_upper_bound() const
 Xapian::termcount
 GlassDatabase::get_wdf_upper_bound(const string & term) const
 {
-    Xapian::termcount cf;
-    get_freqs(term, NULL, &cf);
-    return min(cf, version_file.get_wdf_upper_bound());
+    LOGCALL(DB, Xapian::termcount, "GlassDatabase::get_wdf_upper_bound", term);
+    Xapian::termcount wdfmax;
+    postlist_table.get_freqs(term, NULL, NULL, &wdfmax);
+    RETURN(min(wdfmax, version_file.get_wdf_upper_bound()));
 }
 
 bool
@@ -831,6 +947,17 @@ GlassDatabase::open_post_list(const string& term) const
     RETURN(new GlassPostList(ptrtothis, term, true));
 }
 
+LeafPostList *
+GlassDatabase::open_bitmap_post_list(const string& term) const
+{
+    LOGCALL(DB, LeafPostList *, "GlassDatabase::open_bitmap_post_list", term);
+    intrusive_ptr<const GlassDatabase> ptrtothis(this);
+    const DocIdBitmap * bitmap = postlist_table.get_bitmap(term, ptrtothis);
+    if (!bitmap)
+	RETURN(NULL);
+    RETURN(new BitmapPostList(bitmap, this, term));
+}
+
 ValueList *
 GlassDatabase::open_value_list(Xapian::valueno slot) const
 {
@@ -893,6 +1020,12 @@ GlassDatabase::open_spelling_termlist(const string & word) const
     return spelling_table.open_termlist(word);
 }
 
+TermList *
+GlassDatabase::open_spelling_deletion_termlist(const string & word) const
+{
+    return spelling_table.open_deletion_termlist(word);
+}
+
 TermList *
 GlassDatabase::open_spelling_wordlist() const
 {
@@ -1411,6 +1544,22 @@ GlassWritableDatabase::get_freqs(const string & term,
     }
 }
 
+Xapian::termcount
+GlassWritableDatabase::get_wdf_upper_bound(const string & term) const
+{
+    LOGCALL(DB, Xapian::termcount, "GlassWritableDatabase::get_wdf_upper_bound", term);
+    Xapian::termcount_diff tf_delta, cf_delta;
+    if (inverter.get_deltas(term, tf_delta, cf_delta)) {
+	// The pending changes may add postings with a larger wdf than the
+	// bound stored in the table, so fall back to the collection frequency
+	// (which includes the pending changes).
+	Xapian::termcount cf;
+	get_freqs(term, NULL, &cf);
+	RETURN(min(cf, version_file.get_wdf_upper_bound()));
+    }
+    RETURN(GlassDatabase::get_wdf_upper_bound(term));
+}
+
 Xapian::doccount
 GlassWritableDatabase::get_value_freq(Xapian::valueno slot) const
 {
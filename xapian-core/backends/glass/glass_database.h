@@ -195,8 +195,14 @@ class GlassDatabase : public Xapian::Database::Internal {
 	void cancel();
 
 	/** Send a set of messages which transfer the whole database.
+	 *
+	 *  @param basis	Map from filename to the chunk size and chunk
+	 *			checksums of the replica's existing copy of that
+	 *			file.  Files listed are sent as deltas against
+	 *			that copy.
 	 */
-	void send_whole_database(RemoteConnection & conn, double end_time);
+	void send_whole_database(RemoteConnection & conn, double end_time,
+				 const map<string, pair<size_t, string>> & basis);
 
 	/** Get the revision stored in a changeset.
 	 */
@@ -263,6 +269,7 @@ class GlassDatabase : public Xapian::Database::Internal {
 	bool has_positions() const;
 
 	LeafPostList * open_post_list(const string & tname) const;
+	LeafPostList * open_bitmap_post_list(const string & tname) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
 	Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
@@ -271,6 +278,7 @@ class GlassDatabase : public Xapian::Database::Internal {
 	TermList * open_allterms(const string & prefix) const;
 
 	TermList * open_spelling_termlist(const string & word) const;
+	TermList * open_spelling_deletion_termlist(const string & word) const;
 	TermList * open_spelling_wordlist() const;
 	Xapian::doccount get_spelling_frequency(const string & word) const;
 
@@ -282,7 +290,9 @@ class GlassDatabase : public Xapian::Database::Internal {
 	void write_changesets_to_fd(int fd,
 				    const string & start_revision,
 				    bool need_whole_db,
-				    Xapian::ReplicationInfo * info);
+				    Xapian::ReplicationInfo * info,
+				    const string & basis,
+				    bool request_basis);
 	string get_revision_info() const;
 	string get_uuid() const;
 
@@ -411,6 +421,7 @@ class GlassWritableDatabase : public GlassDatabase {
 	void get_freqs(const string & term,
 		       Xapian::doccount * termfreq_ptr,
 		       Xapian::termcount * collfreq_ptr) const;
+	Xapian::termcount get_wdf_upper_bound(const string & term) const;
 	Xapian::doccount get_value_freq(Xapian::valueno slot) const;
 	std::string get_value_lower_bound(Xapian::valueno slot) const;
 	std::string get_value_upper_bound(Xapian::valueno slot) const;
@@ -172,6 +172,7 @@ GlassDatabaseReplicator::process_changeset_chunk_version(string & buf,
 void
 GlassDatabaseReplicator::process_changeset_chunk_blocks(Glass::table_type table,
 							unsigned v,
+							bool compressed,
 							string & buf,
 							RemoteConnection & conn,
 							double end_time) const
@@ -187,6 +188,12 @@ GlassDatabaseReplicator::process_changeset_chunk_blocks(Glass::table_type table,
     uint4 block_number;
     if (!unpack_uint(&ptr, end, &block_number))
 	throw NetworkError("Invalid block number in changeset");
+    size_t data_len = changeset_blocksize;
+    if (compressed) {
+	if (!unpack_uint(&ptr, end, &data_len) ||
+	    data_len >= changeset_blocksize)
+	    throw NetworkError("Invalid compressed block length in changeset");
+    }
 
     buf.erase(0, ptr - buf.data());
 
@@ -203,15 +210,24 @@ GlassDatabaseReplicator::process_changeset_chunk_blocks(Glass::table_type table,
 	fds[table] = fd;
     }
 
-    int res = conn.get_message_chunk(buf, changeset_blocksize, end_time);
+    int res = conn.get_message_chunk(buf, data_len, end_time);
     if (res <= 0) {
 	if (res < 0)
 	    throw_connection_closed_unexpectedly();
 	throw NetworkError("Unexpected end of changeset (4)");
     }
 
-    io_write_block(fd, buf.data(), changeset_blocksize, block_number);
-    buf.erase(0, changeset_blocksize);
+    if (compressed) {
+	string block;
+	comp_stream.decompress_start();
+	if (!comp_stream.decompress_chunk(buf.data(), data_len, block) ||
+	    block.size() != changeset_blocksize)
+	    throw NetworkError("Bad compressed block in changeset");
+	io_write_block(fd, block.data(), changeset_blocksize, block_number);
+    } else {
+	io_write_block(fd, buf.data(), changeset_blocksize, block_number);
+    }
+    buf.erase(0, data_len);
 }
 
 string
@@ -250,7 +266,8 @@ GlassDatabaseReplicator::apply_changeset_from_conn(RemoteConnection & conn,
     if (ptr == end)
 	throw NetworkError("Couldn't read a valid version number from changeset");
     unsigned int changes_version = *ptr++;
-    if (changes_version != CHANGES_VERSION)
+    if (changes_version != CHANGES_VERSION &&
+	changes_version != CHANGES_VERSION_UNCOMPRESSED)
 	throw NetworkError("Unsupported changeset version");
 
     glass_revision_number_t startrev;
@@ -302,8 +319,9 @@ GlassDatabaseReplicator::apply_changeset_from_conn(RemoteConnection & conn,
 	//
 	// 11111111 - last chunk
 	// 11111110 - version file
-	// 00BBBTTT - table block:
+	// 0CBBBTTT - table block:
 	//   Block size = (2048<<BBB) BBB=0..5; Table TTT=0..(Glass::MAX_-1)
+	//   C=1 if the block is compressed (only in CHANGES_VERSION 5)
 	unsigned char chunk_type = *ptr++;
 	if (chunk_type == 0xff)
 	    break;
@@ -317,11 +335,16 @@ GlassDatabaseReplicator::apply_changeset_from_conn(RemoteConnection & conn,
 	if (table_code >= Glass::MAX_)
 	    throw NetworkError("Bad table code in changeset file");
 	Glass::table_type table = static_cast<Glass::table_type>(table_code);
-	unsigned char v = (chunk_type >> 3) & 0x0f;
+	unsigned char v = (chunk_type >> 3) & 0x07;
+	bool compressed = (chunk_type & CHANGES_BLOCK_COMPRESSED);
+	if (chunk_type & 0x80 ||
+	    (compressed && changes_version == CHANGES_VERSION_UNCOMPRESSED))
+	    throw NetworkError("Bad chunk type in changeset file");
 
 	// Process the chunk
 	buf.erase(0, ptr - buf.data());
-	process_changeset_chunk_blocks(table, v, buf, conn, end_time);
+	process_changeset_chunk_blocks(table, v, compressed, buf, conn,
+				       end_time);
     }
 
     if (ptr != end)
@@ -25,6 +25,7 @@
 
 #include "backends/databasereplicator.h"
 #include "glass_defs.h"
+#include "compression_stream.h"
 
 class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
     private:
@@ -38,6 +39,9 @@ class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
 	 */
 	mutable int fds[Glass::MAX_];
 
+	/// Stream used to decompress compressed blocks in changesets.
+	mutable CompressionStream comp_stream;
+
 	/** Process a chunk which holds a version file.
 	 */
 	void process_changeset_chunk_version(std::string & buf,
@@ -46,9 +50,13 @@ class GlassDatabaseReplicator : public Xapian::DatabaseReplicator {
 
 	/** Process a chunk which holds a list of changed blocks in the
 	 *  database.
+	 *
+	 *  If @a compressed is true, the block data is preceded by its
+	 *  compressed length.
 	 */
 	void process_changeset_chunk_blocks(Glass::table_type table,
 					    unsigned v,
+					    bool compressed,
 					    std::string & buf,
 					    RemoteConnection & conn,
 					    double end_time) const;
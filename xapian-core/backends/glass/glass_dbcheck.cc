@@ -105,9 +105,12 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 	map<Xapian::valueno, VStats> valuestats;
 	string current_term;
 	Xapian::docid lastdid = 0;
-	Xapian::termcount termfreq = 0, collfreq = 0;
-	Xapian::termcount tf = 0, cf = 0;
+	Xapian::termcount termfreq = 0, collfreq = 0, wdfmax = 0;
+	Xapian::termcount tf = 0, cf = 0, max_wdf = 0;
 	Xapian::doccount num_doclens = 0;
+	// Older databases don't store a wdf bound for each term.
+	bool term_wdf_bounds = version_file.has_term_wdf_bounds();
+	int dummy_fields = term_wdf_bounds ? 3 : 2;
 
 	for ( ; !cursor->after_end(); cursor->next()) {
 	    string & key = cursor->current_key;
@@ -152,13 +155,14 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		end = pos + cursor->current_tag.size();
 		if (key.size() == 2) {
 		    // Initial chunk.
-		    if (end - pos < 2 || pos[0] || pos[1]) {
+		    if (end - pos < dummy_fields || pos[0] || pos[1] ||
+			(term_wdf_bounds && pos[2])) {
 			if (out)
 			    *out << "Initial doclen chunk has nonzero dummy fields" << endl;
 			++errors;
 			continue;
 		    }
-		    pos += 2;
+		    pos += dummy_fields;
 		    if (!unpack_uint(&pos, end, &did)) {
 			if (out)
 			    *out << "Failed to unpack firstdid for doclen" << endl;
@@ -442,7 +446,7 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		    ++errors;
 		}
 		current_term = term;
-		tf = cf = 0;
+		tf = cf = max_wdf = 0;
 
 		// Unpack extra header from first chunk.
 		cursor->read_tag();
@@ -462,6 +466,15 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		    ++errors;
 		    continue;
 		}
+		if (!term_wdf_bounds) {
+		    wdfmax = collfreq;
+		} else if (!unpack_uint(&pos, end, &wdfmax)) {
+		    if (out)
+			*out << "Failed to unpack wdfmax for term '" << term
+			     << "'" << endl;
+		    ++errors;
+		    continue;
+		}
 		if (!unpack_uint(&pos, end, &did)) {
 		    if (out)
 			*out << "Failed to unpack firstdid for term '" << term
@@ -524,6 +537,7 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 		}
 		++tf;
 		cf += wdf;
+		if (wdf > max_wdf) max_wdf = wdf;
 
 		if (pos == end) break;
 
@@ -560,6 +574,12 @@ check_glass_table(const char * tablename, const string &db_dir, int fd,
 			     << endl;
 		    ++errors;
 		}
+		if (max_wdf > wdfmax) {
+		    if (out)
+			*out << "wdfmax " << wdfmax << " < max wdf " << max_wdf
+			     << endl;
+		    ++errors;
+		}
 		if (did != lastdid) {
 		    if (out)
 			*out << "lastdid " << lastdid << " != last did " << did
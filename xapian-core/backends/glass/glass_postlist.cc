@@ -29,15 +29,22 @@
 #include "debuglog.h"
 #include "noreturn.h"
 #include "pack.h"
+#include "safeerrno.h"
 #include "str.h"
+#include "stringutils.h"
 #include "unicode/description_append.h"
 
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
 using Xapian::Internal::intrusive_ptr;
 
 void
 GlassPostListTable::get_freqs(const string & term,
 			      Xapian::doccount * termfreq_ptr,
-			      Xapian::termcount * collfreq_ptr) const
+			      Xapian::termcount * collfreq_ptr,
+			      Xapian::termcount * wdfmax_ptr) const
 {
     string key = make_key(term);
     string tag;
@@ -46,16 +53,91 @@ GlassPostListTable::get_freqs(const string & term,
 	    *termfreq_ptr = 0;
 	if (collfreq_ptr)
 	    *collfreq_ptr = 0;
+	if (wdfmax_ptr)
+	    *wdfmax_ptr = 0;
     } else {
 	const char * p = tag.data();
-	GlassPostList::read_number_of_entries(&p, p + tag.size(),
-					      termfreq_ptr, collfreq_ptr);
+	const char * end = p + tag.size();
+	if (!wdfmax_ptr) {
+	    GlassPostList::read_number_of_entries(&p, end,
+						  termfreq_ptr, collfreq_ptr);
+	    return;
+	}
+	Xapian::termcount collfreq;
+	GlassPostList::read_number_of_entries(&p, end, termfreq_ptr, &collfreq);
+	if (collfreq_ptr)
+	    *collfreq_ptr = collfreq;
+	if (!term_wdf_bounds) {
+	    // The collection frequency is always an upper bound on the wdf.
+	    *wdfmax_ptr = collfreq;
+	} else if (!unpack_uint(&p, end, wdfmax_ptr)) {
+	    throw Xapian::DatabaseCorruptError("Bad postlist wdf bound");
+	}
     }
 }
 
+/** Set @a result from environment variable @a name.
+ *
+ *  @a result is left unchanged unless the variable is set to an unsigned
+ *  decimal number.  Values too large for @a result are clamped.
+ */
+template<typename T>
+static void
+get_env_unsigned(const char * name, T & result)
+{
+    const char * p = getenv(name);
+    // strtoul() accepts leading whitespace and a sign (and negates the value
+    // if the sign is '-'), so insist on a digit first.
+    if (!p || !C_isdigit(*p)) return;
+    char * end;
+    errno = 0;
+    unsigned long value = strtoul(p, &end, 10);
+    if (*end) return;
+    if (errno == ERANGE || value > std::numeric_limits<T>::max())
+	value = std::numeric_limits<T>::max();
+    result = T(value);
+}
+
+void
+GlassPostListTable::init_cache_limits()
+{
+    get_env_unsigned("XAPIAN_DOCLEN_CACHE", doclen_cache_limit);
+    get_env_unsigned("XAPIAN_BITMAP_TERMFREQ", bitmap_termfreq_min);
+    get_env_unsigned("XAPIAN_BITMAP_CACHE_SIZE", bitmap_cache_max);
+}
+
+void
+GlassPostListTable::build_doclen_cache(intrusive_ptr<const GlassDatabase> db) const
+{
+    LOGCALL_VOID(DB, "GlassPostListTable::build_doclen_cache", NO_ARGS);
+    doclen_cache_tried = true;
+    Xapian::docid last = db->get_lastdocid();
+    if (last == 0 || last > doclen_cache_limit) return;
+
+    vector<Xapian::termcount> cache(last + 1);
+    GlassPostList pl(db, string(), false);
+    while (pl.next(0.0), !pl.at_end()) {
+	Xapian::docid did = pl.get_docid();
+	Xapian::termcount doclen = pl.get_wdf();
+	// We store doclen + 1, so give up if that would overflow.
+	if (rare(did > last || doclen == Xapian::termcount(-1))) return;
+	cache[did] = doclen + 1;
+    }
+    swap(doclen_cache, cache);
+}
+
 Xapian::termcount
 GlassPostListTable::get_doclength(Xapian::docid did,
 				  intrusive_ptr<const GlassDatabase> db) const {
+    if (doclen_cache_limit) {
+	if (rare(!doclen_cache_tried)) build_doclen_cache(db);
+	if (!doclen_cache.empty()) {
+	    if (did >= doclen_cache.size() || doclen_cache[did] == 0)
+		throw Xapian::DocNotFoundError("Document " + str(did) +
+					       " not found");
+	    return doclen_cache[did] - 1;
+	}
+    }
     if (!doclen_pl.get()) {
 	// Don't keep a reference back to the database, since this
 	// would make a reference loop.
@@ -66,10 +148,60 @@ GlassPostListTable::get_doclength(Xapian::docid did,
     return doclen_pl->get_wdf();
 }
 
+const DocIdBitmap *
+GlassPostListTable::get_bitmap(const string & term,
+			       intrusive_ptr<const GlassDatabase> db) const
+{
+    LOGCALL(DB, const DocIdBitmap *, "GlassPostListTable::get_bitmap", term);
+    if (bitmap_termfreq_min == 0 || term.empty()) RETURN(NULL);
+
+    auto i = bitmap_cache.find(term);
+    if (i != bitmap_cache.end()) {
+	// Move to the front of the LRU list.
+	bitmap_lru.splice(bitmap_lru.begin(), bitmap_lru, i->second.lru_it);
+	RETURN(i->second.bitmap.get());
+    }
+
+    Xapian::doccount termfreq;
+    get_freqs(term, &termfreq, NULL);
+    if (termfreq < bitmap_termfreq_min) RETURN(NULL);
+
+    intrusive_ptr<DocIdBitmap> bitmap(new DocIdBitmap);
+    GlassPostList pl(db, term, false);
+    while (pl.next(0.0), !pl.at_end()) {
+	bitmap->append(pl.get_docid());
+    }
+
+    // Evict the least recently used bitmaps to make room.  Any postlists
+    // using them hold their own references, so they're only freed once
+    // those are done with them.
+    size_t bytes = bitmap->get_memory_used();
+    while (!bitmap_lru.empty() &&
+	   bitmap_cache_bytes + bytes > bitmap_cache_max) {
+	auto j = bitmap_cache.find(bitmap_lru.back());
+	Assert(j != bitmap_cache.end());
+	bitmap_cache_bytes -= j->second.bitmap->get_memory_used();
+	bitmap_cache.erase(j);
+	bitmap_lru.pop_back();
+    }
+
+    bitmap_lru.push_front(term);
+    BitmapCacheEntry & entry = bitmap_cache[term];
+    entry.bitmap = bitmap;
+    entry.lru_it = bitmap_lru.begin();
+    bitmap_cache_bytes += bytes;
+    RETURN(bitmap.get());
+}
+
 bool
 GlassPostListTable::document_exists(Xapian::docid did,
 				    intrusive_ptr<const GlassDatabase> db) const
 {
+    if (doclen_cache_limit) {
+	if (rare(!doclen_cache_tried)) build_doclen_cache(db);
+	if (!doclen_cache.empty())
+	    return did < doclen_cache.size() && doclen_cache[did] != 0;
+    }
     if (!doclen_pl.get()) {
 	// Don't keep a reference back to the database, since this
 	// would make a reference loop.
@@ -96,7 +228,8 @@ class Glass::PostlistChunkWriter {
 	PostlistChunkWriter(const string &orig_key_,
 			    bool is_first_chunk_,
 			    const string &tname_,
-			    bool is_last_chunk_);
+			    bool is_last_chunk_,
+			    bool term_wdf_bounds_);
 
 	/// Append an entry to this chunk.
 	void append(GlassTable * table, Xapian::docid did,
@@ -127,6 +260,9 @@ class Glass::PostlistChunkWriter {
 	bool is_last_chunk;
 	bool started;
 
+	/// Does the first chunk header include a wdf upper bound?
+	bool term_wdf_bounds;
+
 	Xapian::docid first_did;
 	Xapian::docid current_did;
 
@@ -186,17 +322,28 @@ check_tname_in_key(const char **keypos, const char *keyend, const string &tname)
 static Xapian::docid
 read_start_of_first_chunk(const char ** posptr,
 			  const char * end,
+			  bool term_wdf_bounds,
 			  Xapian::doccount * number_of_entries_ptr,
-			  Xapian::termcount * collection_freq_ptr)
+			  Xapian::termcount * collection_freq_ptr,
+			  Xapian::termcount * wdfmax_ptr = NULL)
 {
-    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_first_chunk", (const void *)posptr | (const void *)end | (void *)number_of_entries_ptr | (void *)collection_freq_ptr);
+    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_first_chunk", (const void *)posptr | (const void *)end | term_wdf_bounds | (void *)number_of_entries_ptr | (void *)collection_freq_ptr | (void *)wdfmax_ptr);
 
+    Xapian::termcount collfreq;
     GlassPostList::read_number_of_entries(posptr, end,
-			   number_of_entries_ptr, collection_freq_ptr);
+			   number_of_entries_ptr, &collfreq);
     if (number_of_entries_ptr)
 	LOGVALUE(DB, *number_of_entries_ptr);
+    LOGVALUE(DB, collfreq);
     if (collection_freq_ptr)
-	LOGVALUE(DB, *collection_freq_ptr);
+	*collection_freq_ptr = collfreq;
+    if (term_wdf_bounds) {
+	if (!unpack_uint(posptr, end, wdfmax_ptr))
+	    report_read_error(*posptr);
+    } else if (wdfmax_ptr) {
+	// The collection frequency is always an upper bound on the wdf.
+	*wdfmax_ptr = collfreq;
+    }
 
     Xapian::docid did;
     // Read the docid of the first entry in the posting list.
@@ -306,13 +453,14 @@ PostlistChunkReader::next()
 PostlistChunkWriter::PostlistChunkWriter(const string &orig_key_,
 					 bool is_first_chunk_,
 					 const string &tname_,
-					 bool is_last_chunk_)
+					 bool is_last_chunk_,
+					 bool term_wdf_bounds_)
 	: orig_key(orig_key_),
 	  tname(tname_), is_first_chunk(is_first_chunk_),
 	  is_last_chunk(is_last_chunk_),
-	  started(false)
+	  started(false), term_wdf_bounds(term_wdf_bounds_)
 {
-    LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_);
+    LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_ | term_wdf_bounds_);
 }
 
 void
@@ -343,15 +491,21 @@ PostlistChunkWriter::append(GlassTable * table, Xapian::docid did,
 }
 
 /** Make the data to go at the start of the very first chunk.
+ *
+ *  @a wdfmax is only stored if @a term_wdf_bounds is true.
  */
 static inline string
-make_start_of_first_chunk(Xapian::doccount entries,
+make_start_of_first_chunk(bool term_wdf_bounds,
+			  Xapian::doccount entries,
 			  Xapian::termcount collectionfreq,
+			  Xapian::termcount wdfmax,
 			  Xapian::docid new_did)
 {
     string chunk;
     pack_uint(chunk, entries);
     pack_uint(chunk, collectionfreq);
+    if (term_wdf_bounds)
+	pack_uint(chunk, wdfmax);
     pack_uint(chunk, new_did - 1);
     return chunk;
 }
@@ -441,14 +595,16 @@ PostlistChunkWriter::flush(GlassTable *table)
 	    // Extract existing counts from the first chunk so we can reinsert
 	    // them into the block we're renaming.
 	    Xapian::doccount num_ent;
-	    Xapian::termcount coll_freq;
+	    Xapian::termcount coll_freq, wdf_max;
 	    {
 		cursor->read_tag();
 		const char *tagpos = cursor->current_tag.data();
 		const char *tagend = tagpos + cursor->current_tag.size();
 
 		(void)read_start_of_first_chunk(&tagpos, tagend,
-						&num_ent, &coll_freq);
+						term_wdf_bounds,
+						&num_ent, &coll_freq,
+						&wdf_max);
 	    }
 
 	    // Seek to the next chunk.
@@ -485,7 +641,9 @@ PostlistChunkWriter::flush(GlassTable *table)
 
 	    // And now write it as the first chunk
 	    string tag;
-	    tag = make_start_of_first_chunk(num_ent, coll_freq, new_first_did);
+	    tag = make_start_of_first_chunk(term_wdf_bounds,
+					    num_ent, coll_freq, wdf_max,
+					    new_first_did);
 	    tag += make_start_of_chunk(new_is_last_chunk,
 					      new_first_did,
 					      new_last_did_in_chunk);
@@ -530,6 +688,7 @@ PostlistChunkWriter::flush(GlassTable *table)
 	    Xapian::docid first_did_in_chunk;
 	    if (is_prev_first_chunk) {
 		first_did_in_chunk = read_start_of_first_chunk(&tagpos, tagend,
+							       term_wdf_bounds,
 							       0, 0);
 	    } else {
 		if (!unpack_uint_preserving_sort(&keypos, keyend, &first_did_in_chunk))
@@ -576,15 +735,18 @@ PostlistChunkWriter::flush(GlassTable *table)
 	    Assert(!tag.empty());
 
 	    Xapian::doccount num_ent;
-	    Xapian::termcount coll_freq;
+	    Xapian::termcount coll_freq, wdf_max;
 	    {
 		const char * tagpos = tag.data();
 		const char * tagend = tagpos + tag.size();
 		(void)read_start_of_first_chunk(&tagpos, tagend,
-						&num_ent, &coll_freq);
+						term_wdf_bounds,
+						&num_ent, &coll_freq, &wdf_max);
 	    }
 
-	    tag = make_start_of_first_chunk(num_ent, coll_freq, first_did);
+	    tag = make_start_of_first_chunk(term_wdf_bounds,
+					    num_ent, coll_freq, wdf_max,
+					    first_did);
 
 	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did);
 	    tag += chunk;
@@ -664,8 +826,14 @@ void GlassPostList::read_number_of_entries(const char ** posptr,
  *  5)  (4) repeatedly.
  *
  *  The first chunk begins with the number of entries, the collection
- *  frequency, then the docid of the first document, then has the header of a
- *  standard chunk.
+ *  frequency, an upper bound on the wdf of any entry, then the docid of the
+ *  first document, then has the header of a standard chunk.
+ *
+ *  The wdf bound is exact unless postings have since been deleted or had
+ *  their wdf reduced (we don't try to lower it then as that would require
+ *  reading the whole posting list).  Compaction recalculates it.  Databases
+ *  in the older format without these bounds (see
+ *  GlassVersion::has_term_wdf_bounds()) omit it.
  */
 GlassPostList::GlassPostList(intrusive_ptr<const GlassDatabase> this_db_,
 			     const string & term_,
@@ -674,7 +842,8 @@ GlassPostList::GlassPostList(intrusive_ptr<const GlassDatabase> this_db_,
 	  this_db(keep_reference ? this_db_ : NULL),
 	  have_started(false),
 	  is_at_end(false),
-	  cursor(this_db_->postlist_table.cursor_get())
+	  cursor(this_db_->postlist_table.cursor_get()),
+	  term_wdf_bounds(this_db_->postlist_table.has_term_wdf_bounds())
 {
     LOGCALL_CTOR(DB, "GlassPostList", this_db_.get() | term_ | keep_reference);
     init();
@@ -687,7 +856,8 @@ GlassPostList::GlassPostList(intrusive_ptr<const GlassDatabase> this_db_,
 	  this_db(this_db_),
 	  have_started(false),
 	  is_at_end(false),
-	  cursor(cursor_)
+	  cursor(cursor_),
+	  term_wdf_bounds(this_db_->postlist_table.has_term_wdf_bounds())
 {
     LOGCALL_CTOR(DB, "GlassPostList", this_db_.get() | term_ | cursor_);
     init();
@@ -712,7 +882,8 @@ GlassPostList::init()
     pos = cursor->current_tag.data();
     end = pos + cursor->current_tag.size();
 
-    did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
+    did = read_start_of_first_chunk(&pos, end, term_wdf_bounds,
+				    &number_of_entries, NULL);
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
 					    &is_last_chunk);
@@ -892,10 +1063,12 @@ GlassPostList::move_to_chunk_containing(Xapian::docid desired_did)
 	// In first chunk
 #ifdef XAPIAN_ASSERTIONS
 	Xapian::doccount old_number_of_entries = number_of_entries;
-	did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
+	did = read_start_of_first_chunk(&pos, end, term_wdf_bounds,
+					&number_of_entries, NULL);
 	Assert(old_number_of_entries == number_of_entries);
 #else
-	did = read_start_of_first_chunk(&pos, end, NULL, NULL);
+	did = read_start_of_first_chunk(&pos, end, term_wdf_bounds,
+					NULL, NULL);
 #endif
     } else {
 	// In normal chunk
@@ -954,10 +1127,23 @@ GlassPostList::skip_to(Xapian::docid desired_did, double w_min)
 
     // Move to correct chunk
     if (!current_chunk_contains(desired_did)) {
-	move_to_chunk_containing(desired_did);
-	// Might be at_end now, so we need to check before trying to move
-	// forward in chunk.
-	if (is_at_end) RETURN(NULL);
+	// If desired_did is probably in the next chunk (assuming it spans a
+	// similar range of docids to this one), step the cursor on to it,
+	// which is cheaper than looking it up from the root of the B-tree.
+	// This makes a run of short skips, as the common lists in an AND
+	// with a rarer list see, cost about the same as a scan.
+	if (!is_last_chunk &&
+	    desired_did - last_did_in_chunk <=
+		last_did_in_chunk - first_did_in_chunk + 1) {
+	    next_chunk();
+	    if (is_at_end) RETURN(NULL);
+	}
+	if (desired_did > last_did_in_chunk) {
+	    move_to_chunk_containing(desired_did);
+	    // Might be at_end now, so we need to check before trying to move
+	    // forward in chunk.
+	    if (is_at_end) RETURN(NULL);
+	}
     }
 
     // Move to correct position in chunk
@@ -1042,7 +1228,8 @@ GlassPostListTable::get_chunk(const string &tname,
 	    throw Xapian::DatabaseCorruptError("Attempted to delete or modify an entry in a non-existent posting list for " + tname);
 
 	*from = NULL;
-	*to = new PostlistChunkWriter(string(), true, tname, true);
+	*to = new PostlistChunkWriter(string(), true, tname, true,
+				      term_wdf_bounds);
 	RETURN(Xapian::docid(-1));
     }
 
@@ -1056,7 +1243,9 @@ GlassPostListTable::get_chunk(const string &tname,
     const char * end = pos + cursor->current_tag.size();
     Xapian::docid first_did_in_chunk;
     if (is_first_chunk) {
-	first_did_in_chunk = read_start_of_first_chunk(&pos, end, NULL, NULL);
+	first_did_in_chunk = read_start_of_first_chunk(&pos, end,
+						       term_wdf_bounds,
+						       NULL, NULL);
     } else {
 	if (!unpack_uint_preserving_sort(&keypos, keyend, &first_did_in_chunk)) {
 	    report_read_error(keypos);
@@ -1067,7 +1256,7 @@ GlassPostListTable::get_chunk(const string &tname,
     Xapian::docid last_did_in_chunk;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk, &is_last_chunk);
     *to = new PostlistChunkWriter(cursor->current_key, is_first_chunk, tname,
-				  is_last_chunk);
+				  is_last_chunk, term_wdf_bounds);
     if (did > last_did_in_chunk) {
 	// This is the shortcut.  Not very pretty, but I'll leave refactoring
 	// until I've a clearer picture of everything which needs to be done.
@@ -1114,7 +1303,7 @@ GlassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     string current_key = make_key(string());
     if (!key_exists(current_key)) {
 	LOGLINE(DB, "Adding dummy first chunk");
-	string newtag = make_start_of_first_chunk(0, 0, 0);
+	string newtag = make_start_of_first_chunk(term_wdf_bounds, 0, 0, 0, 0);
 	newtag += make_start_of_chunk(true, 0, 0);
 	add(current_key, newtag);
     }
@@ -1182,18 +1371,19 @@ GlassPostListTable::merge_changes(const string &term,
 	const char *pos = tag.data();
 	const char *end = pos + tag.size();
 	Xapian::doccount termfreq;
-	Xapian::termcount collfreq;
+	Xapian::termcount collfreq, wdfmax;
 	Xapian::docid firstdid, lastdid;
 	bool islast;
 	if (pos == end) {
 	    termfreq = 0;
 	    collfreq = 0;
+	    wdfmax = 0;
 	    firstdid = 0;
 	    lastdid = 0;
 	    islast = true;
 	} else {
-	    firstdid = read_start_of_first_chunk(&pos, end,
-						 &termfreq, &collfreq);
+	    firstdid = read_start_of_first_chunk(&pos, end, term_wdf_bounds,
+						 &termfreq, &collfreq, &wdfmax);
 	    // Handle the generic start of chunk header.
 	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast);
 	}
@@ -1220,8 +1410,16 @@ GlassPostListTable::merge_changes(const string &term,
 	}
 	collfreq += changes.get_cfdelta();
 
-	// Rewrite start of first chunk to update termfreq and collfreq.
-	string newhdr = make_start_of_first_chunk(termfreq, collfreq, firstdid);
+	for (auto&& i : changes.pl_changes) {
+	    Xapian::termcount wdf = i.second;
+	    if (wdf != DELETED_POSTING && wdf > wdfmax) wdfmax = wdf;
+	}
+
+	// Rewrite start of first chunk to update termfreq, collfreq and
+	// wdfmax.
+	string newhdr = make_start_of_first_chunk(term_wdf_bounds,
+						  termfreq, collfreq, wdfmax,
+						  firstdid);
 	newhdr += make_start_of_chunk(islast, firstdid, lastdid);
 	if (pos == end) {
 	    add(current_key, newhdr);
@@ -1296,7 +1494,7 @@ GlassPostListTable::get_used_docid_range(Xapian::docid & first,
     const char * p = cur->current_tag.data();
     const char * e = p + cur->current_tag.size();
 
-    first = read_start_of_first_chunk(&p, e, NULL, NULL);
+    first = read_start_of_first_chunk(&p, e, term_wdf_bounds, NULL, NULL);
 
     (void)cur->find_entry(pack_glass_postlist_key(string(), GLASS_MAX_DOCID));
     Assert(!cur->after_end());
@@ -1318,7 +1516,7 @@ GlassPostListTable::get_used_docid_range(Xapian::docid & first,
     Xapian::docid start_of_last_chunk;
     if (keypos == keyend) {
 	start_of_last_chunk = first;
-	first = read_start_of_first_chunk(&p, e, NULL, NULL);
+	first = read_start_of_first_chunk(&p, e, term_wdf_bounds, NULL, NULL);
     } else {
 	// In normal chunk
 	if (!unpack_uint_preserving_sort(&keypos, keyend,
@@ -34,8 +34,11 @@
 #include "omassert.h"
 
 #include "autoptr.h"
+#include "docidbitmap.h"
+#include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -56,6 +59,68 @@ class GlassPostListTable : public GlassTable {
 	/// PostList for looking up document lengths.
 	mutable AutoPtr<GlassPostList> doclen_pl;
 
+	/** Dense array of document lengths, indexed by docid.
+	 *
+	 *  Each entry is the document length plus one, or 0 if there's no
+	 *  such document.  Only built for a read-only database if the
+	 *  XAPIAN_DOCLEN_CACHE environment variable is set and the highest
+	 *  docid in use isn't more than its value.
+	 */
+	mutable std::vector<Xapian::termcount> doclen_cache;
+
+	/// The largest lastdocid to build doclen_cache for (0 for never).
+	Xapian::docid doclen_cache_limit = 0;
+
+	/// Have we tried to build doclen_cache since the table was opened?
+	mutable bool doclen_cache_tried = false;
+
+	/// Try to build doclen_cache.
+	void build_doclen_cache(Xapian::Internal::intrusive_ptr<const GlassDatabase> db) const;
+
+	/// An entry in bitmap_cache.
+	struct BitmapCacheEntry {
+	    /// The bitmap, which postlists iterating it also hold references to.
+	    Xapian::Internal::intrusive_ptr<const DocIdBitmap> bitmap;
+
+	    /// Where this entry's term is in bitmap_lru.
+	    std::list<std::string>::iterator lru_it;
+	};
+
+	/** Bitmaps of the docids indexed by frequent terms.
+	 *
+	 *  Only built for a read-only database if the XAPIAN_BITMAP_TERMFREQ
+	 *  environment variable is set, for terms whose termfreq is at least
+	 *  its value.  A bitmap needs up to 8KB per 65536 docids, so the
+	 *  least recently used bitmaps are evicted once the cache holds more
+	 *  than bitmap_cache_max bytes.
+	 */
+	mutable std::map<std::string, BitmapCacheEntry> bitmap_cache;
+
+	/// The terms in bitmap_cache, most recently used first.
+	mutable std::list<std::string> bitmap_lru;
+
+	/// Bytes used by the bitmaps in bitmap_cache.
+	mutable size_t bitmap_cache_bytes = 0;
+
+	/// The smallest termfreq to build a bitmap for (0 for never).
+	Xapian::doccount bitmap_termfreq_min = 0;
+
+	/** The most bytes to keep in bitmap_cache.
+	 *
+	 *  Set by XAPIAN_BITMAP_CACHE_SIZE (in bytes), defaulting to 64MB.  The most
+	 *  recently built bitmap is always kept, even if it is larger.
+	 */
+	size_t bitmap_cache_max = 64 * 1024 * 1024;
+
+	/// Set the cache limits from the environment.
+	void init_cache_limits();
+
+	/** Does the first chunk of each postlist store a wdf upper bound?
+	 *
+	 *  See GlassVersion::has_term_wdf_bounds().
+	 */
+	bool term_wdf_bounds = true;
+
     public:
 	/** Create a new table object.
 	 *
@@ -72,19 +137,36 @@ class GlassPostListTable : public GlassTable {
 	GlassPostListTable(const string & path_, bool readonly_)
 	    : GlassTable("postlist", path_ + "/postlist.", readonly_),
 	      doclen_pl()
-	{ }
+	{
+	    if (readonly_) init_cache_limits();
+	}
 
 	GlassPostListTable(int fd, off_t offset_, bool readonly_)
 	    : GlassTable("postlist", fd, offset_, readonly_),
 	      doclen_pl()
-	{ }
+	{
+	    if (readonly_) init_cache_limits();
+	}
 
 	void open(int flags_, const RootInfo & root_info,
 		  glass_revision_number_t rev) {
 	    doclen_pl.reset(0);
+	    doclen_cache.clear();
+	    doclen_cache_tried = false;
+	    bitmap_cache.clear();
+	    bitmap_lru.clear();
+	    bitmap_cache_bytes = 0;
 	    GlassTable::open(flags_, root_info, rev);
 	}
 
+	/// Set whether the postlists store a wdf upper bound for each term.
+	void set_term_wdf_bounds(bool term_wdf_bounds_) {
+	    term_wdf_bounds = term_wdf_bounds_;
+	}
+
+	/// Do the postlists store a wdf upper bound for each term?
+	bool has_term_wdf_bounds() const { return term_wdf_bounds; }
+
 	/// Merge changes for a term.
 	void merge_changes(const string &term, const Inverter::PostingChanges & changes);
 
@@ -117,15 +199,26 @@ class GlassPostListTable : public GlassTable {
 	 *			term (or NULL not to return)
 	 *  @param collfreq_ptr	Point to return number of occurrences of @a
 	 *			term in the database (or NULL not to return)
+	 *  @param wdfmax_ptr	Point to return an upper bound on the wdf of
+	 *			@a term in any document (or NULL not to return)
 	 */
 	void get_freqs(const std::string & term,
 		       Xapian::doccount * termfreq_ptr,
-		       Xapian::termcount * collfreq_ptr) const;
+		       Xapian::termcount * collfreq_ptr,
+		       Xapian::termcount * wdfmax_ptr = NULL) const;
 
 	/** Returns the length of document @a did. */
 	Xapian::termcount get_doclength(Xapian::docid did,
 					Xapian::Internal::intrusive_ptr<const GlassDatabase> db) const;
 
+	/** Return a bitmap of the docids indexing @a term.
+	 *
+	 *  Returns NULL if @a term isn't frequent enough to be cached as a
+	 *  bitmap.
+	 */
+	const DocIdBitmap * get_bitmap(const string & term,
+				       Xapian::Internal::intrusive_ptr<const GlassDatabase> db) const;
+
 	/** Check if document @a did exists. */
 	bool document_exists(Xapian::docid did,
 			     Xapian::Internal::intrusive_ptr<const GlassDatabase> db) const;
@@ -158,6 +251,9 @@ class GlassPostList : public LeafPostList {
 	/// Cursor pointing to current chunk of postlist.
 	AutoPtr<GlassCursor> cursor;
 
+	/// Does the first chunk header include a wdf upper bound?
+	bool term_wdf_bounds;
+
 	/// The first document id in this chunk.
 	Xapian::docid first_did_in_chunk;
 
@@ -31,7 +31,17 @@
 // 2  - compressed changesets
 // 3  - store (block_size / 2048)
 // 4  - reworked for switch from base files to version file
-#define CHANGES_VERSION 4u
+// 5  - changed blocks may be stored compressed
+#define CHANGES_VERSION 5u
+
+// The changeset version written when compression is disabled.  Changesets in
+// this version never contain compressed blocks, so older replicas can still
+// apply them.
+#define CHANGES_VERSION_UNCOMPRESSED 4u
+
+// Flag set in the chunk type of a changed block which is stored compressed.
+// The block number is then followed by the length of the compressed data.
+#define CHANGES_BLOCK_COMPRESSED 0x40
 
 // Must be big enough to ensure that the start of the changeset (up to the new
 // revision number) will fit in this much space.
@@ -22,6 +22,7 @@
 
 #include <xapian/error.h>
 #include <xapian/types.h>
+#include <xapian/unicode.h>
 
 #include "expand/expandweight.h"
 #include "glass_spelling.h"
@@ -42,57 +43,73 @@ using namespace Glass;
 using namespace std;
 
 void
-GlassSpellingTable::merge_changes()
+GlassSpellingTable::merge_wordlist(const string & key,
+				   const set<string> & changes)
 {
-    map<fragment, set<string> >::const_iterator i;
-    for (i = termlist_deltas.begin(); i != termlist_deltas.end(); ++i) {
-	string key = i->first;
-	const set<string> & changes = i->second;
-
-	set<string>::const_iterator d = changes.begin();
-	if (d == changes.end()) continue;
-
-	string updated;
-	string current;
-	PrefixCompressedStringWriter out(updated);
-	if (get_exact_entry(key, current)) {
-	    PrefixCompressedStringItor in(current);
-	    updated.reserve(current.size()); // FIXME plus some?
-	    while (!in.at_end() && d != changes.end()) {
-		const string & word = *in;
-		Assert(d != changes.end());
-		int cmp = word.compare(*d);
-		if (cmp < 0) {
-		    out.append(word);
-		    ++in;
-		} else if (cmp > 0) {
-		    out.append(*d);
-		    ++d;
-		} else {
-		    // If an existing entry is in the changes list, that means
-		    // we should remove it.
-		    ++in;
-		    ++d;
-		}
+    set<string>::const_iterator d = changes.begin();
+    if (d == changes.end()) return;
+
+    string updated;
+    string current;
+    PrefixCompressedStringWriter out(updated);
+    if (get_exact_entry(key, current)) {
+	PrefixCompressedStringItor in(current);
+	updated.reserve(current.size()); // FIXME plus some?
+	while (!in.at_end() && d != changes.end()) {
+	    const string & word = *in;
+	    Assert(d != changes.end());
+	    int cmp = word.compare(*d);
+	    if (cmp < 0) {
+		out.append(word);
+		++in;
+	    } else if (cmp > 0) {
+		out.append(*d);
+		++d;
+	    } else {
+		// If an existing entry is in the changes list, that means
+		// we should remove it.
+		++in;
+		++d;
 	    }
-	    if (!in.at_end()) {
-		// FIXME : easy to optimise this to a fix-up and substring copy.
-		while (!in.at_end()) {
-		    out.append(*in++);
-		}
-	    }
-	}
-	while (d != changes.end()) {
-	    out.append(*d++);
 	}
-	if (!updated.empty()) {
-	    add(key, updated);
-	} else {
-	    del(key);
+	if (!in.at_end()) {
+	    // FIXME : easy to optimise this to a fix-up and substring copy.
+	    while (!in.at_end()) {
+		out.append(*in++);
+	    }
 	}
     }
+    while (d != changes.end()) {
+	out.append(*d++);
+    }
+    if (!updated.empty()) {
+	add(key, updated);
+    } else {
+	del(key);
+    }
+}
+
+void
+GlassSpellingTable::merge_changes()
+{
+    if (!wordfreq_changes.empty() && empty()) {
+	// We're building the table from scratch so the deletion index will be
+	// complete.
+	add(SPELLING_DELETION_INDEX_KEY, string());
+    }
+
+    map<fragment, set<string> >::const_iterator i;
+    for (i = termlist_deltas.begin(); i != termlist_deltas.end(); ++i) {
+	merge_wordlist(i->first, i->second);
+    }
     termlist_deltas.clear();
 
+    map<string, set<string> >::const_iterator k;
+    for (k = deletion_deltas.begin(); k != deletion_deltas.end(); ++k) {
+	merge_wordlist('D' + k->first, k->second);
+    }
+    deletion_deltas.clear();
+
     map<string, Xapian::termcount>::const_iterator j;
     for (j = wordfreq_changes.begin(); j != wordfreq_changes.end(); ++j) {
 	string key = "W" + j->first;
@@ -126,6 +143,42 @@ GlassSpellingTable::toggle_fragment(fragment frag, const string & word)
     }
 }
 
+void
+GlassSpellingTable::toggle_deletion(const string & variant, const string & word)
+{
+    map<string, set<string> >::iterator i = deletion_deltas.find(variant);
+    if (i == deletion_deltas.end()) {
+	i = deletion_deltas.insert(make_pair(variant, set<string>())).first;
+    }
+    pair<set<string>::iterator, bool> res = i->second.insert(word);
+    if (!res.second) {
+	// word is already in the set, so remove it.
+	i->second.erase(res.first);
+    }
+}
+
+/** Generate the variants of @a word with one character deleted.
+ *
+ *  We work in Unicode characters rather than bytes so that a single edit to
+ *  a multi-byte character is still a single deletion.  Duplicate variants
+ *  (which arise from runs of the same character) are only returned once, and
+ *  empty variants aren't returned.
+ */
+static void
+single_deletions(const string & word, set<string> & result)
+{
+    Xapian::Utf8Iterator it(word);
+    while (it != Xapian::Utf8Iterator()) {
+	size_t start = it.raw() - word.data();
+	++it;
+	size_t end = it.raw() - word.data();
+	if (start == 0 && end == word.size()) break;
+	string variant(word, 0, start);
+	variant.append(word, end, string::npos);
+	result.insert(variant);
+    }
+}
+
 void
 GlassSpellingTable::add_word(const string & word, Xapian::termcount freqinc)
 {
@@ -247,6 +300,20 @@ GlassSpellingTable::toggle_word(const string & word)
 		toggle_fragment(buf, word);
 	}
     }
+
+    // Deletion index - the word itself, plus each variant with a single
+    // character deleted.  A table without the marker has no (or an
+    // incomplete) deletion index, so toggling entries there would add stale
+    // ones for words which were never indexed.  If the table is empty, the
+    // marker will be added when the changes are merged.
+    if (!empty() && !key_exists(SPELLING_DELETION_INDEX_KEY)) return;
+    toggle_deletion(word, word);
+    set<string> variants;
+    single_deletions(word, variants);
+    set<string>::const_iterator v;
+    for (v = variants.begin(); v != variants.end(); ++v) {
+	toggle_deletion(*v, word);
+    }
 }
 
 struct TermListGreaterApproxSize {
@@ -371,6 +438,59 @@ GlassSpellingTable::open_termlist(const string & word)
     }
 }
 
+TermList *
+GlassSpellingTable::open_deletion_termlist(const string & word)
+{
+    // Merge any pending changes to disk, but don't call commit() so they
+    // won't be switched live.
+    if (!wordfreq_changes.empty()) merge_changes();
+
+    // An empty table trivially has a complete deletion index, which matters
+    // when this table is one of several being searched together.
+    if (empty()) return new GlassSpellingTermList(string());
+    if (!key_exists(SPELLING_DELETION_INDEX_KEY)) return NULL;
+
+    // A word within one edit of "word" either is "word", or shares a single
+    // character deletion variant with it (substitution and transposition),
+    // or has "word" as a variant (insertion), or is itself a variant of
+    // "word" (deletion).  Since each word is indexed under itself as well as
+    // under its variants, looking up "word" and each of its variants finds
+    // all of these.
+    set<string> variants;
+    single_deletions(word, variants);
+    variants.insert(word);
+
+    priority_queue<TermList*, vector<TermList*>, TermListGreaterApproxSize> pq;
+    try {
+	string data;
+	set<string>::const_iterator v;
+	for (v = variants.begin(); v != variants.end(); ++v) {
+	    if (get_exact_entry('D' + *v, data))
+		pq.push(new GlassSpellingTermList(data));
+	}
+
+	if (pq.empty()) return new GlassSpellingTermList(string());
+
+	// Build a balanced OrTermList tree as open_termlist() does.
+	while (pq.size() > 1) {
+	    TermList * termlist = pq.top();
+	    pq.pop();
+
+	    termlist = new OrTermList(pq.top(), termlist);
+	    pq.pop();
+	    pq.push(termlist);
+	}
+
+	return pq.top();
+    } catch (...) {
+	while (!pq.empty()) {
+	    delete pq.top();
+	    pq.pop();
+	}
+	throw;
+    }
+}
+
 Xapian::doccount
 GlassSpellingTable::get_word_frequency(const string & word) const
 {
@@ -35,6 +35,16 @@ namespace Glass {
 
 class RootInfo;
 
+/** Key marking that the spelling table holds a complete deletion index.
+ *
+ *  Deletion index entries have keys 'D' followed by a word or a variant of
+ *  a word with one character deleted, so an empty variant can never occur
+ *  (we don't index variants which are empty).  This marker is only written
+ *  when the table is built from empty, so a table created by an older
+ *  version (which lacks some or all of the deletion entries) won't have it.
+ */
+const char SPELLING_DELETION_INDEX_KEY[] = "D";
+
 struct fragment {
     char data[4];
 
@@ -63,6 +73,11 @@ using Glass::RootInfo;
 class GlassSpellingTable : public GlassLazyTable {
     void toggle_word(const std::string & word);
     void toggle_fragment(Glass::fragment frag, const std::string & word);
+    void toggle_deletion(const std::string & variant, const std::string & word);
+
+    /// Merge a set of changes into the prefix-compressed word list at @a key.
+    void merge_wordlist(const std::string & key,
+			const std::set<std::string> & changes);
 
     std::map<std::string, Xapian::termcount> wordfreq_changes;
 
@@ -76,6 +91,13 @@ class GlassSpellingTable : public GlassLazyTable {
      */
     std::map<Glass::fragment, std::set<std::string> > termlist_deltas;
 
+    /** Changes to make to the deletion index.
+     *
+     *  Keyed by the variant (without the 'D' prefix), and xor-ed with the
+     *  lists on disk in the same way as termlist_deltas.
+     */
+    std::map<std::string, std::set<std::string> > deletion_deltas;
+
     /** Used to track an upper bound on wordfreq. */
     Xapian::termcount wordfreq_upper_bound = 0;
 
@@ -105,6 +127,16 @@ class GlassSpellingTable : public GlassLazyTable {
 
     TermList * open_termlist(const std::string & word);
 
+    /** Open a termlist of words within one edit of @a word.
+     *
+     *  The words are found using the deletion index - the list returned
+     *  is a superset of the words within edit distance one of @a word, so
+     *  the caller still needs to check the edit distance of each.
+     *
+     *  @return NULL if this table doesn't have a complete deletion index.
+     */
+    TermList * open_deletion_termlist(const std::string & word);
+
     Xapian::doccount get_word_frequency(const std::string & word) const;
 
     void set_wordfreq_upper_bound(Xapian::termcount ub) {
@@ -133,6 +165,7 @@ class GlassSpellingTable : public GlassLazyTable {
 	// Discard batched-up changes.
 	wordfreq_changes.clear();
 	termlist_deltas.clear();
+	deletion_deltas.clear();
 
 	GlassTable::cancel(root_info, rev);
     }
@@ -257,13 +257,8 @@ GlassTable::write_block(uint4 n, const byte * p, bool appending) const
 	return; // FIXME
     }
 
-    string buf;
-    buf += char(v);
-    // Write the block number to the file
-    pack_uint(buf, n);
-
-    changes_obj->write_block(buf);
-    changes_obj->write_block(reinterpret_cast<const char *>(p), block_size);
+    changes_obj->write_changed_block(v, n, reinterpret_cast<const char *>(p),
+				     block_size);
 }
 
 /* A note on cursors:
@@ -96,7 +96,9 @@ GlassTermList::accumulate_stats(Xapian::Internal::ExpandStats & stats) const
 {
     LOGCALL_VOID(DB, "GlassTermList::accumulate_stats", stats);
     Assert(!at_end());
-    stats.accumulate(current_wdf, doclen, get_termfreq(), db->get_doccount());
+    stats.accumulate(current_wdf, doclen);
+    if (stats.need_subdb_stats())
+	stats.accumulate_subdb(get_termfreq(), db->get_doccount());
 }
 
 string
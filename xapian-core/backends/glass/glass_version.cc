@@ -49,7 +49,8 @@
 using namespace std;
 
 /// Glass format version (date of change):
-#define GLASS_FORMAT_VERSION DATE_TO_VERSION(2016,03,14)
+#define GLASS_FORMAT_VERSION DATE_TO_VERSION(2026,10,19)
+// 2026,10,19 1.5.0 Store wdf upper bound in first postlist chunk for each term
 // 2016,03,14 1.3.5 compress_min in version file; partly eliminate component_of
 // 2015,12,24 1.3.4 2 bytes "components_of" per item eliminated, and much more
 // 2014,11,21 1.3.2 Brass renamed to Glass
@@ -61,16 +62,24 @@ using namespace std;
 #define VERSION_TO_MONTH(V) ((unsigned(V) >> 5) & 0x0f)
 #define VERSION_TO_DAY(V) (unsigned(V) & 0x1f)
 
+/** The previous glass format version, which we can still read and update.
+ *
+ *  The only difference is that it doesn't store a wdf upper bound for each
+ *  term, so databases in this format are left in it rather than making them
+ *  unreadable by older releases.
+ */
+#define GLASS_FORMAT_VERSION_NO_WDF_BOUNDS DATE_TO_VERSION(2016,03,14)
+
 #define GLASS_VERSION_MAGIC_LEN 14
 #define GLASS_VERSION_MAGIC_AND_VERSION_LEN 16
 
-static const char GLASS_VERSION_MAGIC[GLASS_VERSION_MAGIC_AND_VERSION_LEN] = {
-    '\x0f', '\x0d', 'X', 'a', 'p', 'i', 'a', 'n', ' ', 'G', 'l', 'a', 's', 's',
-    char((GLASS_FORMAT_VERSION >> 8) & 0xff), char(GLASS_FORMAT_VERSION & 0xff)
+static const char GLASS_VERSION_MAGIC[GLASS_VERSION_MAGIC_LEN] = {
+    '\x0f', '\x0d', 'X', 'a', 'p', 'i', 'a', 'n', ' ', 'G', 'l', 'a', 's', 's'
 };
 
 GlassVersion::GlassVersion(int fd_)
-    : rev(0), fd(fd_), offset(0), db_dir(), changes(NULL),
+    : rev(0), fd(fd_), offset(0), db_dir(), term_wdf_bounds(true),
+      changes(NULL),
       doccount(0), total_doclen(0), last_docid(0),
       doclen_lbound(0), doclen_ubound(0),
       wdf_ubound(0), spelling_wordfreq_ubound(0),
@@ -129,7 +138,8 @@ GlassVersion::read()
     version = static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN]);
     version <<= 8;
     version |= static_cast<unsigned char>(buf[GLASS_VERSION_MAGIC_LEN + 1]);
-    if (version != GLASS_FORMAT_VERSION) {
+    term_wdf_bounds = (version == GLASS_FORMAT_VERSION);
+    if (!term_wdf_bounds && version != GLASS_FORMAT_VERSION_NO_WDF_BOUNDS) {
 	string msg;
 	if (!single_file()) {
 	    msg = db_dir;
@@ -269,7 +279,11 @@ GlassVersion::write(glass_revision_number_t new_rev, int flags)
 {
     LOGCALL(DB, const string, "GlassVersion::write", new_rev|flags);
 
-    string s(GLASS_VERSION_MAGIC, GLASS_VERSION_MAGIC_AND_VERSION_LEN);
+    string s(GLASS_VERSION_MAGIC, GLASS_VERSION_MAGIC_LEN);
+    unsigned version = term_wdf_bounds ? GLASS_FORMAT_VERSION :
+					 GLASS_FORMAT_VERSION_NO_WDF_BOUNDS;
+    s += char((version >> 8) & 0xff);
+    s += char(version & 0xff);
     s.append(reinterpret_cast<const char *>(uuid), 16);
 
     pack_uint(s, new_rev);
@@ -388,6 +402,7 @@ void
 GlassVersion::create(unsigned blocksize)
 {
     AssertRel(blocksize,>=,2048);
+    term_wdf_bounds = true;
     uuid_generate(uuid);
     for (unsigned table_no = 0; table_no < Glass::MAX_; ++table_no) {
 	root[table_no].init(blocksize, compress_min_tab[table_no]);
@@ -120,6 +120,13 @@ class GlassVersion {
     /// The database directory.
     std::string db_dir;
 
+    /** Does the postlist table store a wdf upper bound for each term?
+     *
+     *  False for a database in the older format without them, which we can
+     *  still read and update.
+     */
+    bool term_wdf_bounds;
+
     GlassChanges * changes;
 
     /// The number of documents in the database.
@@ -157,7 +164,8 @@ class GlassVersion {
 
   public:
     explicit GlassVersion(const std::string & db_dir_ = std::string())
-	: rev(0), fd(-1), offset(0), db_dir(db_dir_), changes(NULL),
+	: rev(0), fd(-1), offset(0), db_dir(db_dir_), term_wdf_bounds(true),
+	  changes(NULL),
 	  doccount(0), total_doclen(0), last_docid(0),
 	  doclen_lbound(0), doclen_ubound(0),
 	  wdf_ubound(0), spelling_wordfreq_ubound(0),
@@ -229,6 +237,9 @@ class GlassVersion {
 
     Xapian::docid get_last_docid() const { return last_docid; }
 
+    /// Does the postlist table store a wdf upper bound for each term?
+    bool has_term_wdf_bounds() const { return term_wdf_bounds; }
+
     Xapian::termcount get_doclength_lower_bound() const {
 	return doclen_lbound;
     }
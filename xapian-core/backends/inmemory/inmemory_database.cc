@@ -235,9 +235,10 @@ InMemoryTermList::accumulate_stats(Xapian::Internal::ExpandStats & stats) const
     if (db->is_closed()) InMemoryDatabase::throw_database_closed();
     Assert(started);
     Assert(!at_end());
-    stats.accumulate(InMemoryTermList::get_wdf(), document_length,
-		     InMemoryTermList::get_termfreq(),
-		     db->get_doccount());
+    stats.accumulate(InMemoryTermList::get_wdf(), document_length);
+    if (stats.need_subdb_stats())
+	stats.accumulate_subdb(InMemoryTermList::get_termfreq(),
+			       db->get_doccount());
 }
 
 string
@@ -55,10 +55,9 @@ NetworkTermList::accumulate_stats(Xapian::Internal::ExpandStats & stats) const
     Assert(started);
     Assert(!at_end());
 
-    stats.accumulate(current_position->wdf,
-		     document_length,
-		     current_position->termfreq,
-		     database_size);
+    stats.accumulate(current_position->wdf, document_length);
+    if (stats.need_subdb_stats())
+	stats.accumulate_subdb(current_position->termfreq, database_size);
 }
 
 string
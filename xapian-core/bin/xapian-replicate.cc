@@ -62,7 +62,13 @@ static void show_usage() {
 "                      no timeout (default: " STRINGIZE(DEFAULT_TIMEOUT) ")\n"
 "  -f, --force-copy    force a full copy of the database to be sent (and then\n"
 "                      replicate as normal)\n"
+"  -d, --delta-copy    if a full copy is needed, only send the parts of files\n"
+"                      which differ from the replica (this reads the whole of\n"
+"                      the replica when a full copy is needed)\n"
 "  -o, --one-shot      replicate only once and then exit\n"
+"  -s, --stream        keep the connection open and apply changes as soon as the\n"
+"                      master commits them (the socket timeout should be 0 or\n"
+"                      longer than the master is ever idle for)\n"
 "  -q, --quiet         only report errors\n"
 "  -v, --verbose       be more verbose\n"
 "  --help              display this help and exit\n"
@@ -72,7 +78,7 @@ static void show_usage() {
 int
 main(int argc, char **argv)
 {
-    const char * opts = "h:p:m:i:r:t:ofqv";
+    const char * opts = "h:p:m:i:r:t:osfdqv";
     const struct option long_opts[] = {
 	{"host",	required_argument,	0, 'h'},
 	{"port",	required_argument,	0, 'p'},
@@ -81,7 +87,9 @@ main(int argc, char **argv)
 	{"reader-time",	required_argument,	0, 'r'},
 	{"timeout",	required_argument,	0, 't'},
 	{"one-shot",	no_argument,		0, 'o'},
+	{"stream",	no_argument,		0, 's'},
 	{"force-copy",	no_argument,		0, 'f'},
+	{"delta-copy",	no_argument,		0, 'd'},
 	{"quiet",	no_argument,		0, 'q'},
 	{"verbose",	no_argument,		0, 'v'},
 	{"help",	no_argument, 0, OPT_HELP},
@@ -94,8 +102,10 @@ main(int argc, char **argv)
     string masterdb;
     int interval = DEFAULT_INTERVAL;
     bool one_shot = false;
+    bool stream = false;
     enum { NORMAL, VERBOSE, QUIET } verbosity = NORMAL;
     bool force_copy = false;
+    bool delta_copy = false;
     int reader_close_time = READER_CLOSE_TIME;
     int timeout = DEFAULT_TIMEOUT;
 
@@ -123,9 +133,15 @@ main(int argc, char **argv)
 	    case 'f':
 		force_copy = true;
 		break;
+	    case 'd':
+		delta_copy = true;
+		break;
 	    case 'o':
 		one_shot = true;
 		break;
+	    case 's':
+		stream = true;
+		break;
 	    case 'q':
 		verbosity = QUIET;
 		break;
@@ -174,30 +190,37 @@ main(int argc, char **argv)
 		cout << "Connecting to " << host << ":" << port << endl;
 	    }
 	    ReplicateTcpClient client(host, port, 10.0, timeout);
-	    if (verbosity == VERBOSE) {
-		cout << "Getting update for " << dbpath << " from "
-		     << masterdb << endl;
-	    }
-	    Xapian::ReplicationInfo info;
-	    client.update_from_master(dbpath, masterdb, info,
-				      reader_close_time, force_copy);
-	    if (verbosity == VERBOSE) {
-		cout << "Update complete: "
-		     << info.fullcopy_count << " copies, "
-		     << info.changeset_count << " changesets, "
-		     << (info.changed ? "new live database"
-				      : "no changes to live database")
-		     <<	endl;
-	    }
-	    if (verbosity != QUIET) {
-		if (info.fullcopy_count > 0 && !info.changed) {
-		    cout <<
+	    // In streaming mode, the master pushes each new revision over the
+	    // same connection, so we only return to the outer loop (and
+	    // reconnect, resuming from the revision we've reached) if that
+	    // connection fails.
+	    do {
+		if (verbosity == VERBOSE) {
+		    cout << "Getting update for " << dbpath << " from "
+			 << masterdb << endl;
+		}
+		Xapian::ReplicationInfo info;
+		client.update_from_master(dbpath, masterdb, info,
+					  reader_close_time, force_copy,
+					  stream && !one_shot, delta_copy);
+		if (verbosity == VERBOSE) {
+		    cout << "Update complete: "
+			 << info.fullcopy_count << " copies, "
+			 << info.changeset_count << " changesets, "
+			 << (info.changed ? "new live database"
+					  : "no changes to live database")
+			 <<	endl;
+		}
+		if (verbosity != QUIET) {
+		    if (info.fullcopy_count > 0 && !info.changed) {
+			cout <<
 "Replication using a full copy failed.  This usually means that the master\n"
 "database is changing too frequently.  Ensure that sufficient changesets are\n"
 "present by setting XAPIAN_MAX_CHANGESETS on the master." << endl;
+		    }
 		}
-	    }
-	    force_copy = false;
+		force_copy = false;
+	    } while (stream && !one_shot);
 	} catch (const Xapian::NetworkError &error) {
 	    // Don't stop running if there's a network error - just log to
 	    // stderr and retry at next timeout.  This should make the client
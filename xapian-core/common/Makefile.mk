@@ -6,6 +6,7 @@ noinst_HEADERS +=\
 	common/closefrom.h\
 	common/compression_stream.h\
 	common/debuglog.h\
+	common/docidbitmap.h\
 	common/errno_to_string.h\
 	common/exp10.h\
 	common/fd.h\
@@ -41,6 +42,7 @@ noinst_HEADERS +=\
 	common/safewindows.h\
 	common/safewinsock2.h\
 	common/serialise-double.h\
+	common/sha256.h\
 	common/socket_utils.h\
 	common/str.h\
 	common/stringutils.h\
@@ -57,6 +59,7 @@ lib_src +=\
 	common/bitstream.cc\
 	common/closefrom.cc\
 	common/debuglog.cc\
+	common/docidbitmap.cc\
 	common/errno_to_string.cc\
 	common/fileutils.cc\
 	common/io_utils.cc\
@@ -67,6 +70,7 @@ lib_src +=\
 	common/replicate_utils.cc\
 	common/safe.cc\
 	common/serialise-double.cc\
+	common/sha256.cc\
 	common/socket_utils.cc\
 	common/str.cc
 
@@ -0,0 +1,229 @@
+/** @file docidbitmap.cc
+ * @brief Compressed bitmap of document ids
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "docidbitmap.h"
+
+#include "omassert.h"
+
+#include <algorithm>
+#include <bitset>
+#include <iterator>
+
+using namespace std;
+
+/// Count the bits set in @a w.
+static inline unsigned
+count_bits(uint64_t w)
+{
+    return unsigned(bitset<64>(w).count());
+}
+
+/// Return the index of the lowest bit set in @a w, which mustn't be 0.
+static inline unsigned
+lowest_bit(uint64_t w)
+{
+    Assert(w);
+    return count_bits((w & (~w + 1)) - 1);
+}
+
+void
+DocIdBitmap::normalise(Chunk & chunk)
+{
+    if (chunk.bits.empty()) {
+	if (chunk.count <= ARRAY_MAX) return;
+	vector<uint64_t> bits(WORDS);
+	for (uint16_t low : chunk.array) {
+	    bits[low >> 6] |= uint64_t(1) << (low & 63);
+	}
+	swap(chunk.bits, bits);
+	vector<uint16_t>().swap(chunk.array);
+    } else {
+	if (chunk.count > ARRAY_MAX) return;
+	vector<uint16_t> array;
+	array.reserve(chunk.count);
+	for (unsigned i = 0; i != WORDS; ++i) {
+	    uint64_t w = chunk.bits[i];
+	    while (w) {
+		array.push_back(uint16_t(i * 64 + lowest_bit(w)));
+		w &= w - 1;
+	    }
+	}
+	swap(chunk.array, array);
+	vector<uint64_t>().swap(chunk.bits);
+    }
+}
+
+void
+DocIdBitmap::get_words(const Chunk & chunk, uint64_t * words)
+{
+    if (!chunk.bits.empty()) {
+	copy(chunk.bits.begin(), chunk.bits.end(), words);
+	return;
+    }
+    fill_n(words, WORDS, uint64_t(0));
+    for (uint16_t low : chunk.array) {
+	words[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+}
+
+void
+DocIdBitmap::append(Xapian::docid did)
+{
+    Xapian::docid high = did >> 16;
+    uint16_t low = uint16_t(did);
+    if (chunks.empty() || chunks.back().high != high) {
+	Assert(chunks.empty() || chunks.back().high < high);
+	chunks.push_back(Chunk(high));
+    }
+    Chunk & chunk = chunks.back();
+    if (chunk.bits.empty()) {
+	Assert(chunk.array.empty() || chunk.array.back() < low);
+	chunk.array.push_back(low);
+    } else {
+	chunk.bits[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    ++chunk.count;
+    ++n_docs;
+    if (chunk.count == ARRAY_MAX + 1) normalise(chunk);
+}
+
+size_t
+DocIdBitmap::get_memory_used() const
+{
+    size_t bytes = sizeof(*this) + chunks.capacity() * sizeof(Chunk);
+    for (const Chunk & chunk : chunks) {
+	bytes += chunk.array.capacity() * sizeof(uint16_t);
+	bytes += chunk.bits.capacity() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+Xapian::docid
+DocIdBitmap::lower_bound(Xapian::docid did, size_t & hint) const
+{
+    Xapian::docid high = did >> 16;
+    size_t c = hint;
+    if (c < chunks.size() && chunks[c].high < high) {
+	c = std::lower_bound(chunks.begin() + c, chunks.end(), high,
+			     [](const Chunk & chunk, Xapian::docid h) {
+				 return chunk.high < h;
+			     }) - chunks.begin();
+    }
+
+    for ( ; c < chunks.size(); ++c) {
+	const Chunk & chunk = chunks[c];
+	unsigned low = (chunk.high == high) ? (did & 0xffff) : 0;
+	unsigned result;
+	if (chunk.bits.empty()) {
+	    auto i = std::lower_bound(chunk.array.begin(), chunk.array.end(),
+				      low);
+	    if (i == chunk.array.end()) continue;
+	    result = *i;
+	} else {
+	    unsigned i = low >> 6;
+	    uint64_t w = chunk.bits[i] & (~uint64_t(0) << (low & 63));
+	    while (w == 0) {
+		if (++i == WORDS) break;
+		w = chunk.bits[i];
+	    }
+	    if (w == 0) continue;
+	    result = i * 64 + lowest_bit(w);
+	}
+	hint = c;
+	return (chunk.high << 16) | result;
+    }
+    hint = c;
+    return 0;
+}
+
+DocIdBitmap *
+DocIdBitmap::combine(const DocIdBitmap & a, const DocIdBitmap & b, op o)
+{
+    DocIdBitmap * result = new DocIdBitmap;
+    auto i = a.chunks.begin();
+    auto j = b.chunks.begin();
+    vector<uint64_t> a_words(WORDS), b_words(WORDS);
+    while (i != a.chunks.end() || j != b.chunks.end()) {
+	if (j == b.chunks.end() ||
+	    (i != a.chunks.end() && i->high < j->high)) {
+	    // Chunk only in a.
+	    if (o != AND) result->chunks.push_back(*i);
+	    ++i;
+	    continue;
+	}
+	if (i == a.chunks.end() || j->high < i->high) {
+	    // Chunk only in b.
+	    if (o == OR) result->chunks.push_back(*j);
+	    ++j;
+	    continue;
+	}
+
+	Chunk chunk(i->high);
+	if (i->bits.empty() && j->bits.empty()) {
+	    auto out = back_inserter(chunk.array);
+	    switch (o) {
+		case AND:
+		    set_intersection(i->array.begin(), i->array.end(),
+				     j->array.begin(), j->array.end(), out);
+		    break;
+		case OR:
+		    set_union(i->array.begin(), i->array.end(),
+			      j->array.begin(), j->array.end(), out);
+		    break;
+		case AND_NOT:
+		    set_difference(i->array.begin(), i->array.end(),
+				   j->array.begin(), j->array.end(), out);
+		    break;
+	    }
+	    chunk.count = chunk.array.size();
+	} else {
+	    get_words(*i, a_words.data());
+	    get_words(*j, b_words.data());
+	    // Combine into a_words.
+	    switch (o) {
+		case AND:
+		    for (unsigned k = 0; k != WORDS; ++k)
+			a_words[k] &= b_words[k];
+		    break;
+		case OR:
+		    for (unsigned k = 0; k != WORDS; ++k)
+			a_words[k] |= b_words[k];
+		    break;
+		case AND_NOT:
+		    for (unsigned k = 0; k != WORDS; ++k)
+			a_words[k] &= ~b_words[k];
+		    break;
+	    }
+	    for (uint64_t w : a_words) {
+		chunk.count += count_bits(w);
+	    }
+	    chunk.bits = a_words;
+	}
+	normalise(chunk);
+	if (chunk.count) result->chunks.push_back(std::move(chunk));
+	++i;
+	++j;
+    }
+
+    for (const Chunk & chunk : result->chunks) {
+	result->n_docs += chunk.count;
+    }
+    return result;
+}
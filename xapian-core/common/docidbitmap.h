@@ -0,0 +1,114 @@
+/** @file docidbitmap.h
+ * @brief Compressed bitmap of document ids
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCIDBITMAP_H
+#define XAPIAN_INCLUDED_DOCIDBITMAP_H
+
+#include "xapian/intrusive_ptr.h"
+#include <xapian/types.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/** Compressed bitmap of document ids.
+ *
+ *  As in "Roaring" bitmaps, the docid space is split into chunks of 65536
+ *  docids.  Each non-empty chunk stores the low 16 bits of its docids either
+ *  as a sorted array, or if it has more than ARRAY_MAX of them, as a bitmap.
+ *  So a chunk never needs more than 8KB, and a sparse chunk needs 2 bytes
+ *  per docid.
+ */
+class DocIdBitmap : public Xapian::Internal::intrusive_base {
+    /// Don't allow assignment.
+    void operator=(const DocIdBitmap &);
+
+    /// Don't allow copying.
+    DocIdBitmap(const DocIdBitmap &);
+
+    /// The most docids a chunk stores as an array.
+    static const unsigned ARRAY_MAX = 4096;
+
+    /// The number of 64-bit words in a chunk's bitmap.
+    static const unsigned WORDS = 65536 / 64;
+
+    /// The docids which share the same top 16 bits.
+    struct Chunk {
+	/// The top 16 bits of the docids in this chunk.
+	Xapian::docid high;
+
+	/// The number of docids in this chunk.
+	unsigned count;
+
+	/// The low 16 bits of each docid, if count <= ARRAY_MAX.
+	std::vector<uint16_t> array;
+
+	/// Bitmap of the low 16 bits, if count > ARRAY_MAX.
+	std::vector<uint64_t> bits;
+
+	explicit Chunk(Xapian::docid high_) : high(high_), count(0) { }
+    };
+
+    /// The non-empty chunks, in ascending order of high.
+    std::vector<Chunk> chunks;
+
+    /// The number of docids in the bitmap.
+    Xapian::doccount n_docs;
+
+    /// Switch a chunk to (or from) a bitmap to suit its count.
+    static void normalise(Chunk & chunk);
+
+    /// Set words[] to the bitmap for a chunk.
+    static void get_words(const Chunk & chunk, uint64_t * words);
+
+  public:
+    /// The operations combine() supports.
+    typedef enum { AND, OR, AND_NOT } op;
+
+    /// Construct an empty bitmap.
+    DocIdBitmap() : n_docs(0) { }
+
+    /** Add a docid.
+     *
+     *  @param did  The docid to add, which must be greater than any docid
+     *		    already added.
+     */
+    void append(Xapian::docid did);
+
+    /// Return the number of docids in the bitmap.
+    Xapian::doccount size() const { return n_docs; }
+
+    /// Return roughly how many bytes of memory the bitmap uses.
+    size_t get_memory_used() const;
+
+    /** Return the first docid >= @a did, or 0 if there isn't one.
+     *
+     *  @param hint	The index of the chunk to start looking in, which is
+     *			updated to the chunk the result is in.  For a sequence
+     *			of calls with ascending @a did this avoids searching
+     *			from the start each time.  Start with 0.
+     */
+    Xapian::docid lower_bound(Xapian::docid did, size_t & hint) const;
+
+    /// Return a new bitmap which is @a a combined with @a b using @a o.
+    static DocIdBitmap * combine(const DocIdBitmap & a,
+				 const DocIdBitmap & b,
+				 op o);
+};
+
+#endif // XAPIAN_INCLUDED_DOCIDBITMAP_H
@@ -49,7 +49,8 @@
 // 37: 1.3.1 Prefix-compress termlists.
 // 38: 1.3.2 Stats serialisation now includes collection freq, and more...
 // 39: 1.3.3 New query operator OP_WILDCARD; sort keys in serialised MSet.
-#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 39
+// 40: 1.5.0 ValueCountMatchSpy results include the number of docs sampled.
+#define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 40
 #define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
 
 /** Message types (client -> server).
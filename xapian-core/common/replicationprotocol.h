@@ -21,10 +21,18 @@
 #ifndef XAPIAN_INCLUDED_REPLICATIONPROTOCOL_H
 #define XAPIAN_INCLUDED_REPLICATIONPROTOCOL_H
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
 // Versions:
 // 1: Initial support
+// 1.1: Streaming mode, requested by sending 'S' instead of 'R'
+// 1.2: Chunk-level delta database copies.  The client offers checksums with
+//      an empty 'C' message before the 'R' or 'S' message, and sends them in
+//      a 'C' message if the server replies with DB_BASIS_REQUEST
 #define XAPIAN_REPLICATION_PROTOCOL_MAJOR_VERSION 1
-#define XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION 0
+#define XAPIAN_REPLICATION_PROTOCOL_MINOR_VERSION 2
 
 // Reply types (master -> slave)
 enum replicate_reply_type {
@@ -34,7 +42,10 @@ enum replicate_reply_type {
     REPL_REPLY_DB_FILENAME,	// The name of a file in a DB copy.
     REPL_REPLY_DB_FILEDATA,	// Contents of a file in a DB copy.
     REPL_REPLY_DB_FOOTER,	// End of a whole DB copy.
-    REPL_REPLY_CHANGESET	// A changeset file is being sent.
+    REPL_REPLY_CHANGESET,	// A changeset file is being sent.
+    REPL_REPLY_DB_FILEDELTA,	// Part of a file in a DB copy, as a delta.
+    REPL_REPLY_DB_FILEDELTA_END,	// End of a file sent as deltas.
+    REPL_REPLY_DB_BASIS_REQUEST	// Request for the client's checksums.
 };
 
 // The maximum number of copies of a database to send in a single conversation.
@@ -42,4 +53,52 @@ enum replicate_reply_type {
 // sent.
 #define MAX_DB_COPIES_PER_CONVERSATION 5
 
+// How often (in seconds) a master in streaming mode checks for a new revision.
+#define STREAM_POLL_INTERVAL 0.1
+
+// The smallest size of chunk which database files are compared in when
+// sending a delta copy.  This is the default glass block size.
+#define REPL_MIN_CHUNK_SIZE 8192
+
+// Larger files are compared in larger chunks, to keep the number of checksums
+// sent for a file below this.
+#define REPL_MAX_CHUNKS_PER_FILE 0x100000
+
+/// The chunk size to use when checksumming a file of @a file_size bytes.
+inline std::size_t
+repl_chunk_size(unsigned long long file_size)
+{
+    std::size_t chunk_size = REPL_MIN_CHUNK_SIZE;
+    while (file_size / chunk_size >= REPL_MAX_CHUNKS_PER_FILE)
+	chunk_size <<= 1;
+    return chunk_size;
+}
+
+/** Checksum a chunk of a database file for a delta copy.
+ *
+ *  This is 64-bit FNV-1a, seeded with the length so that a short chunk at the
+ *  end of a file never matches a longer one.
+ */
+inline std::uint64_t
+repl_chunk_checksum(const char * p, std::size_t len)
+{
+    std::uint64_t h = 14695981039346656037ULL ^ len;
+    while (len--) {
+	h ^= static_cast<unsigned char>(*p++);
+	h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/// Append the checksum of a chunk to @a buf, as 8 bytes.
+inline void
+repl_append_chunk_checksum(std::string & buf, const char * p, std::size_t len)
+{
+    std::uint64_t h = repl_chunk_checksum(p, len);
+    for (int i = 0; i != 8; ++i) {
+	buf += char(h);
+	h >>= 8;
+    }
+}
+
 #endif // XAPIAN_INCLUDED_REPLICATIONPROTOCOL_H
@@ -0,0 +1,64 @@
+/** @file sha256.h
+ * @brief SHA-256 message digest
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_SHA256_H
+#define XAPIAN_INCLUDED_SHA256_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// The length of a SHA-256 digest in bytes.
+#define SHA256_DIGEST_LEN 32
+
+/** SHA-256 message digest, as specified in FIPS 180-4.
+ *
+ *  Used to check that a file reassembled from parts sent over the network
+ *  matches the original.
+ */
+class SHA256 {
+    /// The hash state.
+    std::uint32_t h[8];
+
+    /// Data which doesn't yet fill a whole block.
+    unsigned char block[64];
+
+    /// The number of bytes in block.
+    std::size_t block_len;
+
+    /// The total number of bytes added.
+    std::uint64_t total_len;
+
+    /// Process the 64 byte block at @a p.
+    void transform(const unsigned char * p);
+
+  public:
+    SHA256();
+
+    /// Add @a len bytes at @a p to the data being hashed.
+    void update(const char * p, std::size_t len);
+
+    /** Return the digest of the data added.
+     *
+     *  The result is SHA256_DIGEST_LEN bytes long.  The object shouldn't be
+     *  updated after this is called.
+     */
+    std::string digest();
+};
+
+#endif // XAPIAN_INCLUDED_SHA256_H
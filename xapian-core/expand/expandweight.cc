@@ -42,7 +42,8 @@ ExpandWeight::collect_stats(TermList * merger, const std::string & term)
 
     merger->accumulate_stats(stats);
 
-    collection_freq = db.get_collection_freq(term);
+    if (need_collection_freq)
+	collection_freq = db.get_collection_freq(term);
 
     double termfreq = stats.termfreq;
     double rtermfreq = stats.rtermfreq;
@@ -26,6 +26,7 @@
 
 #include "api/termlist.h"
 #include "internaltypes.h"
+#include "omassert.h"
 
 #include <string>
 #include <vector>
@@ -77,8 +78,8 @@ class ExpandStats {
 
     }
 
-    void accumulate(Xapian::termcount wdf, Xapian::termcount doclen,
-		    Xapian::doccount subtf, Xapian::doccount subdbsize)
+    /// Accumulate the statistics for the term in one document in the RSet.
+    void accumulate(Xapian::termcount wdf, Xapian::termcount doclen)
     {
 	// Boolean terms may have wdf == 0, but treat that as 1 so such terms
 	// get a non-zero weight.
@@ -87,15 +88,27 @@ class ExpandStats {
 	rcollection_freq += wdf;
 
 	multiplier += (expand_k + 1) * wdf / (expand_k * doclen / avlen + wdf);
+    }
+
+    /** Do we still need the term's statistics for the current sub-database?
+     *
+     *  The term frequency is the same for every document in a sub-database,
+     *  and looking it up can mean a B-tree lookup, so callers should check
+     *  this and only call accumulate_subdb() once per sub-database.
+     */
+    bool need_subdb_stats() const
+    {
+	return db_index >= dbs_seen.size() || !dbs_seen[db_index];
+    }
 
-	// If we've not seen this sub-database before, then update dbsize and
-	// termfreq and note that we have seen it.
-	if (db_index >= dbs_seen.size() || !dbs_seen[db_index]) {
-	    if (db_index >= dbs_seen.size()) dbs_seen.resize(db_index + 1);
-	    dbs_seen[db_index] = true;
-	    dbsize += subdbsize;
-	    termfreq += subtf;
-	}
+    /// Accumulate the term's statistics for the current sub-database.
+    void accumulate_subdb(Xapian::doccount subtf, Xapian::doccount subdbsize)
+    {
+	AssertParanoid(need_subdb_stats());
+	if (db_index >= dbs_seen.size()) dbs_seen.resize(db_index + 1);
+	dbs_seen[db_index] = true;
+	dbsize += subdbsize;
+	termfreq += subtf;
     }
 
     /* Clear the statistics collected in the ExpandStats object before using it
@@ -144,6 +157,14 @@ class ExpandWeight {
      */
     bool use_exact_termfreq;
 
+  protected:
+    /** Does get_weight() use the collection frequency?
+     *
+     *  Looking it up costs a B-tree lookup per candidate term, so we only do
+     *  so for schemes which need it.
+     */
+    bool need_collection_freq = false;
+
   public:
     /** Constructor.
      *
@@ -260,7 +281,9 @@ class Bo1EWeight : public ExpandWeight {
     Bo1EWeight(const Xapian::Database &db_,
 	       Xapian::doccount rsize_,
 	       bool use_exact_termfreq_)
-	: ExpandWeight(db_, rsize_, use_exact_termfreq_) {}
+	: ExpandWeight(db_, rsize_, use_exact_termfreq_) {
+	need_collection_freq = true;
+    }
 
     double get_weight() const;
 };
@@ -8,5 +8,6 @@ lib_src += \
 	geospatial/geoencode.cc \
 	geospatial/latlongcoord.cc \
 	geospatial/latlong_distance_keymaker.cc \
+	geospatial/latlong_grid.cc \
 	geospatial/latlong_metrics.cc \
 	geospatial/latlong_posting_source.cc
@@ -37,9 +37,7 @@ LatLongDistanceKeyMaker::operator()(const Document &doc) const
     if (val.empty()) {
 	return defkey;
     }
-    LatLongCoords doccoords;
-    doccoords.unserialise(val);
-    double distance = (*metric)(centre, doccoords);
+    double distance = (*metric)(centre, val);
     return sortable_serialise(distance);
 }
 
@@ -0,0 +1,254 @@
+/** @file latlong_grid.cc
+ * @brief LatLongGrid implementation.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "xapian/geospatial.h"
+#include "xapian/error.h"
+
+#include <cmath>
+#include <set>
+
+using namespace Xapian;
+using namespace std;
+
+/** Quadratic mean radius of the Earth in metres.
+ */
+#define QUAD_EARTH_RADIUS_METRES 6372797.6
+
+/** Set M_PI if it's not already set.
+ */
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/// The finest level supported (so the cell number fits in 50 bits).
+#define GRID_MAX_LEVEL 25
+
+/** The number of cells a cover query should aim not to exceed.
+ *
+ *  We pick the finest level which needs no more cells than this, so the
+ *  OR query stays cheap while the cells hug the range reasonably closely.
+ */
+#define GRID_MAX_COVER_CELLS 64
+
+/// Return the latitude band containing @a lat at a level with @a n bands.
+static long long
+lat_band(double lat, long long n)
+{
+    long long band = static_cast<long long>(floor((lat + 90.0) * n / 180.0));
+    if (band < 0) return 0;
+    if (band >= n) return n - 1;
+    return band;
+}
+
+/** Return the longitude band containing @a lon at a level with @a n bands.
+ *
+ *  @a lon isn't normalised, so the result may be negative or >= n - callers
+ *  reduce it modulo n when they need an actual band.
+ */
+static long long
+lon_band(double lon, long long n)
+{
+    return static_cast<long long>(floor(lon * n / 360.0));
+}
+
+/// Build the term for cell (@a lat_b, @a lon_b) at @a level.
+static string
+cell_term(const string & prefix, unsigned level,
+	  unsigned long long lat_b, unsigned long long lon_b)
+{
+    unsigned long long z = 0;
+    for (unsigned i = level; i != 0; --i) {
+	z = (z << 2) |
+	    (((lat_b >> (i - 1)) & 1) << 1) |
+	    ((lon_b >> (i - 1)) & 1);
+    }
+    string term(prefix);
+    term += char('a' + level);
+    // Two bits per level, so each hex digit encodes two levels.
+    for (unsigned i = (level + 1) / 2; i != 0; --i) {
+	term += "0123456789abcdef"[(z >> ((i - 1) * 4)) & 0x0f];
+    }
+    return term;
+}
+
+/// The latitude-longitude bounding box of the range around one centre.
+struct BBox {
+    double lat_lo, lat_hi, lon_lo, lon_hi;
+    bool all_lon;
+};
+
+/// The bands covering one BBox at a particular level.
+struct CoverRange {
+    long long lat_lo, lat_hi;
+    long long lon_lo, lon_hi;
+    bool all_lon;
+};
+
+LatLongGrid::LatLongGrid(const string & prefix_,
+			 unsigned min_level_,
+			 unsigned max_level_)
+    : prefix(prefix_), min_level(min_level_), max_level(max_level_),
+      radius(QUAD_EARTH_RADIUS_METRES)
+{
+    if (max_level > GRID_MAX_LEVEL)
+	throw InvalidArgumentError("LatLongGrid max_level must be <= 25");
+    if (min_level > max_level)
+	throw InvalidArgumentError("LatLongGrid min_level must be <= max_level");
+}
+
+LatLongGrid::LatLongGrid(const string & prefix_,
+			 unsigned min_level_,
+			 unsigned max_level_,
+			 double radius_)
+    : prefix(prefix_), min_level(min_level_), max_level(max_level_),
+      radius(radius_)
+{
+    if (max_level > GRID_MAX_LEVEL)
+	throw InvalidArgumentError("LatLongGrid max_level must be <= 25");
+    if (min_level > max_level)
+	throw InvalidArgumentError("LatLongGrid min_level must be <= max_level");
+    if (radius <= 0)
+	throw InvalidArgumentError("LatLongGrid radius must be > 0");
+}
+
+string
+LatLongGrid::get_cell_term(const LatLongCoord & coord, unsigned level) const
+{
+    if (level > GRID_MAX_LEVEL)
+	throw InvalidArgumentError("LatLongGrid level must be <= 25");
+    long long n = 1ll << level;
+    // The longitude is already normalised to [0, 360), but guard against
+    // rounding pushing it up to n.
+    long long lon_b = lon_band(coord.longitude, n);
+    if (lon_b >= n) lon_b = n - 1;
+    return cell_term(prefix, level, lat_band(coord.latitude, n), lon_b);
+}
+
+void
+LatLongGrid::index(Xapian::Document & doc, const LatLongCoords & coords) const
+{
+    // Use the coordinates as they'll be read back from the value slot, so a
+    // coordinate right on a cell boundary gets the cell the posting source
+    // would put it in.
+    LatLongCoords stored;
+    stored.unserialise(coords.serialise());
+    for (LatLongCoordsIterator i = stored.begin(); i != stored.end(); ++i) {
+	for (unsigned level = min_level; level <= max_level; ++level) {
+	    doc.add_boolean_term(get_cell_term(*i, level));
+	}
+    }
+}
+
+Query
+LatLongGrid::get_cover_query(const LatLongCoords & centre,
+			     double max_range) const
+{
+    if (centre.empty())
+	throw InvalidArgumentError("Empty coordinate list supplied to LatLongGrid::get_cover_query()");
+    if (max_range <= 0.0)
+	return Query::MatchAll;
+
+    // The angle subtended by max_range, padded a little so that rounding
+    // in the distance calculation can't cause us to exclude a document the
+    // posting source would accept.
+    double a = max_range / radius * (1 + 1e-6) + 1e-12;
+    if (a >= M_PI)
+	return Query::MatchAll;
+    double dlat = a * (180.0 / M_PI);
+
+    // The bounding box of each circle: the latitude range is simple, and
+    // the longitude range is that of the points where the great circle
+    // through the pole is tangent to the circle.  If the circle contains a
+    // pole, every longitude is in range.
+    vector<BBox> boxes;
+    boxes.reserve(centre.size());
+    for (LatLongCoordsIterator i = centre.begin(); i != centre.end(); ++i) {
+	const LatLongCoord & c = *i;
+	BBox box;
+	box.lat_lo = c.latitude - dlat;
+	box.lat_hi = c.latitude + dlat;
+	box.all_lon = false;
+	if (box.lat_lo <= -90.0) {
+	    box.lat_lo = -90.0;
+	    box.all_lon = true;
+	}
+	if (box.lat_hi >= 90.0) {
+	    box.lat_hi = 90.0;
+	    box.all_lon = true;
+	}
+	if (!box.all_lon) {
+	    double s = sin(a) / cos(c.latitude * (M_PI / 180.0));
+	    if (s >= 1.0) {
+		box.all_lon = true;
+	    } else {
+		double dlon = asin(s) * (180.0 / M_PI);
+		box.lon_lo = c.longitude - dlon;
+		box.lon_hi = c.longitude + dlon;
+	    }
+	}
+	boxes.push_back(box);
+    }
+
+    // Pick the finest level which covers all the boxes with a modest number
+    // of cells, falling back to the coarsest level.
+    unsigned level = max_level;
+    vector<CoverRange> ranges(boxes.size());
+    unsigned long long cells;
+    while (true) {
+	long long n = 1ll << level;
+	cells = 0;
+	for (size_t j = 0; j != boxes.size(); ++j) {
+	    const BBox & box = boxes[j];
+	    CoverRange & r = ranges[j];
+	    r.lat_lo = lat_band(box.lat_lo, n);
+	    r.lat_hi = lat_band(box.lat_hi, n);
+	    r.all_lon = box.all_lon;
+	    if (!r.all_lon) {
+		r.lon_lo = lon_band(box.lon_lo, n);
+		r.lon_hi = lon_band(box.lon_hi, n);
+		if (r.lon_hi - r.lon_lo + 1 >= n) r.all_lon = true;
+	    }
+	    long long lon_cells = r.all_lon ? n : r.lon_hi - r.lon_lo + 1;
+	    cells += (r.lat_hi - r.lat_lo + 1) * lon_cells;
+	}
+	if (cells <= GRID_MAX_COVER_CELLS || level == min_level) break;
+	--level;
+    }
+
+    // If even the coarsest level needs a huge number of cells, the cover
+    // would cost more than it saves.
+    if (level == 0 || cells > GRID_MAX_COVER_CELLS * 16)
+	return Query::MatchAll;
+
+    long long n = 1ll << level;
+    set<string> terms;
+    for (const CoverRange & r : ranges) {
+	long long lon_lo = r.all_lon ? 0 : r.lon_lo;
+	long long lon_hi = r.all_lon ? n - 1 : r.lon_hi;
+	for (long long lat_b = r.lat_lo; lat_b <= r.lat_hi; ++lat_b) {
+	    for (long long lon = lon_lo; lon <= lon_hi; ++lon) {
+		long long lon_b = ((lon % n) + n) % n;
+		terms.insert(cell_term(prefix, level, lat_b, lon_b));
+	    }
+	}
+    }
+    return Query(Query::OP_OR, terms.begin(), terms.end());
+}
@@ -41,10 +41,56 @@ using namespace std;
 #define M_PI 3.14159265358979323846
 #endif
 
+/** How many coordinates to calculate distances to in one batch.
+ *
+ *  The coordinates are unpacked into a buffer on the stack, so this bounds
+ *  the stack space used while avoiding per-call heap allocation.
+ */
+#define DISTANCE_BATCH_SIZE 16
+
 LatLongMetric::~LatLongMetric()
 {
 }
 
+void
+LatLongMetric::pointwise_distances(const LatLongCoord & a,
+				   const LatLongCoord * b, size_t n,
+				   double * result) const
+{
+    for (size_t i = 0; i != n; ++i) {
+	result[i] = pointwise_distance(a, b[i]);
+    }
+}
+
+/** Update @a min_dist with the distances from @a a to a batch of coordinates.
+ *
+ *  Each coordinate in @a a is passed to pointwise_distances() with the whole
+ *  batch in turn.
+ */
+static void
+min_batch_distance(const LatLongMetric & metric,
+		   const LatLongCoords & a,
+		   const LatLongCoord * batch, size_t n,
+		   double & min_dist, bool & have_min)
+{
+    double dists[DISTANCE_BATCH_SIZE];
+    for (LatLongCoordsIterator a_iter = a.begin();
+	 a_iter != a.end();
+	 ++a_iter)
+    {
+	metric.pointwise_distances(*a_iter, batch, n, dists);
+	size_t i = 0;
+	if (!have_min) {
+	    min_dist = dists[0];
+	    have_min = true;
+	    i = 1;
+	}
+	for ( ; i != n; ++i) {
+	    if (dists[i] < min_dist) min_dist = dists[i];
+	}
+    }
+}
+
 double
 LatLongMetric::operator()(const LatLongCoords & a,
 			  const LatLongCoords &b) const
@@ -54,23 +100,19 @@ LatLongMetric::operator()(const LatLongCoords & a,
     }
     double min_dist = 0.0;
     bool have_min = false;
-    for (LatLongCoordsIterator a_iter = a.begin();
-	 a_iter != a.end();
-	 ++a_iter)
+    LatLongCoord batch[DISTANCE_BATCH_SIZE];
+    size_t n = 0;
+    for (LatLongCoordsIterator b_iter = b.begin();
+	 b_iter != b.end();
+	 ++b_iter)
     {
-	for (LatLongCoordsIterator b_iter = b.begin();
-	     b_iter != b.end();
-	     ++b_iter)
-	{
-	    double dist = pointwise_distance(*a_iter, *b_iter);
-	    if (!have_min) {
-		min_dist = dist;
-		have_min = true;
-	    } else if (dist < min_dist) {
-		min_dist = dist;
-	    }
+	batch[n++] = *b_iter;
+	if (n == DISTANCE_BATCH_SIZE) {
+	    min_batch_distance(*this, a, batch, n, min_dist, have_min);
+	    n = 0;
 	}
     }
+    if (n) min_batch_distance(*this, a, batch, n, min_dist, have_min);
     return min_dist;
 }
 
@@ -83,23 +125,17 @@ LatLongMetric::operator()(const LatLongCoords & a,
     }
     double min_dist = 0.0;
     bool have_min = false;
-    LatLongCoord b;
+    LatLongCoord batch[DISTANCE_BATCH_SIZE];
+    size_t n = 0;
     const char * b_end = b_ptr + b_len;
     while (b_ptr != b_end) {
-	b.unserialise(&b_ptr, b_end);
-	for (LatLongCoordsIterator a_iter = a.begin();
-	     a_iter != a.end();
-	     ++a_iter)
-	{
-	    double dist = pointwise_distance(*a_iter, b);
-	    if (!have_min) {
-		min_dist = dist;
-		have_min = true;
-	    } else if (dist < min_dist) {
-		min_dist = dist;
-	    }
+	batch[n++].unserialise(&b_ptr, b_end);
+	if (n == DISTANCE_BATCH_SIZE) {
+	    min_batch_distance(*this, a, batch, n, min_dist, have_min);
+	    n = 0;
 	}
     }
+    if (n) min_batch_distance(*this, a, batch, n, min_dist, have_min);
     return min_dist;
 }
 
@@ -133,6 +169,34 @@ GreatCircleMetric::pointwise_distance(const LatLongCoord & a,
     return 2 * radius * asin(sqrt(h));
 }
 
+void
+GreatCircleMetric::pointwise_distances(const LatLongCoord & a,
+				       const LatLongCoord * b, size_t n,
+				       double * result) const
+{
+    // Hoist the trigonometry which only depends on a out of the loop, and
+    // do the haversine and inverse haversine in separate passes so each loop
+    // body is straight-line code over contiguous arrays.
+    double lata = a.latitude * (M_PI / 180.0);
+    double cos_lata = cos(lata);
+    for (size_t i = 0; i != n; ++i) {
+	double latb = b[i].latitude * (M_PI / 180.0);
+
+	double latdiff = lata - latb;
+	double longdiff = (a.longitude - b[i].longitude) * (M_PI / 180.0);
+
+	double sin_half_lat = sin(latdiff / 2);
+	double sin_half_long = sin(longdiff / 2);
+	result[i] = sin_half_lat * sin_half_lat +
+		sin_half_long * sin_half_long * cos_lata * cos(latb);
+    }
+    for (size_t i = 0; i != n; ++i) {
+	double h = result[i];
+	// Clamp to 1.0, asin(1.0) = M_PI / 2.0.
+	result[i] = rare(h > 1.0) ? radius * M_PI : 2 * radius * asin(sqrt(h));
+    }
+}
+
 LatLongMetric *
 GreatCircleMetric::clone() const
 {
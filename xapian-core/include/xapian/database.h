@@ -339,7 +339,14 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	    return ValueIterator();
 	}
 
-	/// Get the length of a document.
+	/** Get the length of a document.
+	 *
+	 *  For a read-only glass database, setting XAPIAN_DOCLEN_CACHE in the
+	 *  environment to a docid makes document lengths be loaded into an
+	 *  array in memory (4 bytes per docid) on first use, if the highest
+	 *  docid in use isn't larger.  This makes lookups (e.g. by BM25 for
+	 *  each document it weights) much cheaper.
+	 */
 	Xapian::termcount get_doclength(Xapian::docid did) const;
 
 	/// Get the number of unique terms in document.
@@ -34,8 +34,10 @@
 
 #include <xapian/attributes.h>
 #include <xapian/derefwrapper.h>
+#include <xapian/document.h>
 #include <xapian/keymaker.h>
 #include <xapian/postingsource.h>
+#include <xapian/query.h>
 #include <xapian/queryparser.h> // For sortable_serialise
 #include <xapian/visibility.h>
 
@@ -310,6 +312,23 @@ class XAPIAN_VISIBILITY_DEFAULT LatLongMetric {
     virtual double pointwise_distance(const LatLongCoord & a,
 				      const LatLongCoord & b) const = 0;
 
+    /** Return the distances from one coordinate to each of several others.
+     *
+     *  This is used when calculating the distance between coordinate lists,
+     *  so that metrics can amortise work which depends only on @a a (and
+     *  arrange their loops so the compiler can vectorise them).  The default
+     *  implementation just calls pointwise_distance() for each coordinate.
+     *
+     *  @param a	The coordinate to measure from.
+     *  @param b	The coordinates to measure to.
+     *  @param n	The number of coordinates in @a b.
+     *  @param result	Array of at least @a n entries to store the distances
+     *			in, in metres.
+     */
+    virtual void pointwise_distances(const LatLongCoord & a,
+				     const LatLongCoord * b, size_t n,
+				     double * result) const;
+
     /** Return the distance between two coordinate lists, in metres.
      *
      *  The distance between the coordinate lists is defined to be the minimum
@@ -423,12 +442,123 @@ class XAPIAN_VISIBILITY_DEFAULT GreatCircleMetric : public LatLongMetric {
     double pointwise_distance(const LatLongCoord & a,
 			      const LatLongCoord &b) const;
 
+    /** Return the great-circle distances from one point to several others.
+     */
+    void pointwise_distances(const LatLongCoord & a,
+			     const LatLongCoord * b, size_t n,
+			     double * result) const;
+
     LatLongMetric * clone() const;
     std::string name() const;
     std::string serialise() const;
     LatLongMetric * unserialise(const std::string & serialised) const;
 };
 
+/** Generate grid cell terms for coordinates, and cover queries for ranges.
+ *
+ *  Experimental - see https://xapian.org/docs/deprecation#experimental-features
+ *
+ *  LatLongDistancePostingSource has to check the distance for every document
+ *  with a coordinate stored in its slot, which is slow for large databases.
+ *  This class allows a coarse spatial index to be stored as ordinary terms:
+ *  at index time, index() adds a term for the grid cell each coordinate lies
+ *  in at every level from @a min_level to @a max_level; at search time,
+ *  get_cover_query() builds a query matching the cells which might contain a
+ *  point within range of the centre.  Filtering the posting source with the
+ *  cover query means only documents in nearby cells need their distance
+ *  calculated:
+ *
+ *  @code
+ *  Xapian::LatLongGrid grid("XG");
+ *  Xapian::LatLongDistancePostingSource ps(slot, centre, range);
+ *  Xapian::Query q(Xapian::Query::OP_FILTER,
+ *		    Xapian::Query(&ps),
+ *		    grid.get_cover_query(centre, range));
+ *  @endcode
+ *
+ *  At level L, latitude is divided into 2**L equal bands and longitude into
+ *  2**L equal bands, and the cell number interleaves the bits of the two band
+ *  numbers (a Z-order curve, as used by geohash).  The cover query never
+ *  excludes a cell containing a point within range, so the filtered query
+ *  returns exactly the same documents as the posting source alone, provided
+ *  every document was indexed with the same grid parameters.
+ */
+class XAPIAN_VISIBILITY_DEFAULT LatLongGrid {
+    /// The term prefix to use.
+    std::string prefix;
+
+    /// The coarsest level to index.
+    unsigned min_level;
+
+    /// The finest level to index.
+    unsigned max_level;
+
+    /// The radius of the sphere in metres.
+    double radius;
+
+  public:
+    /** Construct a LatLongGrid.
+     *
+     *  The (quadratic mean) radius of the Earth is used when converting
+     *  ranges to angles, which matches the default GreatCircleMetric.
+     *
+     *  @param prefix_	The term prefix to use for cell terms.
+     *  @param min_level_	The coarsest level to index (default 2).
+     *  @param max_level_	The finest level to index (default 20, which is
+     *			cells of about 20m by 40m at the equator).  The
+     *			maximum allowed is 25.
+     */
+    explicit LatLongGrid(const std::string & prefix_,
+			 unsigned min_level_ = 2,
+			 unsigned max_level_ = 20);
+
+    /** Construct a LatLongGrid using a specified radius.
+     *
+     *  @param prefix_	The term prefix to use for cell terms.
+     *  @param min_level_	The coarsest level to index.
+     *  @param max_level_	The finest level to index (at most 25).
+     *  @param radius_	The radius of the sphere to use, in metres.  This
+     *			should match the radius of the GreatCircleMetric
+     *			which the posting source uses.
+     */
+    LatLongGrid(const std::string & prefix_,
+		unsigned min_level_,
+		unsigned max_level_,
+		double radius_);
+
+    /** Return the term for the cell containing a coordinate.
+     *
+     *  @param coord	The coordinate.
+     *  @param level	The level (which needn't be between min_level and
+     *			max_level, but must be at most 25).
+     */
+    std::string get_cell_term(const LatLongCoord & coord,
+			      unsigned level) const;
+
+    /** Add the cell terms for some coordinates to a document.
+     *
+     *  The coordinates are rounded in the same way as when they are stored
+     *  in a value slot, so the terms are consistent with the coordinates the
+     *  posting source will see.  Terms are added with wdf 0.
+     *
+     *  @param doc	The document to add the terms to.
+     *  @param coords	The coordinates stored for the document.
+     */
+    void index(Xapian::Document & doc, const LatLongCoords & coords) const;
+
+    /** Return a query matching cells which might be in range of a centre.
+     *
+     *  The finest indexed level which needs a modest number of cells to
+     *  cover the range is used.  If the range is 0 (meaning no maximum
+     *  range), or it covers the whole sphere, Query::MatchAll is returned.
+     *
+     *  @param centre	The centre point (or points).
+     *  @param max_range	The maximum distance in metres.
+     */
+    Xapian::Query get_cover_query(const LatLongCoords & centre,
+				  double max_range) const;
+};
+
 /** Posting source which returns a weight based on geospatial distance.
  *
  *  Experimental - see https://xapian.org/docs/deprecation#experimental-features
@@ -34,10 +34,13 @@
 
 #include <string>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 namespace Xapian {
 
 class Document;
+class MSet;
 class Registry;
 
 /** Abstract base class for match spies.
@@ -217,11 +220,48 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
 	/// Total number of documents seen by the match spy.
 	Xapian::doccount total;
 
-	/// The values seen so far, together with their frequency.
+	/// Number of documents whose value was actually counted.
+	Xapian::doccount sampled;
+
+	/// Number of documents to count before sampling starts.
+	Xapian::doccount sample_exact;
+
+	/// Count one document in every sample_stride once sampling starts.
+	Xapian::doccount sample_stride;
+
+	/** The values seen so far, together with their frequency.
+	 *
+	 *  Counts gathered during the match are held in @a counts until
+	 *  fold_counts() is called, so this may be out of date until then.
+	 */
 	std::map<std::string, Xapian::doccount> values;
 
-	Internal() : slot(Xapian::BAD_VALUENO), total(0) {}
-	explicit Internal(Xapian::valueno slot_) : slot(slot_), total(0) {}
+	/// Dictionary mapping each distinct value seen to a dense ordinal.
+	std::unordered_map<std::string, Xapian::doccount> ordinals;
+
+	/// Counts indexed by ordinal which haven't been folded into values.
+	std::vector<Xapian::doccount> counts;
+
+	/// Ordinal of the last value counted, or -1 for none.
+	Xapian::doccount last_ordinal;
+
+	/// The last value counted (only valid if last_ordinal isn't -1).
+	std::string last_value;
+
+	Internal()
+	    : slot(Xapian::BAD_VALUENO), total(0), sampled(0),
+	      sample_exact(0), sample_stride(1),
+	      last_ordinal(Xapian::doccount(-1)) {}
+	explicit Internal(Xapian::valueno slot_)
+	    : slot(slot_), total(0), sampled(0),
+	      sample_exact(0), sample_stride(1),
+	      last_ordinal(Xapian::doccount(-1)) {}
+
+	/// Count one occurrence of non-empty value @a val.
+	void count(const std::string & val);
+
+	/// Fold any pending counts into values.
+	void fold_counts();
     };
 #endif
 
@@ -242,6 +282,65 @@ class XAPIAN_VISIBILITY_DEFAULT ValueCountMatchSpy : public MatchSpy {
 	return internal.get() ? internal->total : 0;
     }
 
+    /** Count values in only a sample of the matching documents.
+     *
+     *  Once @a exact documents have been counted, only one in every
+     *  @a stride of the documents the matcher passes to the spy after that
+     *  has its value counted.  Which documents are sampled depends only on
+     *  the order in which the matcher visits them, so repeating a search
+     *  gives the same counts.
+     *
+     *  The frequencies returned by values_begin() and top_values_begin()
+     *  are then raw counts over the sampled documents - use
+     *  get_value_freq_estimated() and the corresponding bound methods to
+     *  scale them up to the whole match.  Combined with a modest
+     *  check_at_least this allows approximate facet counts for queries
+     *  which match far too many documents to count exactly.
+     *
+     *  @param exact	Number of documents to count before sampling
+     *			starts.
+     *  @param stride	Count one in every @a stride documents after that.
+     *			A value of 1 (the default) disables sampling.
+     *
+     *  @exception Xapian::InvalidArgumentError if @a stride is 0.
+     */
+    void set_sampling(Xapian::doccount exact, Xapian::doccount stride);
+
+    /** Return the number of documents whose value was counted.
+     *
+     *  This is the same as get_total() unless sampling is in use.
+     */
+    Xapian::doccount XAPIAN_NOTHROW(get_sampled() const) {
+	return internal.get() ? internal->sampled : 0;
+    }
+
+    /** Return a lower bound on the number of matches with value @a value.
+     *
+     *  This is the number of counted documents with that value.
+     */
+    Xapian::doccount get_value_freq_lower_bound(const std::string & value) const;
+
+    /** Estimate the number of matches with value @a value.
+     *
+     *  The count over the documents counted is scaled by the ratio of
+     *  the MSet's estimate of the number of matches to the number of
+     *  documents counted.  If every matching document was counted, this is
+     *  exact.
+     *
+     *  @param value	The value to estimate the frequency of.
+     *  @param mset	The MSet from the search the spy was used for.
+     */
+    Xapian::doccount get_value_freq_estimated(const std::string & value,
+					      const Xapian::MSet & mset) const;
+
+    /** Return an upper bound on the number of matches with value @a value.
+     *
+     *  @param value	The value to bound the frequency of.
+     *  @param mset	The MSet from the search the spy was used for.
+     */
+    Xapian::doccount get_value_freq_upper_bound(const std::string & value,
+						const Xapian::MSet & mset) const;
+
     /** Get an iterator over the values seen in the slot.
      *
      *  Items will be returned in ascending alphabetical order.
@@ -202,6 +202,29 @@ class XAPIAN_VISIBILITY_DEFAULT MSet {
 			const std::string & hi_end = "</b>",
 			const std::string & omit = "...") const;
 
+    /** Generate a snippet using stored term offsets.
+     *
+     *  This is like the other form of snippet(), but uses the term offsets
+     *  which Xapian::TermGenerator stored in value slot @a slot of document
+     *  @a did (see TermGenerator::set_offsets_slot()) together with the
+     *  positional information for the query terms to find where in @a text
+     *  the query matches, and then only looks at that part of @a text.  For
+     *  long texts this is a lot faster.
+     *
+     *  @a text must be the same text the offsets were recorded for.  If no
+     *  offsets are stored, or no query terms with positional information are
+     *  found, the whole of @a text is considered as by the other form.
+     */
+    std::string snippet(const std::string & text,
+			Xapian::docid did,
+			Xapian::valueno slot,
+			size_t length = 500,
+			const Xapian::Stem & stemmer = Xapian::Stem(),
+			unsigned flags = SNIPPET_BACKGROUND_MODEL|SNIPPET_EXHAUSTIVE,
+			const std::string & hi_start = "<b>",
+			const std::string & hi_end = "</b>",
+			const std::string & omit = "...") const;
+
     /** Prefetch hint a range of items.
      *
      *  For a remote database, this may start a pipelined fetched of the
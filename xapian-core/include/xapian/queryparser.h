@@ -35,6 +35,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 namespace Xapian {
 
@@ -121,6 +122,112 @@ class XAPIAN_VISIBILITY_DEFAULT SimpleStopper : public Stopper {
     virtual std::string get_description() const;
 };
 
+/** Base class for splitting runs of CJK characters into words.
+ *
+ *  Experimental - see https://xapian.org/docs/deprecation#experimental-features
+ *
+ *  Chinese and Japanese (and often Korean) text doesn't separate words with
+ *  spaces.  By default each run of CJK characters is treated as a single
+ *  word, or with FLAG_CJK_NGRAM it is indexed as unigrams and bigrams, which
+ *  makes for a much larger index and more expensive queries.  If a
+ *  WordSegmenter is set on TermGenerator and QueryParser, it is used to split
+ *  such runs into words instead.
+ */
+class XAPIAN_VISIBILITY_DEFAULT WordSegmenter
+    : public Xapian::Internal::opt_intrusive_base {
+    /// Don't allow assignment.
+    void operator=(const WordSegmenter &);
+
+    /// Don't allow copying.
+    WordSegmenter(const WordSegmenter &);
+
+  public:
+    /// Default constructor.
+    WordSegmenter() { }
+
+    /** Split a run of CJK characters into words.
+     *
+     *  @param text	A run of CJK word characters, encoded as UTF-8.
+     *  @param words	Vector to append the words found in @a text to, in
+     *			order.  Concatenating the appended words should
+     *			give @a text.
+     */
+    virtual void operator()(const std::string & text,
+			    std::vector<std::string> & words) const = 0;
+
+    /// Class has virtual methods, so provide a virtual destructor.
+    virtual ~WordSegmenter() { }
+
+    /// Return a string describing this object.
+    virtual std::string get_description() const;
+
+    /** Start reference counting this object.
+     *
+     *  You can hand ownership of a dynamically allocated WordSegmenter
+     *  object to Xapian by calling release() and then passing the object to a
+     *  Xapian method.  Xapian will arrange to delete the object once it is no
+     *  longer required.
+     */
+    WordSegmenter * release() {
+	opt_intrusive_base::release();
+	return this;
+    }
+
+    /** Start reference counting this object.
+     *
+     *  You can hand ownership of a dynamically allocated WordSegmenter
+     *  object to Xapian by calling release() and then passing the object to a
+     *  Xapian method.  Xapian will arrange to delete the object once it is no
+     *  longer required.
+     */
+    const WordSegmenter * release() const {
+	opt_intrusive_base::release();
+	return this;
+    }
+};
+
+/** WordSegmenter which splits text using a dictionary of words.
+ *
+ *  Experimental - see https://xapian.org/docs/deprecation#experimental-features
+ *
+ *  This uses forward maximum matching: at each point in the text, the
+ *  longest dictionary word which starts there is taken as the next word.
+ *  Characters which don't start any dictionary word become single character
+ *  words.
+ */
+class XAPIAN_VISIBILITY_DEFAULT DictionaryWordSegmenter : public WordSegmenter {
+    /// The dictionary words.
+    std::set<std::string> dictionary;
+
+    /// The length of the longest dictionary word, in Unicode characters.
+    unsigned max_length;
+
+  public:
+    /// Default constructor.
+    DictionaryWordSegmenter() : max_length(0) { }
+
+    /** Initialise from a pair of iterators.
+     *
+     *  For example, to load a dictionary with one word per line:
+     *  @code
+     *  ifstream words("dict.txt");
+     *  Xapian::DictionaryWordSegmenter seg(istream_iterator<string>(words), istream_iterator<string>());
+     *  @endcode
+     */
+    template <class Iterator>
+    DictionaryWordSegmenter(Iterator begin, Iterator end) : max_length(0) {
+	while (begin != end) add(*begin++);
+    }
+
+    /// Add a word to the dictionary.
+    void add(const std::string & word);
+
+    virtual void operator()(const std::string & text,
+			    std::vector<std::string> & words) const;
+
+    virtual std::string get_description() const;
+};
+
 enum {
     RP_SUFFIX = 1,
     RP_REPEATED = 2,
@@ -939,6 +1046,17 @@ class XAPIAN_VISIBILITY_DEFAULT QueryParser {
      */
     void set_stopper(const Stopper *stop = NULL);
 
+    /** Set the word segmenter for CJK text.
+     *
+     *  If set, runs of CJK characters are split into words using this, and
+     *  FLAG_CJK_NGRAM is ignored.  This should be the same segmenter which
+     *  TermGenerator used when indexing.
+     *
+     *  @param segmenter	The WordSegmenter object to set (default NULL,
+     *			which means not to segment CJK text).
+     */
+    void set_segmenter(const WordSegmenter * segmenter = NULL);
+
     /** Set the default operator.
      *
      *  @param default_op	The operator to use to combine non-filter
@@ -138,6 +138,37 @@ class XAPIAN_VISIBILITY_DEFAULT Stem {
      */
     std::string operator()(const std::string &word) const;
 
+    /** Cache the stems of recently stemmed words.
+     *
+     *  Word frequencies in text are very skewed, so the same words get
+     *  stemmed over and over again.  Once this is called, results are looked
+     *  up in a cache before running the stemming algorithm.  The cache is
+     *  shared with copies of this object made afterwards, so calling this
+     *  before passing the object to TermGenerator::set_stemmer() or
+     *  QueryParser::set_stemmer() means they will use the cache.
+     *
+     *  The stemming algorithm must always return the same stem for a given
+     *  word for caching to be valid (which is true of all the built-in
+     *  stemmers).
+     *
+     *  @param max_size	The maximum number of words to cache.  If 0,
+     *			caching is disabled (and any existing cache is
+     *			discarded).
+     */
+    void set_cache_size(size_t max_size);
+
+    /** Return the number of words stemmed using the cache.
+     *
+     *  Returns 0 if caching isn't enabled.
+     */
+    size_t get_cache_hits() const;
+
+    /** Return the number of words which had to be stemmed by the algorithm.
+     *
+     *  Returns 0 if caching isn't enabled.
+     */
+    size_t get_cache_misses() const;
+
     /// Return a string describing this object.
     std::string get_description() const;
 
@@ -37,6 +37,7 @@ namespace Xapian {
 class Document;
 class Stem;
 class Stopper;
+class WordSegmenter;
 class WritableDatabase;
 
 /** Parses a piece of text and generate terms.
@@ -77,6 +78,36 @@ class XAPIAN_VISIBILITY_DEFAULT TermGenerator {
      */
     void set_stopper(const Xapian::Stopper *stop = NULL);
 
+    /** Set the Xapian::WordSegmenter object to be used for CJK text.
+     *
+     *  If set, runs of CJK characters are split into words using this, and
+     *  each word is indexed (with positional information if enabled) instead
+     *  of the run as a whole or its n-grams.  FLAG_CJK_NGRAM is ignored.
+     *
+     *  @param segmenter	The WordSegmenter object to set (default NULL,
+     *			which means not to segment CJK text).
+     */
+    void set_segmenter(const Xapian::WordSegmenter *segmenter = NULL);
+
+    /** Set the value slot to store term offsets in.
+     *
+     *  If set, index_text() records, for each term position it generates, the
+     *  byte offset in the text of the end of the word at that position, and
+     *  stores this table in value slot @a slot of the current document.
+     *  MSet::snippet() can then use it to find the best part of the text to
+     *  use without tokenising all of it.
+     *
+     *  Offsets are only recorded by index_text(), not by
+     *  index_text_without_positions().  If you index several texts with
+     *  offsets enabled, the offsets are into the concatenation of those texts
+     *  (with nothing between them), so you typically want to enable this only
+     *  while indexing the text you'll generate snippets from.
+     *
+     *  @param slot	The value slot to use (default Xapian::BAD_VALUENO,
+     *			which means not to record term offsets).
+     */
+    void set_offsets_slot(Xapian::valueno slot = Xapian::BAD_VALUENO);
+
     /// Set the current document.
     void set_document(const Xapian::Document & doc);
 
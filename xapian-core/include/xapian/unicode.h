@@ -42,7 +42,7 @@ class XAPIAN_VISIBILITY_DEFAULT Utf8Iterator {
 
     bool XAPIAN_NOTHROW(calculate_sequence_length() const);
 
-    unsigned get_char() const;
+    unsigned XAPIAN_NOTHROW(get_char() const) XAPIAN_PURE_FUNCTION;
 
     Utf8Iterator(const unsigned char *p_, const unsigned char *end_, unsigned seqlen_)
 	: p(p_), end(end_), seqlen(seqlen_) { }
@@ -138,7 +138,11 @@ class XAPIAN_VISIBILITY_DEFAULT Utf8Iterator {
      *
      *  Returns unsigned(-1) if the iterator has reached the end of its buffer.
      */
-    unsigned XAPIAN_NOTHROW(operator*() const) XAPIAN_PURE_FUNCTION;
+    unsigned XAPIAN_NOTHROW(operator*() const) XAPIAN_PURE_FUNCTION {
+	// ASCII is by far the most common case, and needs no decoding.
+	if (p && *p < 0x80) return *p;
+	return get_char();
+    }
 
     /** @private @internal Get the current Unicode character
      *  value pointed to by the iterator.
@@ -158,7 +162,13 @@ class XAPIAN_VISIBILITY_DEFAULT Utf8Iterator {
      */
     Utf8Iterator operator++(int) {
 	// If we've not calculated seqlen yet, do so.
-	if (seqlen == 0) calculate_sequence_length();
+	if (seqlen == 0) {
+	    if (*p < 0x80) {
+		seqlen = 1;
+	    } else {
+		calculate_sequence_length();
+	    }
+	}
 	const unsigned char *old_p = p;
 	unsigned old_seqlen = seqlen;
 	p += seqlen;
@@ -172,7 +182,13 @@ class XAPIAN_VISIBILITY_DEFAULT Utf8Iterator {
      *  @return A reference to this object.
      */
     Utf8Iterator & operator++() {
-	if (seqlen == 0) calculate_sequence_length();
+	if (seqlen == 0) {
+	    if (*p < 0x80) {
+		seqlen = 1;
+	    } else {
+		calculate_sequence_length();
+	    }
+	}
 	p += seqlen;
 	if (p == end) p = NULL;
 	seqlen = 0;
@@ -345,6 +361,14 @@ inline bool is_wordchar(unsigned ch) {
 	    (1 << Xapian::Unicode::LETTER_NUMBER) |
 	    (1 << Xapian::Unicode::OTHER_NUMBER) |
 	    (1 << Xapian::Unicode::CONNECTOR_PUNCTUATION);
+    if (ch < 128) {
+	// The ASCII word characters are 0-9, A-Z, _ and a-z - test against
+	// a bitmap of them to avoid looking up the category.
+	const unsigned long long ASCII_WORDCHARS_LO = 0x03ff000000000000ULL;
+	const unsigned long long ASCII_WORDCHARS_HI = 0x07fffffe87fffffeULL;
+	return (((ch < 64 ? ASCII_WORDCHARS_LO : ASCII_WORDCHARS_HI)
+		 >> (ch & 63)) & 1);
+    }
     return ((WORDCHAR_MASK >> get_category(ch)) & 1);
 }
 
@@ -365,6 +389,10 @@ inline bool is_currency(unsigned ch) {
 
 /// Convert a Unicode character to lowercase.
 inline unsigned tolower(unsigned ch) {
+    if (ch < 128) {
+	// Fast path for ASCII.
+	return (ch - 'A' < 26u) ? (ch | 0x20) : ch;
+    }
     int info = Xapian::Unicode::Internal::get_character_info(ch);
     if (!(Internal::get_case_type(info) & 2))
 	return ch;
@@ -553,6 +553,14 @@ class XAPIAN_VISIBILITY_DEFAULT BM25Weight : public Weight {
     /// Factor combining all the document independent factors.
     mutable double termweight;
 
+    /** Precomputed parts of the denominator in get_sumpart().
+     *
+     *  The denominator is k1 * (normlen * b + (1 - b)) + wdf, which we
+     *  evaluate as max(len * denom_len_factor, denom_min_len) + denom_const
+     *  + wdf to save work for each document.
+     */
+    mutable double denom_len_factor, denom_min_len, denom_const;
+
     /// The BM25 parameters.
     double param_k1, param_k2, param_k3, param_b;
 
@@ -30,12 +30,85 @@
 #include "keyword.h"
 #include "sbl-dispatch.h"
 
+#include <algorithm>
 #include <string>
+#include <unordered_map>
 
 using namespace std;
 
 namespace Xapian {
 
+/** StemImplementation which caches the results of another.
+ *
+ *  We keep two generations of entries, each holding up to half the maximum
+ *  size.  When the current generation fills up, it becomes the previous
+ *  generation and the old previous generation is discarded.  Words looked up
+ *  in the previous generation get copied into the current one, so frequently
+ *  used words survive while the cost of eviction stays low.
+ */
+class CachingStemImplementation : public StemImplementation {
+    /// The stemmer to cache the results of.
+    Xapian::Internal::intrusive_ptr<StemImplementation> stemmer;
+
+    /// The maximum number of entries in each generation.
+    size_t generation_size;
+
+    /// The current generation of cached stems.
+    unordered_map<string, string> current;
+
+    /// The previous generation of cached stems.
+    unordered_map<string, string> previous;
+
+  public:
+    /// Number of lookups found in the cache.
+    size_t hits = 0;
+
+    /// Number of lookups not found in the cache.
+    size_t misses = 0;
+
+    CachingStemImplementation(StemImplementation * stemmer_, size_t max_size)
+	: stemmer(stemmer_), generation_size(max(max_size / 2, size_t(1))) { }
+
+    StemImplementation * get_stemmer() const { return stemmer.get(); }
+
+    void set_cache_size(size_t max_size) {
+	generation_size = max(max_size / 2, size_t(1));
+	if (current.size() > generation_size) {
+	    current.clear();
+	    previous.clear();
+	} else if (previous.size() > generation_size) {
+	    previous.clear();
+	}
+    }
+
+    string operator()(const string & word) {
+	auto i = current.find(word);
+	if (i != current.end()) {
+	    ++hits;
+	    return i->second;
+	}
+	string stem;
+	i = previous.find(word);
+	if (i != previous.end()) {
+	    ++hits;
+	    stem = i->second;
+	} else {
+	    ++misses;
+	    stem = (*stemmer)(word);
+	}
+	if (current.size() >= generation_size) {
+	    swap(previous, current);
+	    current.clear();
+	}
+	current.emplace(word, stem);
+	return stem;
+    }
+
+    string get_description() const {
+	return stemmer->get_description();
+    }
+};
+
 Stem::Stem(const Stem & o) : internal(o.internal) { }
 
 Stem &
@@ -143,6 +216,34 @@ Stem::operator()(const std::string &word) const
     return internal->operator()(word);
 }
 
+void
+Stem::set_cache_size(size_t max_size)
+{
+    if (!internal.get()) return;
+    auto cache = dynamic_cast<CachingStemImplementation*>(internal.get());
+    if (max_size == 0) {
+	if (cache) internal = cache->get_stemmer();
+    } else if (cache) {
+	cache->set_cache_size(max_size);
+    } else {
+	internal = new CachingStemImplementation(internal.get(), max_size);
+    }
+}
+
+size_t
+Stem::get_cache_hits() const
+{
+    auto cache = dynamic_cast<CachingStemImplementation*>(internal.get());
+    return cache ? cache->hits : 0;
+}
+
+size_t
+Stem::get_cache_misses() const
+{
+    auto cache = dynamic_cast<CachingStemImplementation*>(internal.get());
+    return cache ? cache->misses : 0;
+}
+
 string
 Stem::get_description() const
 {
@@ -1,6 +1,7 @@
 noinst_HEADERS +=\
 	matcher/andmaybepostlist.h\
 	matcher/andnotpostlist.h\
+	matcher/blockorpostlist.h\
 	matcher/branchpostlist.h\
 	matcher/collapser.h\
 	matcher/exactphrasepostlist.h\
@@ -13,6 +14,7 @@ noinst_HEADERS +=\
 	matcher/msetpostlist.h\
 	matcher/multiandpostlist.h\
 	matcher/multimatch.h\
+	matcher/multiorpostlist.h\
 	matcher/multixorpostlist.h\
 	matcher/nearpostlist.h\
 	matcher/orpositionlist.h\
@@ -41,6 +43,7 @@ EXTRA_DIST +=\
 lib_src +=\
 	matcher/andmaybepostlist.cc\
 	matcher/andnotpostlist.cc\
+	matcher/blockorpostlist.cc\
 	matcher/branchpostlist.cc\
 	matcher/collapser.cc\
 	matcher/exactphrasepostlist.cc\
@@ -52,6 +55,7 @@ lib_src +=\
 	matcher/msetpostlist.cc\
 	matcher/multiandpostlist.cc\
 	matcher/multimatch.cc\
+	matcher/multiorpostlist.cc\
 	matcher/multixorpostlist.cc\
 	matcher/nearpostlist.cc\
 	matcher/orpositionlist.cc\
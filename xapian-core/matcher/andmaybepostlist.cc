@@ -28,6 +28,8 @@
 #include "multiandpostlist.h"
 #include "omassert.h"
 
+#include <algorithm>
+
 PostList *
 AndMaybePostList::process_next_or_skip_to(double w_min, PostList *ret)
 {
@@ -146,6 +148,14 @@ AndMaybePostList::get_termfreq_est_using_stats(
     RETURN(l->get_termfreq_est_using_stats(stats));
 }
 
+double
+AndMaybePostList::get_cost_est() const
+{
+    // We iterate the left side, and check each candidate against the right.
+    return l->get_cost_est() +
+	   std::min(r->get_cost_est(), double(l->get_termfreq_est()));
+}
+
 Xapian::docid
 AndMaybePostList::get_docid() const
 {
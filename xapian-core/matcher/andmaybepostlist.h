@@ -66,6 +66,8 @@ class AndMaybePostList : public BranchPostList {
 	TermFreqs get_termfreq_est_using_stats(
 	    const Xapian::Weight::Internal & stats) const;
 
+	double get_cost_est() const;
+
 	Xapian::docid get_docid() const;
 	double get_weight() const;
 	double get_maxweight() const;
@@ -27,6 +27,8 @@
 #include "debuglog.h"
 #include "omassert.h"
 
+#include <algorithm>
+
 PostList *
 AndNotPostList::advance_to_next_match(double w_min, PostList *ret)
 {
@@ -162,6 +164,14 @@ AndNotPostList::get_termfreq_est_using_stats(
 		     static_cast<Xapian::termcount>(collfreqest + 0.5)));
 }
 
+double
+AndNotPostList::get_cost_est() const
+{
+    // We iterate the left side, and check each candidate against the right.
+    return l->get_cost_est() +
+	   std::min(r->get_cost_est(), double(l->get_termfreq_est()));
+}
+
 Xapian::docid
 AndNotPostList::get_docid() const
 {
@@ -0,0 +1,355 @@
+/** @file blockorpostlist.cc
+ * @brief N-way OR postlist which accumulates weights in docid blocks
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "blockorpostlist.h"
+
+#include "debuglog.h"
+#include "multimatch.h"
+#include "omassert.h"
+
+using namespace std;
+
+BlockOrPostList::~BlockOrPostList()
+{
+    if (plist) {
+	for (size_t i = 0; i < n_kids; ++i) {
+	    delete plist[i];
+	}
+	delete [] plist;
+    }
+    delete [] wt;
+    delete [] subqs;
+    delete [] doclens;
+    delete [] unique_terms;
+}
+
+bool
+BlockOrPostList::kid_advanced(size_t i, PostList * res)
+{
+    // We don't report pruning to the matcher here, as documents in the
+    // current block may already include weight from the old sub-postlist.
+    // Instead fill_block() updates max_total for each new block.
+    if (res) {
+	delete plist[i];
+	plist[i] = res;
+    }
+    if (!plist[i]->at_end()) return false;
+    delete plist[i];
+    plist[i] = plist[--n_kids];
+    return true;
+}
+
+void
+BlockOrPostList::fill_block()
+{
+    LOGCALL_VOID(MATCH, "BlockOrPostList::fill_block", NO_ARGS);
+    Assert(n_kids);
+
+    double old_max = max_total;
+    max_total = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	max_total += plist[i]->recalc_maxweight();
+    }
+    if (max_total != old_max)
+	matcher->recalc_maxweight();
+
+    // Start the block at the lowest docid any sub-postlist is at, so we
+    // don't waste time on stretches of docids which none of them match.
+    block_start = plist[0]->get_docid();
+    for (size_t i = 1; i < n_kids; ++i) {
+	block_start = min(block_start, plist[i]->get_docid());
+    }
+    Xapian::docid block_last = block_start + (BLOCK_SIZE - 1);
+    if (rare(block_last < block_start))
+	block_last = Xapian::docid(-1);
+
+    fill_n(wt, BLOCK_SIZE, -1.0);
+    block_len = 0;
+    have_doclens = want_doclens;
+    have_unique_terms = want_unique_terms;
+
+    size_t i = 0;
+    while (i < n_kids) {
+	PostList * pl = plist[i];
+	bool removed = false;
+	Xapian::docid d;
+	while ((d = pl->get_docid()) <= block_last) {
+	    Xapian::docid slot = d - block_start;
+	    double w = pl->get_weight();
+	    if (wt[slot] < 0) {
+		wt[slot] = w;
+		subqs[slot] = pl->count_matching_subqs();
+		if (have_doclens)
+		    doclens[slot] = pl->get_doclength();
+		if (have_unique_terms)
+		    unique_terms[slot] = pl->get_unique_terms();
+	    } else {
+		wt[slot] += w;
+		subqs[slot] += pl->count_matching_subqs();
+	    }
+	    if (slot >= block_len) block_len = slot + 1;
+
+	    if (kid_advanced(i, pl->next(0))) {
+		removed = true;
+		break;
+	    }
+	    pl = plist[i];
+	}
+	// If plist[i] was removed, the last sub-postlist has been moved into
+	// its place, so we need to look at position i again.
+	if (!removed) ++i;
+    }
+}
+
+void
+BlockOrPostList::find_next(double w_min)
+{
+    // Our parent may pass a negative w_min (e.g. ExtraWeightPostList
+    // subtracts its own maximum), but weights are never negative so that's
+    // the same as 0.
+    if (w_min < 0.0) w_min = 0.0;
+    while (true) {
+	// Slots for documents which don't match have a negative weight, so
+	// they always fail this test.
+	while (pos < block_len) {
+	    if (wt[pos] >= w_min) {
+		did = block_start + pos;
+		return;
+	    }
+	    ++pos;
+	}
+
+	if (n_kids == 0) {
+	    did = 0;
+	    return;
+	}
+
+	fill_block();
+	pos = 0;
+    }
+}
+
+Xapian::doccount
+BlockOrPostList::get_termfreq_min() const
+{
+    Xapian::doccount result = plist[0]->get_termfreq_min();
+    for (size_t i = 1; i < n_kids; ++i) {
+	Xapian::doccount tf_min = plist[i]->get_termfreq_min();
+	if (tf_min > result) result = tf_min;
+    }
+    return result;
+}
+
+Xapian::doccount
+BlockOrPostList::get_termfreq_max() const
+{
+    // Maximum is if all sub-postlists are disjoint.
+    Xapian::doccount result = 0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	Xapian::doccount tf_max = plist[i]->get_termfreq_max();
+	if (tf_max >= db_size - result)
+	    return db_size;
+	result += tf_max;
+    }
+    return result;
+}
+
+Xapian::doccount
+BlockOrPostList::get_termfreq_est() const
+{
+    LOGCALL(MATCH, Xapian::doccount, "BlockOrPostList::get_termfreq_est", NO_ARGS);
+    if (rare(db_size == 0))
+	RETURN(0);
+    // We calculate the estimate assuming independence.  With this assumption,
+    // the probability that a document doesn't match is the product of the
+    // probabilities that it doesn't match each sub-postlist.
+    double scale = 1.0 / db_size;
+    double P_none = 1.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	P_none *= 1.0 - plist[i]->get_termfreq_est() * scale;
+    }
+    RETURN(static_cast<Xapian::doccount>((1.0 - P_none) * db_size + 0.5));
+}
+
+TermFreqs
+BlockOrPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    LOGCALL(MATCH, TermFreqs, "BlockOrPostList::get_termfreq_est_using_stats", stats);
+    // We calculate the estimate assuming independence, as for
+    // get_termfreq_est().
+
+    // Our caller should have ensured this.
+    Assert(stats.collection_size);
+    double P_none = 1.0, Pr_none = 1.0, Pc_none = 1.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	TermFreqs freqs(plist[i]->get_termfreq_est_using_stats(stats));
+	P_none *= 1.0 - double(freqs.termfreq) / stats.collection_size;
+	Pc_none *= 1.0 - double(freqs.collfreq) / stats.total_term_count;
+	// If the rset is empty, reltermfreq should be 0 already, so leave it
+	// alone.
+	if (stats.rset_size != 0)
+	    Pr_none *= 1.0 - double(freqs.reltermfreq) / stats.rset_size;
+    }
+    RETURN(TermFreqs(
+	static_cast<Xapian::doccount>((1.0 - P_none) * stats.collection_size + 0.5),
+	static_cast<Xapian::doccount>((1.0 - Pr_none) * stats.rset_size + 0.5),
+	static_cast<Xapian::termcount>((1.0 - Pc_none) * stats.total_term_count + 0.5)));
+}
+
+double
+BlockOrPostList::get_cost_est() const
+{
+    double cost = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	cost += plist[i]->get_cost_est();
+    }
+    return cost;
+}
+
+double
+BlockOrPostList::get_maxweight() const
+{
+    LOGCALL(MATCH, double, "BlockOrPostList::get_maxweight", NO_ARGS);
+    RETURN(max_total);
+}
+
+Xapian::docid
+BlockOrPostList::get_docid() const
+{
+    return did;
+}
+
+Xapian::termcount
+BlockOrPostList::get_doclength() const
+{
+    Assert(did);
+    if (have_doclens)
+	return doclens[pos];
+    // We start recording lengths from the next block.  For this one, the
+    // sub-postlists have moved on, so ask the database.
+    want_doclens = true;
+    return db->get_doclength(did);
+}
+
+Xapian::termcount
+BlockOrPostList::get_unique_terms() const
+{
+    Assert(did);
+    if (have_unique_terms)
+	return unique_terms[pos];
+    want_unique_terms = true;
+    return db->get_unique_terms(did);
+}
+
+double
+BlockOrPostList::get_weight() const
+{
+    Assert(did);
+    return wt[pos];
+}
+
+bool
+BlockOrPostList::at_end() const
+{
+    return (did == 0);
+}
+
+double
+BlockOrPostList::recalc_maxweight()
+{
+    LOGCALL(MATCH, double, "BlockOrPostList::recalc_maxweight", NO_ARGS);
+    // Once we've started, max_total is updated by fill_block(), since
+    // documents in the current block may include weight from sub-postlists
+    // which have since ended or been replaced.
+    if (did == 0) {
+	max_total = 0.0;
+	for (size_t i = 0; i < n_kids; ++i) {
+	    max_total += plist[i]->recalc_maxweight();
+	}
+    }
+    RETURN(max_total);
+}
+
+PostList *
+BlockOrPostList::next(double w_min)
+{
+    LOGCALL(MATCH, PostList *, "BlockOrPostList::next", w_min);
+    if (did == 0) {
+	size_t i = 0;
+	while (i < n_kids) {
+	    if (!kid_advanced(i, plist[i]->next(0))) ++i;
+	}
+	block_len = 0;
+	pos = 0;
+    } else {
+	++pos;
+    }
+    find_next(w_min);
+    RETURN(NULL);
+}
+
+PostList *
+BlockOrPostList::skip_to(Xapian::docid did_min, double w_min)
+{
+    LOGCALL(MATCH, PostList *, "BlockOrPostList::skip_to", did_min | w_min);
+    if (did == 0) {
+	size_t i = 0;
+	while (i < n_kids) {
+	    if (!kid_advanced(i, plist[i]->skip_to(did_min, 0))) ++i;
+	}
+	block_len = 0;
+	pos = 0;
+    } else {
+	if (did_min <= did) RETURN(NULL);
+	if (did_min - block_start < block_len) {
+	    pos = did_min - block_start;
+	} else {
+	    // The rest of the current block is of no use to us.
+	    size_t i = 0;
+	    while (i < n_kids) {
+		if (!kid_advanced(i, plist[i]->skip_to(did_min, 0))) ++i;
+	    }
+	    block_len = 0;
+	    pos = 0;
+	}
+    }
+    find_next(w_min);
+    RETURN(NULL);
+}
+
+string
+BlockOrPostList::get_description() const
+{
+    string desc("BlockOrPostList(");
+    for (size_t i = 0; i < n_kids; ++i) {
+	if (i) desc += " OR ";
+	desc += plist[i]->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+Xapian::termcount
+BlockOrPostList::count_matching_subqs() const
+{
+    Assert(did);
+    return subqs[pos];
+}
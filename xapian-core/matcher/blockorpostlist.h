@@ -0,0 +1,207 @@
+/** @file blockorpostlist.h
+ * @brief N-way OR postlist which accumulates weights in docid blocks
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BLOCKORPOSTLIST_H
+#define XAPIAN_INCLUDED_BLOCKORPOSTLIST_H
+
+#include "backends/database.h"
+#include "multimatch.h"
+#include "api/postlist.h"
+#include <algorithm>
+
+class MultiMatch;
+
+/** N-way OR postlist which accumulates weights term-at-a-time.
+ *
+ *  Rather than merging the sub-postlists document-at-a-time, we read each
+ *  sub-postlist in turn for a block of BLOCK_SIZE docids, adding its weights
+ *  into a dense array, and then return the documents in the block by
+ *  scanning that array.  Documents with weight less than w_min are skipped by
+ *  that scan.
+ *
+ *  This works well for ORs of a few terms which each match a lot of
+ *  documents, but it can only usefully be advanced by next() - skip_to()
+ *  beyond the current block discards the work done for the rest of it.  So
+ *  we only use it at the root of the postlist tree, which also means we
+ *  don't need to support get_wdf() or positions.
+ */
+class BlockOrPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const BlockOrPostList &);
+
+    /// Don't allow copying.
+    BlockOrPostList(const BlockOrPostList &);
+
+    /** The number of docids in each block.
+     *
+     *  The arrays for a block of this size fit comfortably in a typical L1
+     *  cache.
+     */
+    static const Xapian::docid BLOCK_SIZE = 1024;
+
+    /// The current docid, or zero if we haven't started or are at_end.
+    Xapian::docid did;
+
+    /// The number of sub-postlists which aren't yet at_end.
+    size_t n_kids;
+
+    /** Array of pointers to sub-postlists.
+     *
+     *  Each sub-postlist is positioned on the first document after the
+     *  current block which it matches.
+     */
+    PostList ** plist;
+
+    /// Total maximum weight (== sum of the maximum weights of plist).
+    double max_total;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Pointer to the matcher object, so we can report pruning.
+    MultiMatch *matcher;
+
+    /// The database, which we need for get_doclength(), etc.
+    const Xapian::Database::Internal * db;
+
+    /// The docid which slot 0 of the current block is for.
+    Xapian::docid block_start;
+
+    /// The number of slots in the current block which could match.
+    Xapian::docid block_len;
+
+    /// The slot in the current block for did.
+    Xapian::docid pos;
+
+    /** The weight of each document in the current block.
+     *
+     *  Documents which don't match have a negative weight, so we can find
+     *  the next candidate with a single comparison against w_min.
+     */
+    double * wt;
+
+    /// count_matching_subqs() for each document in the current block.
+    Xapian::termcount * subqs;
+
+    /** The length of each document in the current block.
+     *
+     *  Only filled in if have_doclens is true.
+     */
+    Xapian::termcount * doclens;
+
+    /** The number of unique terms in each document in the current block.
+     *
+     *  Only filled in if have_unique_terms is true.
+     */
+    Xapian::termcount * unique_terms;
+
+    /** Has get_doclength() been called?
+     *
+     *  If so, we record document lengths from the sub-postlists while they
+     *  are on each document, rather than looking them up afterwards.  This
+     *  matters when we're under an ExtraWeightPostList, which asks for the
+     *  length of every candidate.
+     */
+    mutable bool want_doclens;
+
+    /// Has get_unique_terms() been called?
+    mutable bool want_unique_terms;
+
+    /// Are doclens valid for the current block?
+    bool have_doclens;
+
+    /// Are unique_terms valid for the current block?
+    bool have_unique_terms;
+
+    /// Read the sub-postlists for the next block.
+    void fill_block();
+
+    /** Find the next candidate after pos in the current block or those after.
+     *
+     *  Sets did to 0 if there aren't any more candidates.
+     */
+    void find_next(double w_min);
+
+    /** Handle plist[i] having been advanced.
+     *
+     *  @param res  What next() or skip_to() returned.
+     *
+     *  @return true if plist[i] was at_end and has been removed.
+     */
+    bool kid_advanced(size_t i, PostList * res);
+
+  public:
+    /** Construct from 2 random-access iterators to a container of PostList*,
+     *  a pointer to the matcher, and the database.
+     */
+    template <class RandomItor>
+    BlockOrPostList(RandomItor pl_begin, RandomItor pl_end,
+		    MultiMatch * matcher_,
+		    const Xapian::Database::Internal & db_)
+	: did(0), n_kids(pl_end - pl_begin), plist(NULL),
+	  max_total(0), db_size(db_.get_doccount()), matcher(matcher_),
+	  db(&db_), block_start(0), block_len(0), pos(0), wt(NULL),
+	  subqs(NULL), doclens(NULL), unique_terms(NULL),
+	  want_doclens(false), want_unique_terms(false),
+	  have_doclens(false), have_unique_terms(false)
+    {
+	plist = new PostList * [n_kids];
+	std::copy(pl_begin, pl_end, plist);
+	wt = new double[BLOCK_SIZE];
+	subqs = new Xapian::termcount[BLOCK_SIZE];
+	doclens = new Xapian::termcount[BLOCK_SIZE];
+	unique_terms = new Xapian::termcount[BLOCK_SIZE];
+    }
+
+    ~BlockOrPostList();
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    double get_cost_est() const;
+
+    double get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_unique_terms() const;
+
+    double get_weight() const;
+
+    bool at_end() const;
+
+    double recalc_maxweight();
+
+    Internal *next(double w_min);
+
+    Internal *skip_to(Xapian::docid, double w_min);
+
+    std::string get_description() const;
+
+    Xapian::termcount count_matching_subqs() const;
+};
+
+#endif // XAPIAN_INCLUDED_BLOCKORPOSTLIST_H
@@ -25,6 +25,8 @@
 #include "omassert.h"
 
 #include <algorithm>
+#include <functional>
+#include <string>
 
 using namespace std;
 
@@ -66,11 +68,53 @@ CollapseData::add_item(const Xapian::Internal::MSetItem & item,
     return REPLACED;
 }
 
+bool
+CollapseData::all_below(const Xapian::Internal::MSetItem & min_item,
+			const MSetCmp & mcmp) const
+{
+    vector<Xapian::Internal::MSetItem>::const_iterator i;
+    for (i = items.begin(); i != items.end(); ++i) {
+	if (!mcmp(min_item, *i)) return false;
+    }
+    return true;
+}
+
+void
+Collapser::evict(const Xapian::Internal::MSetItem & min_item,
+		 const MSetCmp & mcmp)
+{
+    hash<string> hasher;
+    auto i = table.begin();
+    while (i != table.end()) {
+	const CollapseData & collapse_data = i->second;
+	if (!collapse_data.all_below(min_item, mcmp)) {
+	    ++i;
+	    continue;
+	}
+
+	if (evicted.empty()) evicted.resize(COLLAPSER_EVICTED_BITS / 64);
+	size_t bit = hasher(i->first) % COLLAPSER_EVICTED_BITS;
+	evicted[bit / 64] |= uint64_t(1) << (bit % 64);
+
+	Xapian::doccount n = collapse_data.get_item_count();
+	entry_count -= n;
+	if (collapse_data.is_uncounted()) {
+	    uncounted_count -= n;
+	} else {
+	    evicted_count += n;
+	}
+	i = table.erase(i);
+    }
+    evict_threshold = max(size_t(COLLAPSER_MIN_EVICT_THRESHOLD),
+			  table.size() * 2);
+}
+
 collapse_result
 Collapser::process(Xapian::Internal::MSetItem & item,
 		   PostList * postlist,
 		   Xapian::Document::Internal & vsdoc,
-		   const MSetCmp & mcmp)
+		   const MSetCmp & mcmp,
+		   const Xapian::Internal::MSetItem * min_item)
 {
     ++docs_considered;
     // The postlist will supply the collapse key for a remote match.
@@ -88,12 +132,22 @@ Collapser::process(Xapian::Internal::MSetItem & item,
 	return EMPTY;
     }
 
-    map<string, CollapseData>::iterator oldkey;
-    oldkey = table.find(item.collapse_key);
+    auto oldkey = table.find(item.collapse_key);
     if (oldkey == table.end()) {
-	// We've not seen this collapse key before.
-	table.insert(make_pair(item.collapse_key, CollapseData(item)));
+	// We've not seen this collapse key before (or we've evicted it).
+	if (min_item && table.size() >= evict_threshold) {
+	    evict(*min_item, mcmp);
+	}
+	bool uncounted = false;
+	if (!evicted.empty()) {
+	    size_t bit = hash<string>()(item.collapse_key) %
+			 COLLAPSER_EVICTED_BITS;
+	    uncounted = (evicted[bit / 64] >> (bit % 64)) & 1;
+	}
+	table.insert(make_pair(item.collapse_key,
+			       CollapseData(item, uncounted)));
 	++entry_count;
+	if (uncounted) ++uncounted_count;
 	return ADDED;
     }
 
@@ -102,6 +156,7 @@ Collapser::process(Xapian::Internal::MSetItem & item,
     res = collapse_data.add_item(item, collapse_max, mcmp, old_item);
     if (res == ADDED) {
 	++entry_count;
+	if (collapse_data.is_uncounted()) ++uncounted_count;
     } else if (res == REJECTED || res == REPLACED) {
 	++dups_ignored;
     }
@@ -112,7 +167,7 @@ Xapian::doccount
 Collapser::get_collapse_count(const string & collapse_key, int percent_cutoff,
 			      double min_weight) const
 {
-    map<string, CollapseData>::const_iterator key = table.find(collapse_key);
+    auto key = table.find(collapse_key);
     // If a collapse key is present in the MSet, it must be in our table.
     Assert(key != table.end());
 
@@ -138,8 +193,11 @@ Xapian::doccount
 Collapser::get_matches_lower_bound() const
 {
     // We've seen this many matches, but all other documents matching the query
-    // could be collapsed onto values already seen.
-    Xapian::doccount matches_lower_bound = no_collapse_key + entry_count;
+    // could be collapsed onto values already seen.  Items we've evicted still
+    // count, but we have to exclude those we've kept for values which may
+    // have been evicted previously or we could count too many for them.
+    Xapian::doccount matches_lower_bound = no_collapse_key + evicted_count +
+					   (entry_count - uncounted_count);
     return matches_lower_bound;
     // FIXME: *Unless* we haven't achieved collapse_max occurrences of *any*
     // collapse key value, so we can increase matches_lower_bound like the
@@ -147,8 +205,7 @@ Collapser::get_matches_lower_bound() const
     // many documents.
 #if 0
     Xapian::doccount max_kept = 0;
-    map<string, CollapseData>::const_iterator i;
-    for (i = table.begin(); i != table.end(); ++i) {
+    for (auto i = table.begin(); i != table.end(); ++i) {
 	if (i->second.get_collapse_count() > max_kept) {
 	    max_kept = i->second.get_collapse_count();
 	    if (max_kept == collapse_max) {
@@ -26,9 +26,19 @@
 #include "api/omenquireinternal.h"
 #include "api/postlist.h"
 
-#include <map>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
+/** Size of Collapser's table at which we first try evicting entries.
+ *
+ *  Below this, we don't bother trying to evict.
+ */
+#define COLLAPSER_MIN_EVICT_THRESHOLD 1024
+
+/// Number of bits in Collapser's bitmap of evicted collapse key hashes.
+#define COLLAPSER_EVICTED_BITS (1 << 20)
+
 /// Enumeration reporting how a document was handled by the Collapser.
 typedef enum {
     EMPTY,
@@ -56,10 +66,18 @@ class CollapseData {
     /// The number of documents we've rejected.
     Xapian::doccount collapse_count;
 
+    /** Might entries for this collapse key value have been evicted before?
+     *
+     *  If so, the items kept here aren't counted towards the lower bound on
+     *  the number of matches, since the evicted items already are.
+     */
+    bool uncounted;
+
   public:
     /// Construct with the given MSetItem @a item.
-    explicit CollapseData(const Xapian::Internal::MSetItem & item)
-	: items(1, item), next_best_weight(0), collapse_count(0) {
+    CollapseData(const Xapian::Internal::MSetItem & item, bool uncounted_)
+	: items(1, item), next_best_weight(0), collapse_count(0),
+	  uncounted(uncounted_) {
 	items[0].collapse_key = std::string();
     }
 
@@ -82,16 +100,54 @@ class CollapseData {
 
     /// The number of documents we've rejected.
     Xapian::doccount get_collapse_count() const { return collapse_count; }
+
+    /// The number of items currently kept for this collapse key value.
+    Xapian::doccount get_item_count() const { return items.size(); }
+
+    /// Are the kept items excluded from the matches lower bound?
+    bool is_uncounted() const { return uncounted; }
+
+    /** Check if none of the kept items can still make it into the MSet.
+     *
+     *  @param min_item	The lowest ranked item in the full proto-MSet.
+     *  @param mcmp	MSetItem comparison functor.
+     */
+    bool all_below(const Xapian::Internal::MSetItem & min_item,
+		   const MSetCmp & mcmp) const;
 };
 
 /// The Collapser class tracks collapse keys and the documents they match.
 class Collapser {
     /// Map from collapse key values to the items we're keeping for them.
-    std::map<std::string, CollapseData> table;
+    std::unordered_map<std::string, CollapseData> table;
+
+    /** Number of entries in @a table at which we next try to evict.
+     *
+     *  Once the proto-MSet is full, a collapse key value whose kept items all
+     *  rank below the lowest item in it can never contribute to the MSet,
+     *  so when the table grows to this size we evict such entries.  After
+     *  each eviction pass this is set to twice the remaining size, so the
+     *  work is amortised over the insertions.
+     */
+    size_t evict_threshold;
+
+    /** Bitmap of hashes of evicted collapse key values.
+     *
+     *  This is a fixed size, so memory use is bounded however many values
+     *  are evicted.  A false positive just means we're more conservative
+     *  with matches_lower_bound than we need to be.
+     */
+    std::vector<uint64_t> evicted;
 
     /// How many items we're currently keeping in @a table.
     Xapian::doccount entry_count;
 
+    /// How many of entry_count are in entries marked as uncounted.
+    Xapian::doccount uncounted_count;
+
+    /// How many counted items we've evicted from @a table.
+    Xapian::doccount evicted_count;
+
     /** How many documents have we seen without a collapse key?
      *
      *  We use this statistic to improve matches_lower_bound.
@@ -123,7 +179,9 @@ class Collapser {
     Xapian::Internal::MSetItem old_item;
 
     Collapser(Xapian::valueno slot_, Xapian::doccount collapse_max_)
-	: entry_count(0), no_collapse_key(0), dups_ignored(0),
+	: evict_threshold(COLLAPSER_MIN_EVICT_THRESHOLD),
+	  entry_count(0), uncounted_count(0), evicted_count(0),
+	  no_collapse_key(0), dups_ignored(0),
 	  docs_considered(0), slot(slot_), collapse_max(collapse_max_),
 	  old_item(0, 0) { }
 
@@ -137,13 +195,24 @@ class Collapser {
      *				(this happens for a remote match).
      *  @param doc		Document for getting values.
      *  @param mcmp		MSetItem comparison functor.
+     *  @param min_item		The lowest ranked item in the proto-MSet if
+     *				it is full, otherwise NULL.
      *
      *  @return How @a item was handled: EMPTY, ADDED, REJECTED or REPLACED.
      */
     collapse_result process(Xapian::Internal::MSetItem & item,
 			    PostList * postlist,
 			    Xapian::Document::Internal & vsdoc,
-			    const MSetCmp & mcmp);
+			    const MSetCmp & mcmp,
+			    const Xapian::Internal::MSetItem * min_item);
+
+    /** Evict entries which can no longer contribute to the MSet.
+     *
+     *  @param min_item		The lowest ranked item in the full proto-MSet.
+     *  @param mcmp		MSetItem comparison functor.
+     */
+    void evict(const Xapian::Internal::MSetItem & min_item,
+	       const MSetCmp & mcmp);
 
     Xapian::doccount get_collapse_count(const std::string & collapse_key,
 					int percent_cutoff,
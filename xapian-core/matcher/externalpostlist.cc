@@ -74,6 +74,19 @@ ExternalPostList::get_termfreq_max() const
     return source->get_termfreq_max();
 }
 
+double
+ExternalPostList::get_cost_est() const
+{
+    // A ValuePostingSource iterates the values in its slot, so has to read
+    // as many entries as it could possibly return.  We've no idea how other
+    // PostingSource subclasses find their documents, so assume they read
+    // about as many as they return.
+    Assert(source);
+    if (dynamic_cast<const Xapian::ValuePostingSource*>(source))
+	return source->get_termfreq_max();
+    return source->get_termfreq_est();
+}
+
 double
 ExternalPostList::get_maxweight() const
 {
@@ -64,6 +64,8 @@ class ExternalPostList : public PostList {
 
     Xapian::doccount get_termfreq_max() const;
 
+    double get_cost_est() const;
+
     double get_maxweight() const;
 
     Xapian::docid get_docid() const;
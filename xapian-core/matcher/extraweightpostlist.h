@@ -49,6 +49,9 @@ class ExtraWeightPostList : public PostList {
 	Xapian::doccount get_termfreq_est() const {
 	    return pl->get_termfreq_est();
 	}
+	double get_cost_est() const {
+	    return pl->get_cost_est();
+	}
 
 	Xapian::docid get_docid() const { return pl->get_docid(); }
 
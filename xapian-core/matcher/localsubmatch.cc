@@ -176,15 +176,15 @@ LocalSubMatch::prepare_match(bool nowait,
 void
 LocalSubMatch::start_match(Xapian::doccount first,
 			   Xapian::doccount maxitems,
-			   Xapian::doccount check_at_least,
+			   Xapian::doccount check_at_least_,
 			   Xapian::Weight::Internal & total_stats)
 {
-    LOGCALL_VOID(MATCH, "LocalSubMatch::start_match", first | maxitems | check_at_least | total_stats);
+    LOGCALL_VOID(MATCH, "LocalSubMatch::start_match", first | maxitems | check_at_least_ | total_stats);
     (void)first;
     (void)maxitems;
-    (void)check_at_least;
     // Store a pointer to the total stats to use when building the Query tree.
     stats = &total_stats;
+    check_at_least = check_at_least_;
 }
 
 PostList *
@@ -201,6 +201,8 @@ LocalSubMatch::get_postlist(MultiMatch * matcher,
     PostList * pl;
     {
 	QueryOptimiser opt(*db, *this, matcher);
+	opt.root_or = (query.get_type() == Xapian::Query::OP_OR);
+	opt.check_all = (check_at_least >= stats->collection_size);
 	pl = query.internal->postlist(&opt, 1.0);
 	*total_subqs_ptr = opt.get_total_subqs();
     }
@@ -281,6 +283,11 @@ LocalSubMatch::open_post_list(const string& term,
 		pl->set_term(term);
 	    }
 	}
+	if (!pl && !weighted && !in_synonym) {
+	    // If we're just using the term as a boolean filter, the database
+	    // may have its postings cached as a bitmap.
+	    pl = db->open_bitmap_post_list(term);
+	}
     }
 
     if (!pl) {
@@ -44,6 +44,9 @@ class LocalSubMatch : public SubMatch {
     /// The statistics for the collection.
     Xapian::Weight::Internal * stats;
 
+    /// How many documents the match must consider before raising w_min.
+    Xapian::doccount check_at_least;
+
     /// The original query before any rearrangement.
     Xapian::Query query;
 
@@ -69,8 +72,8 @@ class LocalSubMatch : public SubMatch {
 		  Xapian::termcount qlen_,
 		  const Xapian::RSet & rset_,
 		  const Xapian::Weight *wt_factory_)
-	: stats(NULL), query(query_), qlen(qlen_), db(db_), rset(rset_),
-	  wt_factory(wt_factory_)
+	: stats(NULL), check_at_least(0), query(query_), qlen(qlen_), db(db_),
+	  rset(rset_), wt_factory(wt_factory_)
     {
 	LOGCALL_CTOR(MATCH, "LocalSubMatch", db_ | query_ | qlen_ | rset_ | wt_factory_);
     }
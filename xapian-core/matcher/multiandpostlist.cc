@@ -33,11 +33,20 @@ MultiAndPostList::allocate_plist_and_max_wt()
     plist = new PostList * [n_kids];
     try {
 	max_wt = new double [n_kids];
+	sub_stats = new SubStats [n_kids];
     } catch (...) {
 	delete [] plist;
 	plist = NULL;
+	delete [] max_wt;
+	max_wt = NULL;
 	throw;
     }
+    for (size_t i = 0; i < n_kids; ++i) {
+	sub_stats[i].checks = 0;
+	sub_stats[i].rejects = 0;
+	sub_stats[i].misses = 0;
+	sub_stats[i].use_skip_to = false;
+    }
 }
 
 MultiAndPostList::~MultiAndPostList()
@@ -49,6 +58,7 @@ MultiAndPostList::~MultiAndPostList()
 	delete [] plist;
     }
     delete [] max_wt;
+    delete [] sub_stats;
 }
 
 Xapian::doccount
@@ -140,6 +150,19 @@ MultiAndPostList::get_termfreq_est_using_stats(
 		     static_cast<Xapian::termcount>(collfreqest + 0.5)));
 }
 
+double
+MultiAndPostList::get_cost_est() const
+{
+    // We iterate the first sub-postlist, and each other sub-postlist is
+    // advanced at most once per candidate, or to its end.
+    double candidates = plist[0]->get_termfreq_est();
+    double cost = plist[0]->get_cost_est();
+    for (size_t i = 1; i < n_kids; ++i) {
+	cost += min(plist[i]->get_cost_est(), candidates);
+    }
+    return cost;
+}
+
 double
 MultiAndPostList::get_maxweight() const
 {
@@ -203,6 +226,67 @@ MultiAndPostList::recalc_maxweight()
     return max_total;
 }
 
+/// Does sub-postlist a reject a higher proportion of candidates than b?
+static inline bool
+rejects_more(Xapian::doccount a_rejects, Xapian::doccount a_checks,
+	     Xapian::doccount b_rejects, Xapian::doccount b_checks)
+{
+    // A sub-postlist we've not asked about yet sorts last.
+    if (a_checks == 0) return false;
+    if (b_checks == 0) return true;
+    return double(a_rejects) * b_checks > double(b_rejects) * a_checks;
+}
+
+void
+MultiAndPostList::adapt_to_stats()
+{
+    LOGCALL_VOID(MATCH, "MultiAndPostList::adapt_to_stats", NO_ARGS);
+    for (size_t i = 1; i < n_kids; ++i) {
+	SubStats & s = sub_stats[i];
+	if (s.use_skip_to) {
+	    // Most candidates are matching, so skip_to() isn't often letting
+	    // us jump the driving postlist forward.
+	    if (s.rejects < s.checks / 2)
+		s.use_skip_to = false;
+	} else if (s.misses > 0 && s.rejects > s.checks - s.checks / 8) {
+	    // check() rejects nearly every candidate without telling us where
+	    // the next match is, so use skip_to() to find it and leapfrog the
+	    // driving postlist to there.  But only if skip_to() reads about as
+	    // many entries as it steps over matches - check() only misses for
+	    // postlists which would otherwise have to scan (like a value range
+	    // or a phrase) and for those skip_to() may well cost more than
+	    // the check() calls it saves.
+	    double cost = plist[i]->get_cost_est();
+	    if (cost <= 2.0 * plist[i]->get_termfreq_est())
+		s.use_skip_to = true;
+	}
+    }
+
+    // Insertion sort plist[1] to plist[n_kids - 1] so those which reject
+    // the most candidates are asked first.  The order is usually unchanged,
+    // and there aren't many sub-postlists, so this is cheap.
+    for (size_t i = 2; i < n_kids; ++i) {
+	size_t j = i;
+	while (j > 1 && rejects_more(sub_stats[j].rejects, sub_stats[j].checks,
+				     sub_stats[j - 1].rejects,
+				     sub_stats[j - 1].checks)) {
+	    swap(plist[j], plist[j - 1]);
+	    swap(max_wt[j], max_wt[j - 1]);
+	    swap(sub_stats[j], sub_stats[j - 1]);
+	    --j;
+	}
+    }
+
+    // Decay the statistics so we track changes in the distribution of
+    // documents as we move through the docid space.
+    for (size_t i = 1; i < n_kids; ++i) {
+	sub_stats[i].checks /= 2;
+	sub_stats[i].rejects /= 2;
+	sub_stats[i].misses /= 2;
+    }
+    until_adapt = ADAPT_INTERVAL;
+}
+
 PostList *
 MultiAndPostList::find_next_match(double w_min)
 {
@@ -212,10 +296,20 @@ advanced_plist0:
 	return NULL;
     }
     did = plist[0]->get_docid();
+    if (rare(--until_adapt == 0))
+	adapt_to_stats();
     for (size_t i = 1; i < n_kids; ++i) {
-	bool valid;
-	check_helper(i, did, w_min, valid);
+	SubStats & s = sub_stats[i];
+	++s.checks;
+	bool valid = true;
+	if (s.use_skip_to) {
+	    skip_to_helper(i, did, w_min);
+	} else {
+	    check_helper(i, did, w_min, valid);
+	}
 	if (!valid) {
+	    ++s.rejects;
+	    ++s.misses;
 	    next_helper(0, w_min);
 	    goto advanced_plist0;
 	}
@@ -225,6 +319,7 @@ advanced_plist0:
 	}
 	Xapian::docid new_did = plist[i]->get_docid();
 	if (new_did != did) {
+	    ++s.rejects;
 	    skip_to_helper(0, new_did, w_min);
 	    goto advanced_plist0;
 	}
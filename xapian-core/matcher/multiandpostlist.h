@@ -30,6 +30,9 @@
 
 /// N-way AND postlist.
 class MultiAndPostList : public PostList {
+    /// How many candidates to examine between calls to adapt_to_stats().
+    static const Xapian::doccount ADAPT_INTERVAL = 1024;
+
     /** Comparison functor which orders PostList* by ascending
      *  get_termfreq_est(). */
     struct ComparePostListTermFreqAscending {
@@ -39,6 +42,15 @@ class MultiAndPostList : public PostList {
 	}
     };
 
+    /** Comparison functor which orders PostList* by ascending
+     *  get_cost_est(). */
+    struct ComparePostListCostAscending {
+	/// Order by ascending get_cost_est().
+	bool operator()(const PostList *a, const PostList *b) const {
+	    return a->get_cost_est() < b->get_cost_est();
+	}
+    };
+
     /// Don't allow assignment.
     void operator=(const MultiAndPostList &);
 
@@ -57,6 +69,31 @@ class MultiAndPostList : public PostList {
     /// Array of maximum weights for the sub-postlists.
     double * max_wt;
 
+    /// What we've observed about how a sub-postlist filters candidates.
+    struct SubStats {
+	/// Number of candidates this sub-postlist has been asked about.
+	Xapian::doccount checks;
+
+	/// Number of those candidates which this sub-postlist rejected.
+	Xapian::doccount rejects;
+
+	/// Number of rejections where check() didn't move the sub-postlist.
+	Xapian::doccount misses;
+
+	/// Should we advance this sub-postlist with skip_to() not check()?
+	bool use_skip_to;
+    };
+
+    /** Array of observed statistics for the sub-postlists.
+     *
+     *  The entry for plist[0] is unused, since that's the sub-postlist which
+     *  drives the AND.
+     */
+    SubStats * sub_stats;
+
+    /// Candidates to examine before we next call adapt_to_stats().
+    Xapian::doccount until_adapt;
+
     /// Total maximum weight (== sum of max_wt values).
     double max_total;
 
@@ -102,12 +139,22 @@ class MultiAndPostList : public PostList {
 	}
     }
 
-    /** Allocate plist and max_wt arrays of @a n_kids each.
+    /** Allocate plist, max_wt and sub_stats arrays of @a n_kids each.
      *
      *  @exception  std::bad_alloc.
      */
     void allocate_plist_and_max_wt();
 
+    /** Adjust how we use the sub-postlists based on their statistics.
+     *
+     *  Sub-postlists other than the first are reordered so the ones which
+     *  reject the most candidates are asked first, and we pick between
+     *  check() and skip_to() for each one.  We only switch to skip_to() for
+     *  a sub-postlist whose get_cost_est() is close to its termfreq, since
+     *  otherwise skip_to() has to scan entries which don't match.
+     */
+    void adapt_to_stats();
+
     /// Advance the sublists to the next match.
     PostList * find_next_match(double w_min);
 
@@ -119,6 +166,7 @@ class MultiAndPostList : public PostList {
     MultiAndPostList(RandomItor pl_begin, RandomItor pl_end,
 		     MultiMatch * matcher_, Xapian::doccount db_size_)
 	: did(0), n_kids(pl_end - pl_begin), plist(NULL), max_wt(NULL),
+	  sub_stats(NULL), until_adapt(ADAPT_INTERVAL),
 	  max_total(0), db_size(db_size_), matcher(matcher_)
     {
 	allocate_plist_and_max_wt();
@@ -128,6 +176,15 @@ class MultiAndPostList : public PostList {
 	// the longer lists based on those.
 	std::partial_sort_copy(pl_begin, pl_end, plist, plist + n_kids,
 			       ComparePostListTermFreqAscending());
+
+	// The first postlist drives the AND and the others are only advanced
+	// with check() and skip_to(), so move the one which is cheapest to
+	// iterate to the front.  For term postlists the cost is the termfreq,
+	// so this only changes the order when there's something like a value
+	// range, which is then just used to filter candidates.
+	PostList ** driver = std::min_element(plist, plist + n_kids,
+					      ComparePostListCostAscending());
+	std::rotate(plist, driver, driver + 1);
     }
 
     /** Construct as the decay product of an OrPostList or AndMaybePostList. */
@@ -135,6 +192,7 @@ class MultiAndPostList : public PostList {
 		     double lmax, double rmax,
 		     MultiMatch * matcher_, Xapian::doccount db_size_)
 	: did(0), n_kids(2), plist(NULL), max_wt(NULL),
+	  sub_stats(NULL), until_adapt(ADAPT_INTERVAL),
 	  max_total(lmax + rmax), db_size(db_size_), matcher(matcher_)
     {
 	// Even if we're the decay product of an OrPostList, we may want to
@@ -163,6 +221,8 @@ class MultiAndPostList : public PostList {
     TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
+    double get_cost_est() const;
+
     double get_maxweight() const;
 
     Xapian::docid get_docid() const;
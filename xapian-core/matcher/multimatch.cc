@@ -687,7 +687,13 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	// Perform collapsing on key if requested.
 	if (collapser) {
 	    collapse_result res;
-	    res = collapser.process(new_item, pl.get(), vsdoc, mcmp);
+	    // Once the proto-MSet is full, min_item tells the collapser which
+	    // entries can't make it in.
+	    const Xapian::Internal::MSetItem * full_min_item = NULL;
+	    if (max_msize && items.size() >= max_msize)
+		full_min_item = &min_item;
+	    res = collapser.process(new_item, pl.get(), vsdoc, mcmp,
+				    full_min_item);
 	    if (res == REJECTED) {
 		// If we're sorting by relevance primarily, then we throw away
 		// the lower weighted document anyway.
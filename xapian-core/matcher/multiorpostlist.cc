@@ -0,0 +1,352 @@
+/** @file multiorpostlist.cc
+ * @brief N-way OR postlist using a heap
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "multiorpostlist.h"
+
+#include "debuglog.h"
+#include "multimatch.h"
+#include "omassert.h"
+
+using namespace std;
+
+/** Comparison functor which orders PostList* by descending get_docid().
+ *
+ *  Used with the std heap algorithms to put the lowest docid at the top.
+ */
+struct ComparePostListDocIdDescending {
+    /// Order by descending get_docid().
+    bool operator()(const PostList *a, const PostList *b) const {
+	return a->get_docid() > b->get_docid();
+    }
+};
+
+MultiOrPostList::~MultiOrPostList()
+{
+    if (plist) {
+	for (size_t i = 0; i < n_kids; ++i) {
+	    delete plist[i];
+	}
+	delete [] plist;
+    }
+}
+
+void
+MultiOrPostList::sift_down()
+{
+    PostList * pl = plist[0];
+    Xapian::docid pl_did = pl->get_docid();
+    size_t i = 0;
+    while (true) {
+	size_t child = i * 2 + 1;
+	if (child >= n_kids) break;
+	Xapian::docid child_did = plist[child]->get_docid();
+	if (child + 1 < n_kids) {
+	    Xapian::docid other_did = plist[child + 1]->get_docid();
+	    if (other_did < child_did) {
+		++child;
+		child_did = other_did;
+	    }
+	}
+	if (pl_did <= child_did) break;
+	plist[i] = plist[child];
+	i = child;
+    }
+    plist[i] = pl;
+}
+
+void
+MultiOrPostList::top_advanced(PostList * res)
+{
+    if (res) {
+	delete plist[0];
+	plist[0] = res;
+    }
+
+    if (plist[0]->at_end()) {
+	delete plist[0];
+	plist[0] = plist[--n_kids];
+	if (max_total != 0.0 || res) matcher->recalc_maxweight();
+    } else if (res) {
+	matcher->recalc_maxweight();
+    }
+
+    if (n_kids > 1) sift_down();
+}
+
+void
+MultiOrPostList::start(Xapian::docid did_min)
+{
+    LOGCALL_VOID(MATCH, "MultiOrPostList::start", did_min);
+    for (size_t i = 0; i < n_kids; ++i) {
+	PostList * res;
+	if (did_min == 0) {
+	    res = plist[i]->next(0);
+	} else {
+	    res = plist[i]->skip_to(did_min, 0);
+	}
+	if (res) {
+	    delete plist[i];
+	    plist[i] = res;
+	}
+
+	if (plist[i]->at_end()) {
+	    delete plist[i];
+	    plist[i--] = plist[--n_kids];
+	    if (max_total != 0.0 || res) matcher->recalc_maxweight();
+	    continue;
+	}
+
+	if (res)
+	    matcher->recalc_maxweight();
+    }
+    make_heap(plist, plist + n_kids, ComparePostListDocIdDescending());
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_min() const
+{
+    Xapian::doccount result = plist[0]->get_termfreq_min();
+    for (size_t i = 1; i < n_kids; ++i) {
+	Xapian::doccount tf_min = plist[i]->get_termfreq_min();
+	if (tf_min > result) result = tf_min;
+    }
+    return result;
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_max() const
+{
+    // Maximum is if all sub-postlists are disjoint.
+    Xapian::doccount result = 0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	Xapian::doccount tf_max = plist[i]->get_termfreq_max();
+	if (tf_max >= db_size - result)
+	    return db_size;
+	result += tf_max;
+    }
+    return result;
+}
+
+Xapian::doccount
+MultiOrPostList::get_termfreq_est() const
+{
+    LOGCALL(MATCH, Xapian::doccount, "MultiOrPostList::get_termfreq_est", NO_ARGS);
+    if (rare(db_size == 0))
+	RETURN(0);
+    // We calculate the estimate assuming independence.  With this assumption,
+    // the probability that a document doesn't match is the product of the
+    // probabilities that it doesn't match each sub-postlist.
+    double scale = 1.0 / db_size;
+    double P_none = 1.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	P_none *= 1.0 - plist[i]->get_termfreq_est() * scale;
+    }
+    RETURN(static_cast<Xapian::doccount>((1.0 - P_none) * db_size + 0.5));
+}
+
+TermFreqs
+MultiOrPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    LOGCALL(MATCH, TermFreqs, "MultiOrPostList::get_termfreq_est_using_stats", stats);
+    // We calculate the estimate assuming independence, as for
+    // get_termfreq_est().
+
+    // Our caller should have ensured this.
+    Assert(stats.collection_size);
+    double P_none = 1.0, Pr_none = 1.0, Pc_none = 1.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	TermFreqs freqs(plist[i]->get_termfreq_est_using_stats(stats));
+	P_none *= 1.0 - double(freqs.termfreq) / stats.collection_size;
+	Pc_none *= 1.0 - double(freqs.collfreq) / stats.total_term_count;
+	// If the rset is empty, reltermfreq should be 0 already, so leave it
+	// alone.
+	if (stats.rset_size != 0)
+	    Pr_none *= 1.0 - double(freqs.reltermfreq) / stats.rset_size;
+    }
+    RETURN(TermFreqs(
+	static_cast<Xapian::doccount>((1.0 - P_none) * stats.collection_size + 0.5),
+	static_cast<Xapian::doccount>((1.0 - Pr_none) * stats.rset_size + 0.5),
+	static_cast<Xapian::termcount>((1.0 - Pc_none) * stats.total_term_count + 0.5)));
+}
+
+double
+MultiOrPostList::get_cost_est() const
+{
+    double cost = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	cost += plist[i]->get_cost_est();
+    }
+    return cost;
+}
+
+double
+MultiOrPostList::get_maxweight() const
+{
+    LOGCALL(MATCH, double, "MultiOrPostList::get_maxweight", NO_ARGS);
+    RETURN(max_total);
+}
+
+Xapian::docid
+MultiOrPostList::get_docid() const
+{
+    return did;
+}
+
+Xapian::termcount
+MultiOrPostList::get_doclength() const
+{
+    Assert(did);
+    // The sub-postlist at the top of the heap is always at did.
+    return plist[0]->get_doclength();
+}
+
+Xapian::termcount
+MultiOrPostList::get_unique_terms() const
+{
+    Assert(did);
+    return plist[0]->get_unique_terms();
+}
+
+double
+MultiOrPostList::get_weight() const
+{
+    Assert(did);
+    double result = 0;
+    for_each_matching(0, [&result](PostList * pl) {
+	result += pl->get_weight();
+    });
+    return result;
+}
+
+bool
+MultiOrPostList::at_end() const
+{
+    return (did == 0);
+}
+
+double
+MultiOrPostList::recalc_maxweight()
+{
+    LOGCALL(MATCH, double, "MultiOrPostList::recalc_maxweight", NO_ARGS);
+    max_total = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	max_total += plist[i]->recalc_maxweight();
+    }
+    RETURN(max_total);
+}
+
+PostList *
+MultiOrPostList::next(double w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::next", w_min);
+    (void)w_min;
+    if (did == 0) {
+	start(0);
+    } else {
+	while (plist[0]->get_docid() == did) {
+	    top_advanced(plist[0]->next(0));
+	    if (n_kids == 0) break;
+	}
+    }
+
+    if (n_kids == 0) {
+	did = 0;
+	RETURN(NULL);
+    }
+
+    if (n_kids == 1) {
+	n_kids = 0;
+	RETURN(plist[0]);
+    }
+
+    did = plist[0]->get_docid();
+    RETURN(NULL);
+}
+
+PostList *
+MultiOrPostList::skip_to(Xapian::docid did_min, double w_min)
+{
+    LOGCALL(MATCH, PostList *, "MultiOrPostList::skip_to", did_min | w_min);
+    (void)w_min;
+    if (did == 0) {
+	start(did_min);
+    } else {
+	if (did_min <= did) RETURN(NULL);
+	while (plist[0]->get_docid() < did_min) {
+	    top_advanced(plist[0]->skip_to(did_min, 0));
+	    if (n_kids == 0) break;
+	}
+    }
+
+    if (n_kids == 0) {
+	did = 0;
+	RETURN(NULL);
+    }
+
+    if (n_kids == 1) {
+	n_kids = 0;
+	RETURN(plist[0]);
+    }
+
+    did = plist[0]->get_docid();
+    RETURN(NULL);
+}
+
+string
+MultiOrPostList::get_description() const
+{
+    string desc("(");
+    desc += plist[0]->get_description();
+    for (size_t i = 1; i < n_kids; ++i) {
+	desc += " OR ";
+	desc += plist[i]->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+Xapian::termcount
+MultiOrPostList::get_wdf() const
+{
+    Xapian::termcount totwdf = 0;
+    for_each_matching(0, [&totwdf](PostList * pl) {
+	totwdf += pl->get_wdf();
+    });
+    return totwdf;
+}
+
+Xapian::termcount
+MultiOrPostList::count_matching_subqs() const
+{
+    Xapian::termcount total = 0;
+    for_each_matching(0, [&total](PostList * pl) {
+	total += pl->count_matching_subqs();
+    });
+    return total;
+}
+
+void
+MultiOrPostList::gather_position_lists(OrPositionList* orposlist)
+{
+    for_each_matching(0, [orposlist](PostList * pl) {
+	pl->gather_position_lists(orposlist);
+    });
+}
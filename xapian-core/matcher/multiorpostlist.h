@@ -0,0 +1,152 @@
+/** @file multiorpostlist.h
+ * @brief N-way OR postlist using a heap
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MULTIORPOSTLIST_H
+#define XAPIAN_INCLUDED_MULTIORPOSTLIST_H
+
+#include "multimatch.h"
+#include "api/postlist.h"
+#include <algorithm>
+
+class MultiMatch;
+
+/** N-way OR postlist using a heap.
+ *
+ *  The sub-postlists are kept in a heap ordered by their current docid, so
+ *  advancing costs O(log n) comparisons for each sub-postlist which moves,
+ *  rather than a virtual method call at each level of a tree of binary
+ *  OrPostList objects.  This is a big win for ORs of many terms, such as
+ *  synonym and wildcard expansions.
+ *
+ *  The weight is the sum of the weights of the matching sub-postlists, but
+ *  unlike OrPostList, we don't use w_min to decay into AND-like postlists,
+ *  so this is intended for cases where the weights aren't used to prune,
+ *  such as an unweighted OR or the OR under a SynonymPostList.
+ */
+class MultiOrPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const MultiOrPostList &);
+
+    /// Don't allow copying.
+    MultiOrPostList(const MultiOrPostList &);
+
+    /// The current docid, or zero if we haven't started or are at_end.
+    Xapian::docid did;
+
+    /// The number of sub-postlists which aren't yet at_end.
+    size_t n_kids;
+
+    /** Array of pointers to sub-postlists.
+     *
+     *  Once we've started, this is a heap with the sub-postlist with the
+     *  lowest current docid at the top.
+     */
+    PostList ** plist;
+
+    /// Total maximum weight (== sum of the maximum weights of plist).
+    double max_total;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Pointer to the matcher object, so we can report pruning.
+    MultiMatch *matcher;
+
+    /// Move plist[0] down the heap after its docid has increased.
+    void sift_down();
+
+    /** Handle plist[0] having been advanced.
+     *
+     *  @param res  What next() or skip_to() returned.
+     */
+    void top_advanced(PostList * res);
+
+    /// Call next() or skip_to() on every sub-postlist and build the heap.
+    void start(Xapian::docid did_min);
+
+    /// Call @a f on each sub-postlist in the heap under @a i at docid did.
+    template<class F>
+    void for_each_matching(size_t i, F f) const {
+	if (i >= n_kids || plist[i]->get_docid() != did) return;
+	f(plist[i]);
+	for_each_matching(i * 2 + 1, f);
+	for_each_matching(i * 2 + 2, f);
+    }
+
+  public:
+    /** Construct from 2 random-access iterators to a container of PostList*,
+     *  a pointer to the matcher, and the document collection size.
+     */
+    template <class RandomItor>
+    MultiOrPostList(RandomItor pl_begin, RandomItor pl_end,
+		    MultiMatch * matcher_, Xapian::doccount db_size_)
+	: did(0), n_kids(pl_end - pl_begin), plist(NULL),
+	  max_total(0), db_size(db_size_), matcher(matcher_)
+    {
+	plist = new PostList * [n_kids];
+	std::copy(pl_begin, pl_end, plist);
+    }
+
+    ~MultiOrPostList();
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    double get_cost_est() const;
+
+    double get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::termcount get_unique_terms() const;
+
+    double get_weight() const;
+
+    bool at_end() const;
+
+    double recalc_maxweight();
+
+    Internal *next(double w_min);
+
+    Internal *skip_to(Xapian::docid, double w_min);
+
+    std::string get_description() const;
+
+    /** get_wdf() for MultiOrPostList returns the sum of the wdfs of the
+     *  sub postlists which match the current docid.
+     *
+     *  The wdf isn't really meaningful in many situations, but if the lists
+     *  are being combined as a synonym we want the sum of the wdfs, so we do
+     *  that in general.
+     */
+    Xapian::termcount get_wdf() const;
+
+    Xapian::termcount count_matching_subqs() const;
+
+    void gather_position_lists(OrPositionList* orposlist);
+};
+
+#endif // XAPIAN_INCLUDED_MULTIORPOSTLIST_H
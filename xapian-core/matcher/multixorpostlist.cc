@@ -136,6 +136,17 @@ MultiXorPostList::get_termfreq_est() const
     return static_cast<Xapian::doccount>(P_est * db_size + 0.5);
 }
 
+double
+MultiXorPostList::get_cost_est() const
+{
+    // We need to read every posting in every subquery.
+    double cost = 0.0;
+    for (size_t i = 0; i < n_kids; ++i) {
+	cost += plist[i]->get_cost_est();
+    }
+    return cost;
+}
+
 TermFreqs
 MultiXorPostList::get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const
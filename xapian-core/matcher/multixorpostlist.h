@@ -86,6 +86,8 @@ class MultiXorPostList : public PostList {
 
     Xapian::doccount get_termfreq_est() const;
 
+    double get_cost_est() const;
+
     TermFreqs get_termfreq_est_using_stats(
 	const Xapian::Weight::Internal & stats) const;
 
@@ -45,6 +45,12 @@ OrPosPostList::get_termfreq_est() const
     return pl->get_termfreq_est();
 }
 
+double
+OrPosPostList::get_cost_est() const
+{
+    return pl->get_cost_est();
+}
+
 TermFreqs
 OrPosPostList::get_termfreq_est_using_stats(const Xapian::Weight::Internal & stats) const
 {
@@ -336,6 +336,12 @@ OrPostList::get_termfreq_est_using_stats(
 		     static_cast<Xapian::termcount>(collfreqest + 0.5)));
 }
 
+double
+OrPostList::get_cost_est() const
+{
+    return l->get_cost_est() + r->get_cost_est();
+}
+
 Xapian::docid
 OrPostList::get_docid() const
 {
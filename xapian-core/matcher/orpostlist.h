@@ -48,6 +48,8 @@ class OrPostList : public BranchPostList {
 	TermFreqs get_termfreq_est_using_stats(
 	    const Xapian::Weight::Internal & stats) const;
 
+	double get_cost_est() const;
+
 	Xapian::docid get_docid() const;
 	double get_weight() const;
 	double get_maxweight() const;
@@ -57,6 +57,20 @@ class QueryOptimiser {
 
     bool in_synonym;
 
+    /** Is the next OR subquery the root of the query?
+     *
+     *  If so, its postlist will only be advanced by next(), so it can be
+     *  matched term-at-a-time.
+     */
+    bool root_or;
+
+    /** Will the matcher have to consider every matching document?
+     *
+     *  If so, it never passes a non-zero w_min (unless a weight cutoff is
+     *  set) so postlists which decay or skip based on it gain nothing.
+     */
+    bool check_all;
+
     bool full_db_has_positions;
 
     const Xapian::Database::Internal & db;
@@ -70,7 +84,8 @@ class QueryOptimiser {
 		   MultiMatch * matcher_)
 	: localsubmatch(localsubmatch_), total_subqs(0),
 	  hint(0), hint_owned(false),
-	  need_positions(false), in_synonym(false),
+	  need_positions(false), in_synonym(false), root_or(false),
+	  check_all(false),
 	  full_db_has_positions(matcher_->full_db_has_positions()),
 	  db(db_), db_size(db.get_doccount()),
 	  matcher(matcher_) { }
@@ -54,6 +54,10 @@ class SelectPostList : public PostList {
 	// pass all these through to the underlying source PostList
 	Xapian::doccount get_termfreq_max() const { return source->get_termfreq_max(); }
 	Xapian::doccount get_termfreq_min() const { return 0; }
+	double get_cost_est() const {
+	    // Each candidate from the source needs test_doc() calling on it.
+	    return source->get_cost_est() + source->get_termfreq_est();
+	}
 	double get_maxweight() const { return source->get_maxweight(); }
 	Xapian::docid get_docid() const { return source->get_docid(); }
 	double get_weight() const {
@@ -135,6 +135,12 @@ SynonymPostList::get_termfreq_est() const {
     RETURN(subtree->get_termfreq_est());
 }
 
+double
+SynonymPostList::get_cost_est() const {
+    LOGCALL(MATCH, double, "SynonymPostList::get_cost_est", NO_ARGS);
+    RETURN(subtree->get_cost_est());
+}
+
 Xapian::doccount
 SynonymPostList::get_termfreq_max() const {
     LOGCALL(MATCH, Xapian::doccount, "SynonymPostList::get_termfreq_max", NO_ARGS);
@@ -92,6 +92,8 @@ class SynonymPostList : public PostList {
     Xapian::termcount get_wdf() const;
     Xapian::doccount get_termfreq_min() const;
     Xapian::doccount get_termfreq_est() const;
+
+    double get_cost_est() const;
     Xapian::doccount get_termfreq_max() const;
     // Note - we don't need to implement get_termfreq_est_using_stats()
     // because a synonym when used as a child of a synonym will be optimised
@@ -104,6 +104,14 @@ ValueRangePostList::get_termfreq_max() const
     return db->get_value_freq(slot);
 }
 
+double
+ValueRangePostList::get_cost_est() const
+{
+    // Iterating means reading every value in the slot to find those in the
+    // range, however few of them match.
+    return db->get_value_freq(slot);
+}
+
 double
 ValueRangePostList::get_maxweight() const
 {
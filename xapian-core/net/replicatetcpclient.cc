@@ -22,6 +22,7 @@
 
 #include "replicatetcpclient.h"
 
+#include <xapian/error.h>
 #include "api/replication.h"
 
 #include "socket_utils.h"
@@ -33,7 +34,7 @@ ReplicateTcpClient::ReplicateTcpClient(const string & hostname, int port,
 				       double timeout_connect,
 				       double socket_timeout)
     : socket(open_socket(hostname, port, timeout_connect)),
-      remconn(-1, socket)
+      remconn(-1, socket), replica(NULL), streaming(false)
 {
     set_socket_timeouts(socket, socket_timeout);
 }
@@ -50,19 +51,34 @@ ReplicateTcpClient::update_from_master(const std::string & path,
 				       const std::string & masterdb,
 				       Xapian::ReplicationInfo & info,
 				       double reader_close_time,
-				       bool force_copy)
+				       bool force_copy,
+				       bool stream,
+				       bool delta_copy)
 {
-    Xapian::DatabaseReplica replica(path);
-    remconn.send_message('R',
-			 force_copy ? string() : replica.get_revision_info(),
-			 0.0);
-    remconn.send_message('D', masterdb, 0.0);
-    replica.set_read_fd(socket);
+    if (replica == NULL) {
+	replica = new Xapian::DatabaseReplica(path);
+	streaming = stream;
+	// Checksumming the replica's files means reading them all, so just
+	// offer the checksums, and the master asks if it needs to send a copy.
+	if (replica->offer_copy_basis(socket, delta_copy))
+	    remconn.send_message('C', string(), 0.0);
+	remconn.send_message(streaming ? 'S' : 'R',
+			     force_copy ? string() : replica->get_revision_info(),
+			     0.0);
+	remconn.send_message('D', masterdb, 0.0);
+	replica->set_read_fd(socket);
+    } else if (streaming) {
+	// Tell the master which revision we've reached, which also tells it
+	// that we're ready for more changes.
+	remconn.send_message('R', replica->get_revision_info(), 0.0);
+    } else {
+	throw Xapian::InvalidOperationError("Replica already updated on this connection");
+    }
     info.clear();
     bool more;
     do {
 	Xapian::ReplicationInfo subinfo;
-	more = replica.apply_next_changeset(&subinfo, reader_close_time);
+	more = replica->apply_next_changeset(&subinfo, reader_close_time);
 	info.changeset_count += subinfo.changeset_count;
 	info.fullcopy_count += subinfo.fullcopy_count;
 	if (subinfo.changed)
@@ -72,5 +88,6 @@ ReplicateTcpClient::update_from_master(const std::string & path,
 
 ReplicateTcpClient::~ReplicateTcpClient()
 {
+    delete replica;
     remconn.do_close(true);
 }
@@ -46,6 +46,12 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     /// Write-only connection to the server.
     RemoteConnection remconn;
 
+    /// The replica being updated, or NULL before the first update.
+    Xapian::DatabaseReplica * replica;
+
+    /// True if the connection is in streaming mode.
+    bool streaming;
+
     /** Attempt to open a TCP/IP socket connection to a replication server.
      *
      *  Connect to replication server running on port @a port of host @a hostname.
@@ -71,11 +77,30 @@ class XAPIAN_VISIBILITY_DEFAULT ReplicateTcpClient SOCKET_INITIALIZER_MIXIN {
     ReplicateTcpClient(const std::string & hostname, int port,
 		       double timeout_connect, double socket_timeout);
 
+    /** Update the replica at @a path from the master.
+     *
+     *  If @a stream is true, the master keeps the connection open once the
+     *  replica is up to date.  Calling this method again then blocks until
+     *  the master commits a new revision, which is pushed to the replica as
+     *  soon as it's available.  On these calls, @a path, @a remotedb,
+     *  @a force_copy and @a stream are ignored.  If the connection is lost,
+     *  a new client will resume from the replica's current revision.
+     *
+     *  Without streaming, this method may only be called once.
+     *
+     *  If @a delta_copy is true and the master needs to send a copy of the
+     *  database, only the parts of files which differ from the replica's
+     *  live copy are sent.  A copy which was interrupted is always resumed
+     *  in this way.  The replica's files are only read to checksum them
+     *  once the master says it needs to send a copy.
+     */
     void update_from_master(const std::string & path,
 			    const std::string & remotedb,
 			    Xapian::ReplicationInfo & info,
 			    double reader_close_time,
-			    bool force_copy);
+			    bool force_copy,
+			    bool stream = false,
+			    bool delta_copy = false);
 
     /** Destructor. */
     ~ReplicateTcpClient();
@@ -24,6 +24,8 @@
 
 #include <xapian/error.h>
 #include "api/replication.h"
+#include "realtime.h"
+#include "replicationprotocol.h"
 
 using namespace std;
 
@@ -41,11 +43,21 @@ ReplicateTcpServer::handle_one_connection(int socket)
 {
     RemoteConnection client(socket, -1);
     try {
-	// Read start_revision from the client.
+	// Read start_revision from the client.  An 'S' message rather than
+	// 'R' requests streaming mode.  These may be preceded by an empty 'C'
+	// message, which offers checksums of the replica's existing files if
+	// we need to send a copy of the database.
 	string start_revision;
-	if (client.get_message(start_revision, 0.0) != 'R') {
+	bool request_basis = false;
+	int type = client.get_message(start_revision, 0.0);
+	if (type == 'C') {
+	    request_basis = true;
+	    type = client.get_message(start_revision, 0.0);
+	}
+	if (type != 'R' && type != 'S') {
 	    throw Xapian::NetworkError("Bad replication client message");
 	}
+	bool stream = (type == 'S');
 
 	// Read dbname from the client.
 	string dbname;
@@ -60,7 +72,31 @@ ReplicateTcpServer::handle_one_connection(int socket)
 	dbpath += '/';
 	dbpath += dbname;
 	Xapian::DatabaseMaster master(dbpath);
-	master.write_changesets_to_fd(socket, start_revision, NULL);
+	while (true) {
+	    master.write_changesets_to_fd(socket, start_revision, NULL,
+					  string(), request_basis);
+	    if (!stream) break;
+
+	    // The replica acknowledges each batch of changes with the revision
+	    // it has reached.  We don't send anything more until then, so a
+	    // replica which is slow to apply changes holds back the master
+	    // rather than data piling up in socket buffers.
+	    if (client.get_message(start_revision, 0.0) != 'R') {
+		throw Xapian::NetworkError("Bad replication client message (3)");
+	    }
+
+	    // Wait for a new revision to be committed.  The client shouldn't
+	    // send anything while we wait, so if the socket becomes readable
+	    // the client has gone away.
+	    while (!master.has_changes_since(start_revision)) {
+		try {
+		    (void)client.sniff_next_message_type(
+			    RealTime::end_time(STREAM_POLL_INTERVAL));
+		    return;
+		} catch (const Xapian::NetworkTimeoutError &) {
+		}
+	    }
+	}
     } catch (...) {
 	// Ignore exceptions.
     }
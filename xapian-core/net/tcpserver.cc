@@ -149,7 +149,10 @@ TcpServer::get_listening_socket(const std::string & host, int port,
 	// still works in a Terminal Services environment).
 	char name[64];
 	sprintf(name, "Global\\xapian-tcpserver-listening-%d", port);
-	if ((mutex = CreateMutex(NULL, TRUE, name)) == NULL) {
+	if (port == 0) {
+	    // The OS picks an unused port, so there's nothing to guard.
+	    mutex = NULL;
+	} else if ((mutex = CreateMutex(NULL, TRUE, name)) == NULL) {
 	    // We failed to create the mutex, probably the error is
 	    // ERROR_ACCESS_DENIED, which simply means that TcpServer is
 	    // already running on this port but as a different user.
@@ -159,7 +162,7 @@ TcpServer::get_listening_socket(const std::string & host, int port,
 	    CloseHandle(mutex);
 	    mutex = NULL;
 	}
-	if (mutex == NULL) {
+	if (mutex == NULL && port != 0) {
 	    cerr << "Server is already running on port " << port << endl;
 	    // 69 is EX_UNAVAILABLE.  Scripts can use this to detect if the
 	    // server failed to bind to the requested port.
@@ -299,6 +302,18 @@ TcpServer::~TcpServer()
 #endif
 }
 
+int
+TcpServer::get_port() const
+{
+    struct sockaddr_in address;
+    SOCKLEN_T address_size = sizeof(address);
+    if (getsockname(listen_socket, reinterpret_cast<sockaddr *>(&address),
+		    &address_size) < 0) {
+	throw Xapian::NetworkError("getsockname failed", socket_errno());
+    }
+    return ntohs(address.sin_port);
+}
+
 #ifdef HAVE_FORK
 // A fork() based implementation.
 void
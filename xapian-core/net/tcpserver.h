@@ -81,7 +81,8 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
      *
      *  @param host	The hostname or address for the interface to listen on
      *			(or "" to listen on all interfaces).
-     *  @param port	The TCP port number to listen on.
+     *  @param port	The TCP port number to listen on (or 0 to pick an
+     *			unused port - see get_port()).
      *  @param tcp_nodelay	If true, enable TCP_NODELAY option.
      *	@param verbose	Should we produce output when connections are
      *			made or lost?
@@ -92,6 +93,9 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
     /** Destructor. */
     virtual ~TcpServer();
 
+    /// Return the TCP port number we're listening on.
+    int get_port() const;
+
     /** Accept connections and service requests indefinitely.
      *
      *  This method runs the TcpServer as a daemon which accepts a connection
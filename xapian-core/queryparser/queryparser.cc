@@ -25,11 +25,14 @@
 #include "xapian/error.h"
 #include <xapian/queryparser.h>
 #include <xapian/termiterator.h>
+#include <xapian/unicode.h>
 
 #include "api/vectortermlist.h"
 #include "omassert.h"
 #include "queryparser_internal.h"
+#include "str.h"
 
+#include <algorithm>
 #include <cstring>
 
 using namespace Xapian;
@@ -56,6 +59,64 @@ SimpleStopper::get_description() const
     return desc;
 }
 
+string
+WordSegmenter::get_description() const
+{
+    return "Xapian::WordSegmenter subclass";
+}
+
+void
+DictionaryWordSegmenter::add(const string & word)
+{
+    if (word.empty()) return;
+    dictionary.insert(word);
+    unsigned len = 0;
+    for (Utf8Iterator i(word); i != Utf8Iterator(); ++i) ++len;
+    if (len > max_length) max_length = len;
+}
+
+void
+DictionaryWordSegmenter::operator()(const string & text,
+				    vector<string> & words) const
+{
+    // Byte offset of the start of each character, plus the end of the text.
+    vector<size_t> offsets;
+    for (Utf8Iterator i(text); i != Utf8Iterator(); ++i) {
+	offsets.push_back(i.raw() - text.data());
+    }
+    size_t n_chars = offsets.size();
+    offsets.push_back(text.size());
+
+    size_t i = 0;
+    while (i < n_chars) {
+	size_t len = min(size_t(max_length), n_chars - i);
+	while (len > 1) {
+	    size_t start = offsets[i];
+	    string candidate(text, start, offsets[i + len] - start);
+	    if (dictionary.find(candidate) != dictionary.end()) {
+		words.push_back(std::move(candidate));
+		break;
+	    }
+	    --len;
+	}
+	if (len <= 1) {
+	    // No dictionary word starts here, so take a single character.
+	    len = 1;
+	    words.push_back(text.substr(offsets[i], offsets[i + 1] - offsets[i]));
+	}
+	i += len;
+    }
+}
+
+string
+DictionaryWordSegmenter::get_description() const
+{
+    string desc("Xapian::DictionaryWordSegmenter(");
+    desc += str(dictionary.size());
+    desc += " words)";
+    return desc;
+}
+
 RangeProcessor::~RangeProcessor() { }
 
 ValueRangeProcessor::~ValueRangeProcessor() { }
@@ -93,6 +154,12 @@ QueryParser::set_stopper(const Stopper * stopper)
     internal->stopper = stopper;
 }
 
+void
+QueryParser::set_segmenter(const WordSegmenter * segmenter)
+{
+    internal->segmenter = segmenter;
+}
+
 void
 QueryParser::set_default_op(Query::op default_op)
 {
@@ -87,6 +87,7 @@ class QueryParser::Internal : public Xapian::Internal::intrusive_base {
     Stem stemmer;
     stem_strategy stem_action;
     Xapian::Internal::opt_intrusive_ptr<const Stopper> stopper;
+    Xapian::Internal::opt_intrusive_ptr<const WordSegmenter> segmenter;
     Query::op default_op;
     const char * errmsg;
     Database db;
@@ -120,11 +121,11 @@ class QueryParser::Internal : public Xapian::Internal::intrusive_base {
 			    const string* grouping);
 
     std::string parse_term(Utf8Iterator &it, const Utf8Iterator &end,
-			   bool cjk_ngram, bool &is_cjk_term,
+			   bool cjk_split, bool &is_cjk_term,
 			   bool &was_acronym);
 
   public:
-    Internal() : stem_action(STEM_SOME), stopper(NULL),
+    Internal() : stem_action(STEM_SOME), stopper(NULL), segmenter(NULL),
 	default_op(Query::OP_OR), errmsg(NULL),
 	max_wildcard_expansion(0), max_partial_expansion(100),
 	max_wildcard_type(Xapian::Query::WILDCARD_LIMIT_ERROR),
@@ -55,11 +55,26 @@ TermGenerator::set_stopper(const Xapian::Stopper * stopper)
     internal->stopper = stopper;
 }
 
+void
+TermGenerator::set_segmenter(const Xapian::WordSegmenter * segmenter)
+{
+    internal->segmenter = segmenter;
+}
+
+void
+TermGenerator::set_offsets_slot(Xapian::valueno slot)
+{
+    internal->offsets_slot = slot;
+}
+
 void
 TermGenerator::set_document(const Xapian::Document & doc)
 {
     internal->doc = doc;
     internal->termpos = 0;
+    internal->offsets.resize(0);
+    internal->offsets_base = 0;
+    internal->last_offset = 0;
 }
 
 const Xapian::Document &
@@ -26,10 +26,13 @@
 #include "api/queryinternal.h"
 
 #include <xapian/document.h>
+#include <xapian/error.h>
 #include <xapian/queryparser.h>
 #include <xapian/stem.h>
 #include <xapian/unicode.h>
 
+#include "pack.h"
+#include "str.h"
 #include "stringutils.h"
 
 #include <algorithm>
@@ -57,6 +60,17 @@ inline unsigned check_wordchar(unsigned ch) {
     return 0;
 }
 
+/// Append @a ch to @a term as UTF-8, avoiding the general case for ASCII.
+inline void
+append_codepoint(string & term, unsigned ch)
+{
+    if (ch < 128) {
+	term += static_cast<char>(ch);
+    } else {
+	Unicode::append_utf8(term, ch);
+    }
+}
+
 inline bool
 should_stem(const std::string & term)
 {
@@ -127,10 +141,21 @@ inline unsigned check_suffix(unsigned ch) {
  *  Calls action(term, positional) for each term to add, where term is a
  *  std::string holding the term, and positional is a bool indicating
  *  if this term carries positional information.
+ *
+ *  If @a segmenter is non-NULL, runs of CJK characters are split into words
+ *  with it; otherwise if @a cjk_ngram is true they're split into n-grams.
  */
 template<typename ACTION> void
-parse_terms(Utf8Iterator itor, bool cjk_ngram, bool with_positions, ACTION action)
+parse_terms(Utf8Iterator itor, bool cjk_ngram,
+	    const WordSegmenter * segmenter,
+	    bool with_positions, ACTION action)
 {
+    // Does CJK text need splitting out from the surrounding text?
+    bool cjk_split = cjk_ngram || segmenter;
+    // Reuse the same buffer for every term so we only allocate when a term
+    // is longer than any seen before.
+    string term;
+    vector<string> cjk_words;
     while (true) {
 	// Advance to the start of the next term.
 	unsigned ch;
@@ -141,14 +166,14 @@ parse_terms(Utf8Iterator itor, bool cjk_ngram, bool with_positions, ACTION actio
 	    ++itor;
 	}
 
-	string term;
+	term.resize(0);
 	// Look for initials separated by '.' (e.g. P.T.O., U.N.C.L.E).
 	// Don't worry if there's a trailing '.' or not.
 	if (U_isupper(*itor)) {
 	    const Utf8Iterator end;
 	    Utf8Iterator p = itor;
 	    do {
-		Unicode::append_utf8(term, Unicode::tolower(*p++));
+		term += C_tolower(static_cast<char>(*p++));
 	    } while (p != end && *p == '.' && ++p != end && U_isupper(*p));
 	    // One letter does not make an acronym!  If we handled a single
 	    // uppercase letter here, we wouldn't catch M&S below.
@@ -164,14 +189,23 @@ parse_terms(Utf8Iterator itor, bool cjk_ngram, bool with_positions, ACTION actio
 	}
 
 	while (true) {
-	    if (cjk_ngram &&
+	    if (cjk_split &&
 		CJK::codepoint_is_cjk(*itor) &&
 		Unicode::is_wordchar(*itor)) {
 		const string & cjk = CJK::get_cjk(itor);
-		for (CJKTokenIterator tk(cjk); tk != CJKTokenIterator(); ++tk) {
-		    const string & cjk_token = *tk;
-		    if (!action(cjk_token, with_positions && tk.get_length() == 1, itor))
-			return;
+		if (segmenter) {
+		    cjk_words.clear();
+		    (*segmenter)(cjk, cjk_words);
+		    for (const string & word : cjk_words) {
+			if (!action(word, with_positions, itor))
+			    return;
+		    }
+		} else {
+		    for (CJKTokenIterator tk(cjk); tk != CJKTokenIterator(); ++tk) {
+			const string & cjk_token = *tk;
+			if (!action(cjk_token, with_positions && tk.get_length() == 1, itor))
+			    return;
+		    }
 		}
 		while (true) {
 		    if (itor == Utf8Iterator()) return;
@@ -183,10 +217,10 @@ parse_terms(Utf8Iterator itor, bool cjk_ngram, bool with_positions, ACTION actio
 	    }
 	    unsigned prevch;
 	    do {
-		Unicode::append_utf8(term, ch);
+		append_codepoint(term, ch);
 		prevch = ch;
 		if (++itor == Utf8Iterator() ||
-		    (cjk_ngram && CJK::codepoint_is_cjk(*itor)))
+		    (cjk_split && CJK::codepoint_is_cjk(*itor)))
 		    goto endofterm;
 		ch = check_wordchar(*itor);
 	    } while (ch);
@@ -205,7 +239,7 @@ parse_terms(Utf8Iterator itor, bool cjk_ngram, bool with_positions, ACTION actio
 	    }
 	    if (!infix_ch) break;
 	    if (infix_ch != UNICODE_IGNORE)
-		Unicode::append_utf8(term, infix_ch);
+		append_codepoint(term, infix_ch);
 	    ch = nextch;
 	    itor = next;
 	}
@@ -218,7 +252,7 @@ parse_terms(Utf8Iterator itor, bool cjk_ngram, bool with_positions, ACTION actio
 		    term.resize(len);
 		    break;
 		}
-		Unicode::append_utf8(term, ch);
+		term += static_cast<char>(ch);
 		if (++itor == Utf8Iterator()) goto endofterm;
 	    }
 	    // Don't index fish+chips as fish+ chips.
@@ -232,6 +266,14 @@ endofterm:
     }
 }
 
+inline void
+TermGenerator::Internal::add_offset(Xapian::termpos pos, size_t offset)
+{
+    pack_uint(offsets, pos);
+    pack_uint(offsets, offset - last_offset);
+    last_offset = offset;
+}
+
 void
 TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 				    const string & prefix, bool with_positions)
@@ -245,8 +287,15 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 	current_stop_mode = stop_mode;
     }
 
-    parse_terms(itor, cjk_ngram, with_positions,
-	[=](const string & term, bool positional, const Utf8Iterator &) {
+    bool record_offsets = (offsets_slot != BAD_VALUENO && with_positions);
+    size_t text_len = itor.left();
+
+    // Buffer to build prefixed terms in, reused to avoid an allocation for
+    // each term.
+    string buf;
+    parse_terms(itor, cjk_ngram, segmenter.get(), with_positions,
+	[=, &buf](const string & term, bool positional,
+		  const Utf8Iterator & it) {
 	    if (term.size() > max_word_length) return true;
 
 	    if (current_stop_mode == TermGenerator::STOP_ALL && (*stopper)(term))
@@ -254,10 +303,14 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 
 	    if (strategy == TermGenerator::STEM_SOME ||
 		strategy == TermGenerator::STEM_NONE) {
+		buf.assign(prefix);
+		buf += term;
 		if (positional) {
-		    doc.add_posting(prefix + term, ++termpos, wdf_inc);
+		    doc.add_posting(buf, ++termpos, wdf_inc);
+		    if (record_offsets)
+			add_offset(termpos, offsets_base + text_len - it.left());
 		} else {
-		    doc.add_term(prefix + term, wdf_inc);
+		    doc.add_term(buf, wdf_inc);
 		}
 	    }
 
@@ -280,19 +333,26 @@ TermGenerator::Internal::index_text(Utf8Iterator itor, termcount wdf_inc,
 	    // Add stemmed form without positional information.
 	    const string& stem = stemmer(term);
 	    if (rare(stem.empty())) return true;
-	    string stemmed_term;
+	    buf.resize(0);
 	    if (strategy != TermGenerator::STEM_ALL) {
-		stemmed_term += "Z";
+		buf += 'Z';
 	    }
-	    stemmed_term += prefix;
-	    stemmed_term += stem;
+	    buf += prefix;
+	    buf += stem;
 	    if (strategy != TermGenerator::STEM_SOME && with_positions) {
-		doc.add_posting(stemmed_term, ++termpos, wdf_inc);
+		doc.add_posting(buf, ++termpos, wdf_inc);
+		if (record_offsets)
+		    add_offset(termpos, offsets_base + text_len - it.left());
 	    } else {
-		doc.add_term(stemmed_term, wdf_inc);
+		doc.add_term(buf, wdf_inc);
 	    }
 	    return true;
 	});
+
+    if (record_offsets) {
+	offsets_base += text_len;
+	doc.add_value(offsets_slot, offsets);
+    }
 }
 
 struct Sniplet {
@@ -314,7 +374,7 @@ class SnipPipe {
     size_t length;
 
     // Position in text of start of current pipe contents.
-    size_t begin = 0;
+    size_t begin;
 
     // Rolling sum of the current pipe contents.
     double sum = 0;
@@ -322,15 +382,17 @@ class SnipPipe {
     size_t phrase_len = 0;
 
   public:
-    size_t best_begin = 0;
+    size_t best_begin;
 
-    size_t best_end = 0;
+    size_t best_end;
 
     double best_sum = 0;
 
     // Add one to length to allow for inter-word space.
     // FIXME: We ought to correctly allow for multiple spaces.
-    explicit SnipPipe(size_t length_) : length(length_ + 1) { }
+    SnipPipe(size_t length_, size_t begin_)
+	: length(length_ + 1), begin(begin_), best_begin(begin_),
+	  best_end(begin_) { }
 
     bool pump(double* r, size_t t, size_t h, unsigned flags);
 
@@ -609,25 +671,58 @@ non_term_subquery:
 }
 
 static double*
-check_term(unordered_map<string, double> & loose_terms,
-	   const Xapian::Weight::Internal * stats,
-	   const string & term,
-	   double max_tw)
+check_term(const unordered_map<string, size_t> & loose_terms,
+	   vector<double> & term_relevance,
+	   const string & term)
 {
     auto it = loose_terms.find(term);
     if (it == loose_terms.end()) return NULL;
+    return &term_relevance[it->second];
+}
 
-    if (it->second == 0.0) {
-	double relevance;
-	if (!stats->get_termweight(term, relevance)) {
-	    // FIXME: Assert?
-	    loose_terms.erase(it);
-	    return NULL;
+const MSet::Internal::SnippetQueryInfo &
+MSet::Internal::get_snippet_query_info() const
+{
+    SnippetQueryInfo & info = snippet_query_info;
+    const Xapian::Query & query = enquire->get_query();
+    if (!info.built || info.query.internal.get() != query.internal.get()) {
+	// Analyse the query - this is the same for every document in the
+	// MSet, so we only do it once.
+	info.query = query;
+	info.exact_phrases.clear();
+	info.wildcards.clear();
+	info.loose_terms.clear();
+	info.term_relevance.clear();
+	info.longest_phrase = 0;
+	info.min_tw = info.max_tw = 0;
+	if (stats) stats->get_max_termweight(info.min_tw, info.max_tw);
+	if (info.max_tw == 0.0) {
+	    info.max_tw = 1.0;
+	} else {
+	    // Scale up by (1 + 1/64) so that highlighting works better for
+	    // terms with termweight 0 (which happens for terms not in the
+	    // database, and also with some weighting schemes for terms which
+	    // occur in almost all documents.
+	    info.max_tw *= 1.015625;
 	}
 
-	it->second = relevance + max_tw;
+	unordered_map<string, double> loose_terms;
+	check_query(query, info.exact_phrases, loose_terms,
+		    info.wildcards, info.longest_phrase);
+	if (stats) {
+	    for (auto&& t : loose_terms) {
+		double relevance;
+		if (!stats->get_termweight(t.first, relevance)) {
+		    // FIXME: Assert?
+		    continue;
+		}
+		info.loose_terms.emplace(t.first, info.term_relevance.size());
+		info.term_relevance.push_back(relevance + info.max_tw);
+	    }
+	}
+	info.built = true;
     }
-    return &it->second;
+    return info;
 }
 
 string
@@ -637,7 +732,9 @@ MSet::Internal::snippet(const string & text,
 			unsigned flags,
 			const string & hi_start,
 			const string & hi_end,
-			const string & omit) const
+			const string & omit,
+			size_t text_start,
+			size_t text_end) const
 {
     if (hi_start.empty() && hi_end.empty() && text.size() <= length) {
 	// Too easy!
@@ -646,27 +743,20 @@ MSet::Internal::snippet(const string & text,
 
     bool cjk_ngram = CJK::is_cjk_enabled();
 
-    size_t term_start = 0;
-    double min_tw = 0, max_tw = 0;
-    if (stats) stats->get_max_termweight(min_tw, max_tw);
-    if (max_tw == 0.0) {
-	max_tw = 1.0;
-    } else {
-	// Scale up by (1 + 1/64) so that highlighting works better for terms
-	// with termweight 0 (which happens for terms not in the database, and
-	// also with some weighting schemes for terms which occur in almost all
-	// documents.
-	max_tw *= 1.015625;
-    }
+    if (text_end > text.size()) text_end = text.size();
+    size_t term_start = text_start;
 
-    SnipPipe snip(length);
+    const SnippetQueryInfo & info = get_snippet_query_info();
 
-    list<vector<string>> exact_phrases;
-    unordered_map<string, double> loose_terms;
-    list<string> wildcards;
-    size_t longest_phrase = 0;
-    check_query(enquire->get_query(), exact_phrases, loose_terms,
-		wildcards, longest_phrase);
+    double min_tw = info.min_tw, max_tw = info.max_tw;
+    const list<vector<string>> & exact_phrases = info.exact_phrases;
+    const list<string> & wildcards = info.wildcards;
+    size_t longest_phrase = info.longest_phrase;
+    // SnipPipe adjusts the relevances as terms enter and leave the window,
+    // so each call needs its own copy.
+    vector<double> term_relevance(info.term_relevance);
+
+    SnipPipe snip(length, text_start);
 
     vector<double> exact_phrases_relevance;
     exact_phrases_relevance.reserve(exact_phrases.size());
@@ -687,11 +777,17 @@ MSet::Internal::snippet(const string & text,
     // between calls to MSet::snippet() on the same object.
     unordered_map<string, double>& background = snippet_bg_relevance;
 
-    vector<string> phrase;
-    if (longest_phrase) phrase.resize(longest_phrase - 1);
+    // The previous words and their 'Z' stems, for matching phrases, which
+    // with STEM_ALL_Z are of stemmed terms.
+    vector<string> phrase, phrase_stems;
+    if (longest_phrase) {
+	phrase.resize(longest_phrase - 1);
+	phrase_stems.resize(longest_phrase - 1);
+    }
     size_t phrase_next = 0;
     bool matchfound = false;
-    parse_terms(Utf8Iterator(text), cjk_ngram, true,
+    parse_terms(Utf8Iterator(text.data() + text_start, text_end - text_start),
+		cjk_ngram, NULL, true,
 	[&](const string & term, bool positional, const Utf8Iterator & it) {
 	    // FIXME: Don't hardcode this here.
 	    const size_t max_word_length = 64;
@@ -702,18 +798,23 @@ MSet::Internal::snippet(const string & text,
 	    // We get segments with any "inter-word" characters in front of
 	    // each word, e.g.:
 	    // [The][ cat][ sat][ on][ the][ mat]
-	    size_t term_end = text.size() - it.left();
+	    size_t term_end = text_end - it.left();
 
 	    double* relevance = 0;
 	    size_t highlight = 0;
+	    string stem;
 	    if (stats) {
+		stem = "Z";
+		stem += stemmer(term);
 		size_t i = 0;
 		for (auto&& terms : exact_phrases) {
-		    if (term == terms.back()) {
+		    if (term == terms.back() || stem == terms.back()) {
 			size_t n = terms.size() - 1;
 			bool match = true;
 			while (n--) {
-			    if (terms[n] != phrase[(n + phrase_next) % (longest_phrase - 1)]) {
+			    size_t j = (n + phrase_next) % (longest_phrase - 1);
+			    if (terms[n] != phrase[j] &&
+				terms[n] != phrase_stems[j]) {
 				match = false;
 				break;
 			    }
@@ -728,16 +829,14 @@ MSet::Internal::snippet(const string & text,
 		    ++i;
 		}
 
-		relevance = check_term(loose_terms, stats, term, max_tw);
+		relevance = check_term(info.loose_terms, term_relevance, term);
 		if (relevance) {
 		    // Matched unstemmed term.
 		    highlight = 1;
 		    goto relevance_done;
 		}
 
-		string stem = "Z";
-		stem += stemmer(term);
-		relevance = check_term(loose_terms, stats, stem, max_tw);
+		relevance = check_term(info.loose_terms, term_relevance, stem);
 		if (relevance) {
 		    // Matched stemmed term.
 		    highlight = 1;
@@ -761,11 +860,12 @@ MSet::Internal::snippet(const string & text,
 		    auto bgit = background.find(term);
 		    if (bgit == background.end()) bgit = background.find(stem);
 		    if (bgit == background.end()) {
+			const string * bgterm = &stem;
 			Xapian::doccount tf = enquire->db.get_termfreq(term);
 			if (!tf) {
 			    tf = enquire->db.get_termfreq(stem);
 			} else {
-			    stem = term;
+			    bgterm = &term;
 			}
 			double r = 0.0;
 			if (tf) {
@@ -785,7 +885,7 @@ MSet::Internal::snippet(const string & text,
 			    }
 #endif
 			}
-			bgit = background.emplace(make_pair(stem, r)).first;
+			bgit = background.emplace(make_pair(*bgterm, r)).first;
 		    }
 		    relevance = &bgit->second;
 		}
@@ -830,6 +930,7 @@ MSet::Internal::snippet(const string & text,
 relevance_done:
 	    if (longest_phrase) {
 		phrase[phrase_next] = term;
+		phrase_stems[phrase_next] = stem;
 		phrase_next = (phrase_next + 1) % (longest_phrase - 1);
 	    }
 
@@ -852,4 +953,135 @@ relevance_done:
     return result;
 }
 
+string
+MSet::Internal::snippet(const string & text,
+			Xapian::docid did,
+			Xapian::valueno slot,
+			size_t length,
+			const Xapian::Stem & stemmer,
+			unsigned flags,
+			const string & hi_start,
+			const string & hi_end,
+			const string & omit) const
+{
+    const Xapian::Database & db = enquire->db;
+    const SnippetQueryInfo & info = get_snippet_query_info();
+
+    // Decode the term position to end offset table.
+    vector<pair<Xapian::termpos, size_t>> offsets;
+    const string & packed = db.get_document(did).get_value(slot);
+    const char * p = packed.data();
+    const char * end = p + packed.size();
+    size_t offset = 0;
+    while (p != end) {
+	Xapian::termpos pos;
+	size_t delta;
+	if (!unpack_uint(&p, end, &pos) || !unpack_uint(&p, end, &delta)) {
+	    throw Xapian::SerialisationError("Bad term offsets in value slot " +
+					     str(slot));
+	}
+	offset += delta;
+	offsets.emplace_back(pos, offset);
+    }
+    // Positions are normally already in order, but set_termpos() can be used
+    // to go backwards.
+    if (!is_sorted(offsets.begin(), offsets.end()))
+	sort(offsets.begin(), offsets.end());
+
+    // Find where the query terms occur in the text, and how much each
+    // occurrence is worth.
+    vector<pair<size_t, double>> hits;
+    auto add_hits = [&](const string & term, double relevance) {
+	Xapian::PositionIterator pos = db.positionlist_begin(did, term);
+	while (pos != db.positionlist_end(did, term)) {
+	    auto it = lower_bound(offsets.begin(), offsets.end(),
+				  make_pair(Xapian::termpos(*pos), size_t(0)));
+	    if (it != offsets.end() && it->first == *pos)
+		hits.emplace_back(it->second, relevance);
+	    ++pos;
+	}
+    };
+
+    if (!offsets.empty()) {
+	for (auto&& t : info.loose_terms) {
+	    const string & term = t.first;
+	    double relevance = info.term_relevance[t.second];
+	    size_t n_hits = hits.size();
+	    add_hits(term, relevance);
+	    if (term[0] != 'Z' || hits.size() != n_hits) continue;
+
+	    // Stemmed terms only have positional information with STEM_ALL_Z,
+	    // otherwise look for unstemmed terms in the document with the same
+	    // stem.  Snowball stemmers almost always leave the first few bytes
+	    // of a word alone, so we only need to check terms sharing those.
+	    string stem(term, 1);
+	    string start(stem, 0, 3);
+	    Xapian::TermIterator tl = db.termlist_begin(did);
+	    tl.skip_to(start);
+	    while (tl != db.termlist_end(did) && startswith(*tl, start)) {
+		if (stemmer(*tl) == stem) add_hits(*tl, relevance);
+		++tl;
+	    }
+	}
+
+	for (auto&& terms : info.exact_phrases) {
+	    // Approximate each phrase by the positions of its last term.
+	    add_hits(terms.back(), info.max_tw * terms.size());
+	}
+    }
+
+    if (hits.empty()) {
+	// No offsets stored, or none of the query terms (or at least none we
+	// can find positions for) occur, so we have to look at the whole text.
+	return snippet(text, length, stemmer, flags, hi_start, hi_end, omit);
+    }
+
+    // Find the window of at most length bytes with the highest total
+    // relevance.
+    sort(hits.begin(), hits.end());
+    size_t best_first = 0, best_last = 0;
+    double best_sum = -1.0, sum = 0.0;
+    size_t first = 0;
+    for (size_t last = 0; last != hits.size(); ++last) {
+	sum += hits[last].second;
+	while (hits[last].first - hits[first].first > length) {
+	    sum -= hits[first++].second;
+	}
+	if (sum > best_sum) {
+	    best_sum = sum;
+	    best_first = first;
+	    best_last = last;
+	}
+    }
+
+    // Only tokenise the text around that window, allowing enough either side
+    // for the snippet to be positioned freely.  We start and end the region
+    // on a space if there's one nearby so we don't split a word.
+    const size_t max_word_length = 64;
+    size_t region_start = min(hits[best_first].first, text.size());
+    region_start = (region_start > length) ? region_start - length : 0;
+    for (size_t i = 0; region_start > 0 && i != max_word_length; ++i) {
+	if (text[region_start - 1] == ' ') break;
+	--region_start;
+    }
+    while (region_start > 0 && (text[region_start] & 0xc0) == 0x80)
+	--region_start;
+
+    size_t region_end = hits[best_last].first + length;
+    if (region_end >= text.size()) {
+	region_end = text.size();
+    } else {
+	for (size_t i = 0; region_end < text.size() && i != max_word_length;
+	     ++i) {
+	    if (text[region_end] == ' ') break;
+	    ++region_end;
+	}
+	while (region_end < text.size() && (text[region_end] & 0xc0) == 0x80)
+	    ++region_end;
+    }
+
+    return snippet(text, length, stemmer, flags, hi_start, hi_end, omit,
+		   region_start, region_end);
+}
+
 }
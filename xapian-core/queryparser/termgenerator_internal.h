@@ -25,7 +25,7 @@
 #include <xapian/database.h>
 #include <xapian/document.h>
 #include <xapian/termgenerator.h>
-#include <xapian/queryparser.h> // For Xapian::Stopper
+#include <xapian/queryparser.h> // For Xapian::Stopper and WordSegmenter
 #include <xapian/stem.h>
 
 namespace Xapian {
@@ -37,6 +37,7 @@ class TermGenerator::Internal : public Xapian::Internal::intrusive_base {
     Stem stemmer;
     stem_strategy strategy;
     Xapian::Internal::opt_intrusive_ptr<const Stopper> stopper;
+    Xapian::Internal::opt_intrusive_ptr<const WordSegmenter> segmenter;
     stop_strategy stop_mode;
     Document doc;
     termcount termpos;
@@ -44,9 +45,29 @@ class TermGenerator::Internal : public Xapian::Internal::intrusive_base {
     unsigned max_word_length;
     WritableDatabase db;
 
+    /// Value slot to store term offsets in, or BAD_VALUENO.
+    valueno offsets_slot;
+
+    /** Encoded term offsets for the current document.
+     *
+     *  A sequence of (term position, end offset delta) pairs, each packed
+     *  with pack_uint().
+     */
+    std::string offsets;
+
+    /// Offset of the start of the text currently being indexed.
+    size_t offsets_base;
+
+    /// The last end offset added to @a offsets.
+    size_t last_offset;
+
+    void add_offset(Xapian::termpos pos, size_t offset);
+
   public:
-    Internal() : strategy(STEM_SOME), stopper(NULL), stop_mode(STOP_STEMMED),
-	termpos(0), flags(TermGenerator::flags(0)), max_word_length(64) { }
+    Internal() : strategy(STEM_SOME), stopper(NULL), segmenter(NULL),
+	stop_mode(STOP_STEMMED),
+	termpos(0), flags(TermGenerator::flags(0)), max_word_length(64),
+	offsets_slot(BAD_VALUENO), offsets_base(0), last_offset(0) { }
     void index_text(Utf8Iterator itor,
 		    termcount weight,
 		    const std::string & prefix,
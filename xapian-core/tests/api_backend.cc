@@ -28,6 +28,7 @@
 #include <xapian.h>
 
 #include "backendmanager.h"
+#include "envvar.h"
 #include "filetests.h"
 #include "str.h"
 #include "testrunner.h"
@@ -178,6 +179,47 @@ DEFINE_TESTCASE(dbstats1, backend) {
     return true;
 }
 
+/// Check the per-term wdf upper bound is tight and stays valid.
+DEFINE_TESTCASE(wdfupperbound1, writable) {
+    if (startswith(get_dbtype(), "remote"))
+	SKIP_TEST("Remote backends use a global bound which isn't updated");
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("rare");
+    for (int i = 0; i != 10; ++i) db.add_document(doc);
+    doc.add_term("common", 100);
+    db.add_document(doc);
+    db.commit();
+
+    bool exact = (get_dbtype() == "glass");
+    if (exact) {
+	TEST_EQUAL(db.get_wdf_upper_bound("rare"), 1);
+    } else {
+	TEST_REL(db.get_wdf_upper_bound("rare"),>=,1);
+    }
+    TEST_EQUAL(db.get_wdf_upper_bound("common"), 100);
+
+    // Pending changes must be allowed for before they're committed.
+    Xapian::Document doc2;
+    doc2.add_term("rare", 5);
+    Xapian::docid did = db.add_document(doc2);
+    TEST_REL(db.get_wdf_upper_bound("rare"),>=,5);
+    db.commit();
+    if (exact) {
+	TEST_EQUAL(db.get_wdf_upper_bound("rare"), 5);
+    } else {
+	TEST_REL(db.get_wdf_upper_bound("rare"),>=,5);
+    }
+
+    // After deletion the bound may be loose, but must still be an upper
+    // bound.
+    db.delete_document(did);
+    db.commit();
+    TEST_REL(db.get_wdf_upper_bound("rare"),>=,1);
+
+    return true;
+}
+
 // Check stats with a single document.  In a multi-database situation, this
 // gave 0 for get-_doclength_lower_bound() in 1.3.2.
 DEFINE_TESTCASE(dbstats2, backend) {
@@ -1086,6 +1128,129 @@ DEFINE_TESTCASE(notermlist1, glass) {
     return true;
 }
 
+/// Check XAPIAN_DOCLEN_CACHE gives the same document lengths.
+DEFINE_TESTCASE(doclencache1, glass) {
+    Xapian::WritableDatabase wdb = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo", 3);
+    doc.add_term("bar");
+    wdb.add_document(doc);
+    // A document with length 0.
+    wdb.add_document(Xapian::Document());
+    // Leave a gap in the docids.
+    doc.add_term("baz", 7);
+    wdb.replace_document(5, doc);
+    wdb.commit();
+
+    Xapian::Database db_nocache = get_writable_database_as_database();
+    set_env_var("XAPIAN_DOCLEN_CACHE", "1000");
+    Xapian::Database db = get_writable_database_as_database();
+    // Too small to use for this database.
+    set_env_var("XAPIAN_DOCLEN_CACHE", "3");
+    Xapian::Database db_small = get_writable_database_as_database();
+    // Invalid values should be ignored.
+    set_env_var("XAPIAN_DOCLEN_CACHE", "-1");
+    Xapian::Database db_negative = get_writable_database_as_database();
+    set_env_var("XAPIAN_DOCLEN_CACHE", "10x");
+    Xapian::Database db_garbage = get_writable_database_as_database();
+    set_env_var("XAPIAN_DOCLEN_CACHE", "0");
+
+    for (Xapian::docid did = 1; did <= 6; ++did) {
+	if (did == 1 || did == 2 || did == 5) {
+	    Xapian::termcount len = db_nocache.get_doclength(did);
+	    TEST_EQUAL(db.get_doclength(did), len);
+	    TEST_EQUAL(db_small.get_doclength(did), len);
+	    TEST_EQUAL(db_negative.get_doclength(did), len);
+	    TEST_EQUAL(db_garbage.get_doclength(did), len);
+	} else {
+	    TEST_EXCEPTION(Xapian::DocNotFoundError, db.get_doclength(did));
+	    TEST_EXCEPTION(Xapian::DocNotFoundError,
+			   db_small.get_doclength(did));
+	    TEST_EXCEPTION(Xapian::DocNotFoundError,
+			   db_negative.get_doclength(did));
+	}
+    }
+    TEST_EQUAL(db.get_doclength(5), 11);
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("foo"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    Xapian::Enquire enq_nocache(db_nocache);
+    enq_nocache.set_query(Xapian::Query("foo"));
+    TEST(mset_range_is_same_weights(mset, 0, enq_nocache.get_mset(0, 10), 0,
+				    2));
+
+    return true;
+}
+
+/// Check boolean filters give the same results with XAPIAN_BITMAP_TERMFREQ.
+DEFINE_TESTCASE(bitmapfilter1, glass) {
+    Xapian::WritableDatabase wdb = get_writable_database();
+    for (Xapian::docid did = 1; did <= 10000; ++did) {
+	// Put the last 1000 documents in a different bitmap chunk.
+	Xapian::docid real_did = did <= 9000 ? did : did + 70000;
+	Xapian::Document doc;
+	doc.add_term("word", did % 7 + 1);
+	if (did % 2 == 0) doc.add_boolean_term("Len");
+	if (did % 3 == 0) doc.add_boolean_term("Lfr");
+	if (did % 5 == 0) doc.add_boolean_term("Sa");
+	if (did % 97 == 0) doc.add_boolean_term("Xrare");
+	wdb.replace_document(real_did, doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db_nocache = get_writable_database_as_database();
+    set_env_var("XAPIAN_BITMAP_TERMFREQ", "1000");
+    Xapian::Database db = get_writable_database_as_database();
+    // With a tiny cache, each bitmap built evicts all the others, including
+    // ones which postlists we're iterating still use.
+    set_env_var("XAPIAN_BITMAP_CACHE_SIZE", "1");
+    Xapian::Database db_tiny = get_writable_database_as_database();
+    set_env_var("XAPIAN_BITMAP_CACHE_SIZE", "");
+    set_env_var("XAPIAN_BITMAP_TERMFREQ", "0");
+
+    Xapian::Query word("word");
+    Xapian::Query en("Len"), fr("Lfr"), sa("Sa"), few("Xrare");
+    vector<Xapian::Query> filters;
+    filters.push_back(en);
+    filters.push_back(Xapian::Query(Xapian::Query::OP_AND, en, sa));
+    filters.push_back(Xapian::Query(Xapian::Query::OP_OR, fr, sa));
+    filters.push_back(Xapian::Query(Xapian::Query::OP_AND_NOT, en, fr));
+    // Xrare is too rare to be a bitmap, so only some operands are.
+    filters.push_back(Xapian::Query(Xapian::Query::OP_AND,
+				    Xapian::Query(Xapian::Query::OP_OR, en, fr),
+				    few));
+    filters.push_back(Xapian::Query(Xapian::Query::OP_AND_NOT, few, en));
+
+    Xapian::Enquire enq(db);
+    Xapian::Enquire enq_tiny(db_tiny);
+    Xapian::Enquire enq_nocache(db_nocache);
+    for (const Xapian::Query & filter : filters) {
+	vector<Xapian::Query> queries;
+	queries.push_back(Xapian::Query(Xapian::Query::OP_FILTER,
+					word, filter));
+	// A purely boolean query.
+	queries.push_back(Xapian::Query(Xapian::Query::OP_SCALE_WEIGHT,
+					filter, 0.0));
+	for (const Xapian::Query & q : queries) {
+	    tout << q.get_description() << '\n';
+	    enq.set_query(q);
+	    enq_tiny.set_query(q);
+	    enq_nocache.set_query(q);
+	    Xapian::MSet mset = enq.get_mset(0, 10000);
+	    Xapian::MSet mset_tiny = enq_tiny.get_mset(0, 10000);
+	    Xapian::MSet mset_nocache = enq_nocache.get_mset(0, 10000);
+	    TEST_EQUAL(mset.size(), mset_nocache.size());
+	    TEST(mset_range_is_same(mset, 0, mset_nocache, 0, mset.size()));
+	    TEST_EQUAL(mset_tiny.size(), mset_nocache.size());
+	    TEST(mset_range_is_same(mset_tiny, 0, mset_nocache, 0,
+				    mset_tiny.size()));
+	}
+    }
+
+    return true;
+}
+
 /// Regression test for bug starting a new glass freelist block.
 DEFINE_TESTCASE(newfreelistblock1, writable) {
     Xapian::Document doc;
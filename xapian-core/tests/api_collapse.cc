@@ -25,6 +25,7 @@
 #include <xapian.h>
 
 #include "apitest.h"
+#include "str.h"
 #include "testutils.h"
 
 using namespace std;
@@ -81,3 +82,39 @@ DEFINE_TESTCASE(collapsekey5, backend) {
 
     return true;
 }
+
+static void
+make_collapsekey6_db(Xapian::WritableDatabase &db, const string &)
+{
+    // Enough distinct collapse key values that the collapser will evict
+    // entries which can't make it into the MSet.
+    for (int i = 0; i != 6000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("T");
+	doc.add_value(0, str(i % 3000));
+	db.add_document(doc);
+    }
+}
+
+/// Test collapsing on a slot with many distinct values.
+DEFINE_TESTCASE(collapsekey6, generated) {
+    Xapian::Database db = get_database("collapsekey6", make_collapsekey6_db);
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("T"));
+    enquire.set_weighting_scheme(Xapian::BoolWeight());
+    enquire.set_collapse_key(0);
+
+    Xapian::MSet mset = enquire.get_mset(0, 10, db.get_doccount());
+    TEST_EQUAL(mset.size(), 10);
+    Xapian::docid did = 1;
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	TEST_EQUAL(*i, did);
+	TEST_EQUAL(i.get_collapse_key(), str(did - 1));
+	TEST_EQUAL(i.get_collapse_count(), 1);
+	++did;
+    }
+    TEST_REL(mset.get_matches_lower_bound(),<=,3000);
+    TEST_REL(mset.get_matches_upper_bound(),>=,3000);
+
+    return true;
+}
@@ -494,6 +494,7 @@ DEFINE_TESTCASE(compactmergesynonym1, generated) {
 	TEST_EQUAL(*i, "foo");
 	++i;
 	TEST_EQUAL(i, db.spellings_end());
+	TEST_EQUAL(db.get_spelling_suggestion("baz", 1), "bar");
 
 	i = db.synonym_keys_begin();
 	TEST_NOT_EQUAL(i, db.synonym_keys_end());
@@ -663,3 +664,38 @@ DEFINE_TESTCASE(compactsingle1, glass) {
 
     return true;
 }
+
+/// Check compaction recalculates the per-term wdf upper bound.
+DEFINE_TESTCASE(compactwdfbound1, glass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    Xapian::Document doc2;
+    doc2.add_term("foo", 7);
+    Xapian::docid did = db.add_document(doc2);
+    db.commit();
+    db.delete_document(did);
+    db.commit();
+    // The bound isn't lowered by deletion, so it's now loose.
+    TEST_EQUAL(db.get_wdf_upper_bound("foo"), 7);
+
+    string outdbpath = get_named_writable_database_path("compactwdfbound1out");
+    rm_rf(outdbpath);
+    db.compact(outdbpath);
+    Xapian::Database outdb(outdbpath);
+    TEST_EQUAL(outdb.get_wdf_upper_bound("foo"), 1);
+    dbcheck(outdb, 1, 1);
+
+    // Check the multipass code path too.
+    rm_rf(outdbpath);
+    {
+	Xapian::Database in;
+	for (int i = 0; i != 4; ++i) in.add_database(db);
+	in.compact(outdbpath, Xapian::DBCOMPACT_MULTIPASS);
+    }
+    outdb = Xapian::Database(outdbpath);
+    TEST_EQUAL(outdb.get_wdf_upper_bound("foo"), 1);
+
+    return true;
+}
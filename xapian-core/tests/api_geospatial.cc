@@ -25,6 +25,8 @@
 #include "api_geospatial.h"
 #include <xapian.h>
 
+#include <cstdlib>
+
 #include "apitest.h"
 #include "testsuite.h"
 #include "testutils.h"
@@ -267,6 +269,109 @@ DEFINE_TESTCASE(latlongpostingsource1, backend && writable && !remote && !inmemo
     return true;
 }
 
+static void
+builddb_coords2(Xapian::WritableDatabase &db, const string &)
+{
+    Xapian::LatLongGrid grid("XG", 2, 16);
+    // A spread of points, including ones near the poles and either side of
+    // the 180th meridian, plus a dense cluster around (51.5, -0.1).
+    for (int lat = -89; lat <= 89; lat += 7) {
+	for (int lon = -180; lon < 180; lon += 11) {
+	    Xapian::LatLongCoords coords(Xapian::LatLongCoord(lat, lon + 0.5));
+	    Xapian::Document doc;
+	    doc.add_value(0, coords.serialise());
+	    grid.index(doc, coords);
+	    db.add_document(doc);
+	}
+    }
+    for (int i = 0; i != 400; ++i) {
+	double lat = 51.5 + ((i * 37) % 101 - 50) * 0.001;
+	double lon = -0.1 + ((i * 53) % 103 - 51) * 0.002;
+	Xapian::LatLongCoords coords(Xapian::LatLongCoord(lat, lon));
+	Xapian::Document doc;
+	doc.add_value(0, coords.serialise());
+	grid.index(doc, coords);
+	db.add_document(doc);
+    }
+}
+
+/// Test that filtering by LatLongGrid's cover query doesn't change results.
+DEFINE_TESTCASE(latlonggrid1, generated) {
+    Xapian::Database db = get_database("coords2", builddb_coords2, "");
+    Xapian::LatLongGrid grid("XG", 2, 16);
+    Xapian::Enquire enq(db);
+
+    static const struct { double lat, lon, range; } tests[] = {
+	{ 51.5, -0.1, 300 },
+	{ 51.5, -0.1, 1000 },
+	{ 51.5, -0.1, 5000 },
+	{ 51.5, 359.9, 5000 },
+	{ 0, 0, 1000000 },
+	{ 10, 179.9, 2000000 },
+	{ -85, 30, 1500000 },
+	{ 88, 200, 500000 },
+	{ 40, -100, 15000000 },
+	{ 40, -100, 25000000 },
+    };
+    for (auto & t : tests) {
+	Xapian::LatLongCoords centre(Xapian::LatLongCoord(t.lat, t.lon));
+	Xapian::LatLongDistancePostingSource ps(0, centre, t.range);
+	enq.set_query(Xapian::Query(&ps));
+	Xapian::MSet mset1 = enq.get_mset(0, db.get_doccount());
+
+	Xapian::Query cover = grid.get_cover_query(centre, t.range);
+	enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				    Xapian::Query(&ps), cover));
+	Xapian::MSet mset2 = enq.get_mset(0, db.get_doccount());
+	tout << centre.get_description() << " " << t.range << ": "
+	     << mset1.size() << " " << cover.get_length() << endl;
+	TEST_EQUAL(mset1.size(), mset2.size());
+	TEST(mset1.empty() ||
+	     mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+    }
+
+    // Two centres, one each side of the 180th meridian.
+    Xapian::LatLongCoords centre;
+    centre.append(Xapian::LatLongCoord(-5, 179));
+    centre.append(Xapian::LatLongCoord(5, -179));
+    Xapian::LatLongDistancePostingSource ps(0, centre, 800000);
+    enq.set_query(Xapian::Query(&ps));
+    Xapian::MSet mset1 = enq.get_mset(0, db.get_doccount());
+    TEST(!mset1.empty());
+    enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				Xapian::Query(&ps),
+				grid.get_cover_query(centre, 800000)));
+    Xapian::MSet mset2 = enq.get_mset(0, db.get_doccount());
+    TEST_EQUAL(mset1.size(), mset2.size());
+    TEST(mset_range_is_same(mset1, 0, mset2, 0, mset1.size()));
+
+    // A range of 0 means no restriction.
+    TEST(grid.get_cover_query(centre, 0).get_type() ==
+	 Xapian::Query::LEAF_MATCH_ALL);
+
+    // The cell terms for a point are nested: each cell number is that of
+    // the enclosing cell one level up followed by two more bits.
+    Xapian::LatLongCoord coord(51.5, -0.1);
+    TEST_EQUAL(grid.get_cell_term(coord, 0), "XGa");
+    unsigned long long prev = 0;
+    for (unsigned level = 1; level <= 25; ++level) {
+	string term = grid.get_cell_term(coord, level);
+	TEST_EQUAL(term.substr(0, 2), "XG");
+	TEST_EQUAL(term[2], char('a' + level));
+	TEST_EQUAL(term.size(), 3 + (level + 1) / 2);
+	unsigned long long cell = strtoull(term.c_str() + 3, NULL, 16);
+	TEST_EQUAL(cell >> 2, prev);
+	prev = cell;
+    }
+
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::LatLongGrid("XG", 0, 26));
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   Xapian::LatLongGrid("XG", 5, 4));
+
+    return true;
+}
+
 // Test various methods of LatLongCoord and LatLongCoords
 DEFINE_TESTCASE(latlongcoords1, !backend) {
     LatLongCoord c1(0, 0);
@@ -390,6 +495,34 @@ DEFINE_TESTCASE(latlongmetric2, !backend) {
     double d1_str = m1(cl1, c2_str);
     TEST_EQUAL(d1, d1_str);
 
+    // Check lists long enough to be handled in several batches.
+    LatLongCoords many;
+    vector<LatLongCoord> many_vec;
+    for (int i = 0; i != 40; ++i) {
+	LatLongCoord c(80 - i * 4, i * 9);
+	many.append(c);
+	many_vec.push_back(c);
+    }
+    LatLongCoords centres;
+    centres.append(LatLongCoord(-5, 300));
+    centres.append(LatLongCoord(-75, 340));
+    double best = 0.0;
+    for (auto && c : many_vec) {
+	for (auto i = centres.begin(); i != centres.end(); ++i) {
+	    double d = m1.pointwise_distance(*i, c);
+	    if (best == 0.0 || d < best) best = d;
+	}
+    }
+    TEST_EQUAL_DOUBLE(m1(centres, many), best);
+    TEST_EQUAL_DOUBLE(m1(centres, many.serialise()), best);
+
+    // The batch form should agree with pointwise_distance().
+    vector<double> dists(many_vec.size());
+    m1.pointwise_distances(c1, &many_vec[0], many_vec.size(), &dists[0]);
+    for (size_t i = 0; i != many_vec.size(); ++i) {
+	TEST_EQUAL_DOUBLE(dists[i], m1.pointwise_distance(c1, many_vec[i]));
+    }
+
     return true;
 }
 
@@ -172,6 +172,116 @@ DEFINE_TESTCASE(matchspy2, generated)
     return true;
 }
 
+/// Check counts are right when a ValueCountMatchSpy is reused across matches.
+DEFINE_TESTCASE(matchspy7, generated)
+{
+    Xapian::Database db = get_database("matchspy2", make_matchspy2_db);
+
+    Xapian::ValueCountMatchSpy spy1(1);
+    Xapian::ValueCountMatchSpy spy2(2);
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("XFACT5"));
+    enq.add_matchspy(&spy1);
+    enq.add_matchspy(&spy2);
+    enq.get_mset(0, 10, db.get_doccount());
+
+    TEST_EQUAL(spy1.get_total(), 5);
+    TEST_STRINGS_EQUAL(values_to_repr(spy1), "|0:2|5:3|");
+    TEST_STRINGS_EQUAL(values_to_repr(spy2), "|fish:5|");
+
+    // Counts from a second match should be added to those already folded in.
+    enq.set_query(Xapian::Query("XFACT2"));
+    enq.get_mset(0, 10, db.get_doccount());
+
+    TEST_EQUAL(spy1.get_total(), 17);
+    TEST_STRINGS_EQUAL(values_to_repr(spy1),
+		       "|0:4|2:3|4:3|5:3|6:2|8:2|");
+    TEST_STRINGS_EQUAL(values_to_repr(spy2), "|fish:17|");
+    TEST_EQUAL(spy2.get_description(),
+	       "ValueCountMatchSpy(17 docs seen, looking in 1 slots)");
+
+    return true;
+}
+
+/// Check ValueCountMatchSpy estimates when sampling.
+DEFINE_TESTCASE(matchspy8, generated)
+{
+    Xapian::Database db = get_database("matchspy2", make_matchspy2_db);
+
+    Xapian::ValueCountMatchSpy spy2(2);
+    Xapian::ValueCountMatchSpy spy3(3);
+    spy2.set_sampling(5, 2);
+    spy3.set_sampling(5, 2);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, spy3.set_sampling(0, 0));
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query("all"));
+    enq.add_matchspy(&spy2);
+    enq.add_matchspy(&spy3);
+    Xapian::MSet mset = enq.get_mset(0, 10, db.get_doccount());
+
+    TEST_EQUAL(spy3.get_total(), 25);
+    // The first 5, then every other document after that.
+    TEST_EQUAL(spy3.get_sampled(), 15);
+    TEST_STRINGS_EQUAL(values_to_repr(spy3), "|1:7|2:8|");
+
+    // Slot 2 has the same value in every document, so the estimate should be
+    // exact.
+    TEST_EQUAL(spy2.get_value_freq_lower_bound("fish"), 15);
+    TEST_EQUAL(spy2.get_value_freq_estimated("fish", mset), 25);
+    TEST_EQUAL(spy2.get_value_freq_upper_bound("fish", mset), 25);
+
+    TEST_EQUAL(spy3.get_value_freq_lower_bound("1"), 7);
+    TEST_EQUAL(spy3.get_value_freq_estimated("1", mset), 12);
+    TEST_EQUAL(spy3.get_value_freq_upper_bound("1", mset), 17);
+    TEST_EQUAL(spy3.get_value_freq_lower_bound("2"), 8);
+    TEST_EQUAL(spy3.get_value_freq_estimated("2", mset), 13);
+    TEST_EQUAL(spy3.get_value_freq_upper_bound("2", mset), 18);
+
+    TEST_EQUAL(spy3.get_value_freq_lower_bound("3"), 0);
+    TEST_EQUAL(spy3.get_value_freq_estimated("3", mset), 0);
+    TEST_EQUAL(spy3.get_value_freq_upper_bound("3", mset), 10);
+
+    return true;
+}
+
+/// Check ValueCountMatchSpy sampling works with every backend.
+DEFINE_TESTCASE(matchspy9, backend)
+{
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("this"));
+
+    Xapian::ValueCountMatchSpy spy(1);
+    spy.set_sampling(2, 2);
+    enquire.add_matchspy(&spy);
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 6);
+
+    TEST_EQUAL(spy.get_total(), 6);
+    TEST_EQUAL(spy.get_sampled(), 4);
+
+    Xapian::doccount counted = 0, estimated = 0;
+    for (Xapian::TermIterator i = spy.values_begin();
+	 i != spy.values_end(); ++i) {
+	Xapian::doccount lb = spy.get_value_freq_lower_bound(*i);
+	Xapian::doccount est = spy.get_value_freq_estimated(*i, mset);
+	Xapian::doccount ub = spy.get_value_freq_upper_bound(*i, mset);
+	TEST_EQUAL(lb, i.get_termfreq());
+	TEST_REL(lb,<=,est);
+	TEST_REL(est,<=,ub);
+	TEST_EQUAL(ub, lb + 2);
+	counted += lb;
+	estimated += est;
+    }
+    TEST_EQUAL(counted, 4);
+    TEST_REL(estimated,>=,5);
+    TEST_REL(estimated,<=,7);
+
+    return true;
+}
+
 DEFINE_TESTCASE(matchspy4, generated)
 {
     Xapian::Database db = get_database("matchspy2", make_matchspy2_db);
@@ -766,3 +766,161 @@ DEFINE_TESTCASE(postingsourceclone1, !backend)
 
     return true;
 }
+
+/// PostingSource matching odd docids, which underestimates its termfreq and
+/// counts how often it is advanced with next().
+class CountNextPostingSource : public Xapian::PostingSource {
+    Xapian::doccount num_docs;
+
+    Xapian::docid last_docid;
+
+    Xapian::docid did;
+
+    int& next_count;
+
+  public:
+    CountNextPostingSource(Xapian::doccount num_docs_,
+			   Xapian::docid last_docid_,
+			   int& next_count_)
+	: num_docs(num_docs_), last_docid(last_docid_), did(0),
+	  next_count(next_count_)
+    { }
+
+    PostingSource * clone() const {
+	return new CountNextPostingSource(num_docs, last_docid, next_count);
+    }
+
+    void init(const Xapian::Database &) { did = 0; }
+
+    Xapian::doccount get_termfreq_min() const { return 0; }
+
+    Xapian::doccount get_termfreq_est() const { return 1; }
+
+    Xapian::doccount get_termfreq_max() const { return num_docs; }
+
+    void next(double) {
+	++next_count;
+	++did;
+	if (did % 2 == 0) ++did;
+    }
+
+    void skip_to(Xapian::docid to_did, double) {
+	did = to_did;
+	if (did % 2 == 0) ++did;
+    }
+
+    bool at_end() const { return did > last_docid; }
+
+    Xapian::docid get_docid() const { return did; }
+
+    string get_description() const { return "CountNextPostingSource"; }
+};
+
+/// ValuePostingSource matching odd docids, which underestimates its termfreq
+/// and counts how often it is advanced with next().
+class CountNextValuePostingSource : public Xapian::ValuePostingSource {
+    Xapian::doccount num_docs;
+
+    Xapian::docid last_docid;
+
+    Xapian::docid did;
+
+    int& next_count;
+
+  public:
+    CountNextValuePostingSource(Xapian::doccount num_docs_,
+				Xapian::docid last_docid_,
+				int& next_count_)
+	: Xapian::ValuePostingSource(0),
+	  num_docs(num_docs_), last_docid(last_docid_), did(0),
+	  next_count(next_count_)
+    { }
+
+    PostingSource * clone() const {
+	return new CountNextValuePostingSource(num_docs, last_docid,
+					       next_count);
+    }
+
+    void init(const Xapian::Database &) { did = 0; }
+
+    Xapian::doccount get_termfreq_min() const { return 0; }
+
+    Xapian::doccount get_termfreq_est() const { return 1; }
+
+    Xapian::doccount get_termfreq_max() const { return num_docs; }
+
+    void next(double) {
+	++next_count;
+	++did;
+	if (did % 2 == 0) ++did;
+    }
+
+    void skip_to(Xapian::docid to_did, double) {
+	did = to_did;
+	if (did % 2 == 0) ++did;
+    }
+
+    bool check(Xapian::docid to_did, double min_wt) {
+	skip_to(to_did, min_wt);
+	return true;
+    }
+
+    bool at_end() const { return did > last_docid; }
+
+    Xapian::docid get_docid() const { return did; }
+
+    string get_description() const { return "CountNextValuePostingSource"; }
+};
+
+/// Check a ValuePostingSource, which has to scan, isn't used to drive an AND.
+DEFINE_TESTCASE(externalsource5, backend && !remote && !multi) {
+    // Doesn't work for remote without registering with the server.
+    // Doesn't work for multi because it checks the docid in the
+    // subdatabase.
+    Xapian::Database db(get_database("apitest_phrase"));
+    Xapian::Enquire enq(db);
+    int next_count = 0;
+    CountNextValuePostingSource src(db.get_doccount(), db.get_lastdocid(),
+				    next_count);
+
+    // The source claims to be rarer than "leav", but has to look at every
+    // value in its slot to find its matches, so "leav" should drive the AND
+    // and the source should never need next() calling.
+    TEST_REL(db.get_termfreq("leav"),>,1);
+    Xapian::Query q(Xapian::Query::OP_FILTER,
+		    Xapian::Query("leav"),
+		    Xapian::Query(&src));
+    enq.set_query(q);
+
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    mset_expect_order(mset, 5, 7, 11, 13, 9);
+    TEST_EQUAL(next_count, 0);
+
+    return true;
+}
+
+/// Check other PostingSource subclasses are costed by their termfreq.
+DEFINE_TESTCASE(externalsource6, backend && !remote && !multi) {
+    // Doesn't work for remote without registering with the server.
+    // Doesn't work for multi because it checks the docid in the
+    // subdatabase.
+    Xapian::Database db(get_database("apitest_phrase"));
+    Xapian::Enquire enq(db);
+    int next_count = 0;
+    CountNextPostingSource src(db.get_doccount(), db.get_lastdocid(),
+			       next_count);
+
+    // We don't know how the source finds its matches, so we take its
+    // termfreq estimate as the cost, and it should drive the AND.
+    TEST_REL(db.get_termfreq("leav"),>,1);
+    Xapian::Query q(Xapian::Query::OP_FILTER,
+		    Xapian::Query("leav"),
+		    Xapian::Query(&src));
+    enq.set_query(q);
+
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    mset_expect_order(mset, 5, 7, 11, 13, 9);
+    TEST_REL(next_count,>,0);
+
+    return true;
+}
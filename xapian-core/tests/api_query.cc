@@ -25,6 +25,10 @@
 
 #include <xapian.h>
 
+#include <set>
+#include <vector>
+
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 
@@ -658,3 +662,346 @@ DEFINE_TESTCASE(subdbwithoutpos1, generated) {
 
     return true;
 }
+
+static void
+gen_andadaptive1_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid i = 1; i <= 6000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (i % 2 == 0) doc.add_term("two");
+	if (i % 3 == 0) doc.add_term("three");
+	if (i % 7 == 0) doc.add_term("seven");
+	doc.add_value(0, i % 97 == 0 ? "y" : "n");
+	db.add_document(doc);
+    }
+}
+
+/// Check that the matches found are those with docids which are multiples
+/// of @a n.
+static void
+check_multiples(Xapian::Enquire& enq, Xapian::docid n)
+{
+    Xapian::MSet mset = enq.get_mset(0, 6000);
+    TEST_EQUAL(mset.size(), 6000 / n);
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	TEST_EQUAL(*i % n, 0);
+    }
+}
+
+/// Check ANDs are right when MultiAndPostList adapts to its sublists.
+DEFINE_TESTCASE(andadaptive1, generated) {
+    Xapian::Database db = get_database("andadaptive1", gen_andadaptive1_db);
+    Xapian::Enquire enq(db);
+
+    // "all" never rejects a candidate, and so should end up being asked
+    // last.
+    vector<Xapian::Query> subqs;
+    subqs.push_back(Xapian::Query("all"));
+    subqs.push_back(Xapian::Query("seven"));
+    subqs.push_back(Xapian::Query("two"));
+    subqs.push_back(Xapian::Query("three"));
+    enq.set_query(Xapian::Query(Xapian::Query::OP_AND,
+				subqs.begin(), subqs.end()));
+    check_multiples(enq, 42);
+
+    // The value range is rare, but has to scan every value so shouldn't
+    // drive the AND.  It rejects almost every candidate, but skip_to() would
+    // have to scan too, so it should stay using check().
+    enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				Xapian::Query(Xapian::Query::OP_AND,
+					      Xapian::Query("all"),
+					      Xapian::Query("two")),
+				Xapian::Query(Xapian::Query::OP_VALUE_RANGE,
+					      0, "y", "y")));
+    check_multiples(enq, 194);
+
+    subqs.clear();
+    subqs.push_back(Xapian::Query("three"));
+    subqs.push_back(Xapian::Query(Xapian::Query::OP_VALUE_RANGE, 0, "y", "y"));
+    subqs.push_back(Xapian::Query("two"));
+    subqs.push_back(Xapian::Query("all"));
+    enq.set_query(Xapian::Query(Xapian::Query::OP_AND,
+				subqs.begin(), subqs.end()));
+    check_multiples(enq, 582);
+
+    return true;
+}
+
+/// ValuePostingSource which counts how it is advanced.
+class AndAdaptiveSource : public Xapian::ValuePostingSource {
+    bool dense;
+
+    Xapian::docid last_docid;
+
+    Xapian::doccount tf;
+
+    Xapian::docid did;
+
+    Xapian::doccount& check_count;
+
+    Xapian::doccount& skip_to_count;
+
+    bool matches(Xapian::docid d) const {
+	// Either multiples of 291 (3 * 97), or those and everything which
+	// isn't a multiple of 3.
+	return d % 291 == 0 || (dense && d % 3 != 0);
+    }
+
+    void advance_to(Xapian::docid d) {
+	did = d;
+	while (did <= last_docid && !matches(did)) ++did;
+    }
+
+  public:
+    AndAdaptiveSource(bool dense_, Xapian::docid last_docid_,
+		      Xapian::doccount& check_count_,
+		      Xapian::doccount& skip_to_count_)
+	: Xapian::ValuePostingSource(0), dense(dense_),
+	  last_docid(last_docid_), tf(0), did(0),
+	  check_count(check_count_), skip_to_count(skip_to_count_)
+    {
+	for (Xapian::docid d = 1; d <= last_docid; ++d) {
+	    if (matches(d)) ++tf;
+	}
+    }
+
+    PostingSource * clone() const {
+	return new AndAdaptiveSource(dense, last_docid,
+				     check_count, skip_to_count);
+    }
+
+    void init(const Xapian::Database &) { did = 0; }
+
+    Xapian::doccount get_termfreq_min() const { return tf; }
+
+    Xapian::doccount get_termfreq_est() const { return tf; }
+
+    Xapian::doccount get_termfreq_max() const { return last_docid; }
+
+    void next(double) { advance_to(did + 1); }
+
+    void skip_to(Xapian::docid to_did, double) {
+	++skip_to_count;
+	if (to_did > did) advance_to(to_did);
+    }
+
+    bool check(Xapian::docid to_did, double) {
+	++check_count;
+	did = to_did;
+	return matches(did);
+    }
+
+    bool at_end() const { return did > last_docid; }
+
+    Xapian::docid get_docid() const { return did; }
+
+    string get_description() const { return "AndAdaptiveSource"; }
+};
+
+/// Check MultiAndPostList only switches to skip_to() when it's cheap.
+DEFINE_TESTCASE(andadaptive2, generated && !remote && !multi) {
+    // Doesn't work for remote without registering with the server.
+    // Doesn't work for multi because it checks the docid in the
+    // subdatabase.
+    Xapian::Database db = get_database("andadaptive1", gen_andadaptive1_db);
+    Xapian::Enquire enq(db);
+
+    // Both sources reject all but one in 97 of the documents "three"
+    // offers them, and cost more to iterate than "three", so "three" drives
+    // the AND.  The dense source matches most of the documents it has to
+    // look at, so skip_to() is cheap and we should switch to it.
+    Xapian::doccount check_count = 0, skip_to_count = 0;
+    AndAdaptiveSource dense_src(true, db.get_lastdocid(),
+				check_count, skip_to_count);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_AND,
+				Xapian::Query("three"),
+				Xapian::Query(&dense_src)));
+    check_multiples(enq, 291);
+    TEST_REL(check_count,>,0U);
+    TEST_REL(skip_to_count,>,0U);
+
+    // The sparse source would have to look at every value in its slot to
+    // find the next match, so we should stick with check().
+    check_count = skip_to_count = 0;
+    AndAdaptiveSource sparse_src(false, db.get_lastdocid(),
+				 check_count, skip_to_count);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_AND,
+				Xapian::Query("three"),
+				Xapian::Query(&sparse_src)));
+    check_multiples(enq, 291);
+    TEST_EQUAL(check_count, db.get_termfreq("three"));
+    TEST_EQUAL(skip_to_count, 0U);
+
+    return true;
+}
+
+static const Xapian::termcount multior1_primes[] = { 2, 3, 5, 7, 11 };
+
+static void
+gen_multior1_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid i = 1; i <= 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (i % 13 == 0) doc.add_term("thirteen");
+	for (Xapian::termcount p : multior1_primes) {
+	    // Use the prime as the wdf so we can check the wdf of a synonym.
+	    if (i % p == 0) doc.add_term("m" + str(p), p);
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Return the sum of the primes in multior1_primes which divide @a did.
+static Xapian::termcount
+multior1_wdf(Xapian::docid did)
+{
+    Xapian::termcount wdf = 0;
+    for (Xapian::termcount p : multior1_primes) {
+	if (did % p == 0) wdf += p;
+    }
+    return wdf;
+}
+
+/// Check the matches are exactly the documents for which @a pred is true.
+template<class P>
+static void
+check_matches(Xapian::Enquire& enq, P pred)
+{
+    Xapian::MSet mset = enq.get_mset(0, 1000);
+    set<Xapian::docid> matches(mset.begin(), mset.end());
+    for (Xapian::docid i = 1; i <= 1000; ++i) {
+	TEST_EQUAL(matches.count(i), pred(i));
+    }
+}
+
+/// Check wide ORs which are combined with MultiOrPostList.
+DEFINE_TESTCASE(multior1, generated) {
+    Xapian::Database db = get_database("multior1", gen_multior1_db);
+    Xapian::Enquire enq(db);
+
+    vector<Xapian::Query> subqs;
+    for (Xapian::termcount p : multior1_primes) {
+	subqs.push_back(Xapian::Query("m" + str(p)));
+    }
+    Xapian::Query q_or(Xapian::Query::OP_OR, subqs.begin(), subqs.end());
+    auto has_factor = [](Xapian::docid did) {
+	return multior1_wdf(did) != 0;
+    };
+
+    // A boolean filter, driven by next().
+    enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				Xapian::Query("all"), q_or));
+    check_matches(enq, has_factor);
+
+    // A boolean filter, driven by skip_to().
+    enq.set_query(Xapian::Query(Xapian::Query::OP_FILTER,
+				Xapian::Query("thirteen"), q_or));
+    check_matches(enq, [&](Xapian::docid did) {
+	return did % 13 == 0 && has_factor(did);
+    });
+
+    // The right side of AND_NOT.
+    enq.set_query(Xapian::Query(Xapian::Query::OP_AND_NOT,
+				Xapian::Query("all"), q_or));
+    check_matches(enq, [&](Xapian::docid did) { return !has_factor(did); });
+
+    // A synonym should get the sum of the wdfs of the matching terms, which
+    // with "nnn" is the weight.
+    enq.set_weighting_scheme(Xapian::TfIdfWeight("nnn"));
+    Xapian::Query q_syn(Xapian::Query::OP_SYNONYM, subqs.begin(), subqs.end());
+    Xapian::Query q_wild(Xapian::Query::OP_WILDCARD, "m",
+			 0, Xapian::Query::WILDCARD_LIMIT_ERROR,
+			 Xapian::Query::OP_SYNONYM);
+    for (const Xapian::Query& q : { q_syn, q_wild }) {
+	tout << q.get_description() << '\n';
+	enq.set_query(q);
+	Xapian::MSet mset = enq.get_mset(0, 1000);
+	TEST_EQUAL(mset.size(), 793);
+	for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	    TEST_EQUAL_DOUBLE(i.get_weight(), multior1_wdf(*i));
+	}
+    }
+
+    return true;
+}
+
+static void
+gen_blockor1_db(Xapian::WritableDatabase& db, const string&)
+{
+    for (Xapian::docid i = 1; i <= 5000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("filler", i % 7 + 1);
+	// Leave a gap which no term matches, and then a sparse stretch, to
+	// check we skip over them.
+	if (i <= 3000) {
+	    if (i % 2 == 0) doc.add_term("two", i % 3 + 1);
+	    if (i % 2 == 1) doc.add_term("odd", i % 3 + 1);
+	    if (i % 3 == 0) doc.add_term("three", i % 5 + 1);
+	    if (i % 5 == 0) doc.add_term("five");
+	} else if (i > 4000 && i % 300 == 1) {
+	    doc.add_term("rare");
+	}
+	db.add_document(doc);
+    }
+}
+
+/// Check a short OR at the root of the query, which uses BlockOrPostList.
+DEFINE_TESTCASE(blockor1, generated) {
+    Xapian::Database db = get_database("blockor1", gen_blockor1_db);
+    Xapian::Enquire enq(db);
+
+    // The subqueries of the first OR have similar maxweights, so it uses a
+    // BlockOrPostList.  "rare" has a much higher maxweight than the others,
+    // so the second OR only uses a BlockOrPostList when the matcher has to
+    // check every match, since otherwise it's better to let the OR decay to
+    // AND_MAYBE once w_min exceeds the maxweights of the others.
+    Xapian::Query q_close(Xapian::Query::OP_OR,
+			  Xapian::Query("two"), Xapian::Query("odd"));
+    vector<Xapian::Query> subqs;
+    subqs.push_back(Xapian::Query("two"));
+    subqs.push_back(Xapian::Query("three"));
+    subqs.push_back(Xapian::Query("five"));
+    subqs.push_back(Xapian::Query("rare"));
+    Xapian::Query q_spread(Xapian::Query::OP_OR, subqs.begin(), subqs.end());
+
+    for (int spread = 0; spread != 2; ++spread) {
+	const Xapian::Query& q = spread ? q_spread : q_close;
+	// Under OP_SCALE_WEIGHT the OR isn't the root, so this gives the same
+	// results using a tree of OrPostList objects.
+	Xapian::Query q_tree(Xapian::Query::OP_SCALE_WEIGHT, q, 1.0);
+
+	// The second scheme has a term-independent weight, which means
+	// BlockOrPostList::get_doclength() gets called.
+	enq.set_weighting_scheme(Xapian::BM25Weight());
+	for (int with_extra = 0; with_extra != 2; ++with_extra) {
+	    if (with_extra)
+		enq.set_weighting_scheme(Xapian::BM25Weight(1, 0.5, 1, 0.5,
+							    0.5));
+	    // Check all the matches, just the top few (where the matcher
+	    // passes a non-zero w_min which allows candidates to be skipped),
+	    // and the top few when checking all matches.
+	    for (int c = 0; c != 3; ++c) {
+		Xapian::doccount n = (c == 0 ? 5000 : 10);
+		Xapian::doccount check_at_least = (c == 2 ? 5000 : 0);
+		enq.set_query(q);
+		Xapian::MSet mset = enq.get_mset(0, n, check_at_least);
+		enq.set_query(q_tree);
+		Xapian::MSet mset_tree = enq.get_mset(0, n, check_at_least);
+		TEST_EQUAL(mset.size(), mset_tree.size());
+		if (n > 10) TEST_EQUAL(mset.size(), spread ? 2203 : 3000);
+		Xapian::MSetIterator i = mset.begin();
+		Xapian::MSetIterator j = mset_tree.begin();
+		while (i != mset.end()) {
+		    TEST_EQUAL_DOUBLE(i.get_weight(), j.get_weight());
+		    TEST_EQUAL(i.get_percent(), j.get_percent());
+		    ++i;
+		    ++j;
+		}
+	    }
+	}
+    }
+
+    return true;
+}
@@ -2967,3 +2967,20 @@ DEFINE_TESTCASE(qp_defaultstrategysome1, !backend) {
     TEST_EQUAL(qp.parse_query("testing").get_description(), "Query(Ztest@1)");
     return true;
 }
+
+/// Test QueryParser with a CJK word segmenter.
+DEFINE_TESTCASE(qp_segmenter1, !backend) {
+    Xapian::DictionaryWordSegmenter seg;
+    seg.add("北京");
+    seg.add("大学");
+    Xapian::QueryParser qp;
+    qp.add_prefix("title", "XT");
+    qp.set_segmenter(&seg);
+    TEST_STRINGS_EQUAL(qp.parse_query("北京大学").get_description(),
+		       "Query((北京@1 AND 大学@1))");
+    TEST_STRINGS_EQUAL(qp.parse_query("title:北京 大学生").get_description(),
+		       "Query((XT北京@1 OR (大学@2 AND 生@2)))");
+    TEST_STRINGS_EQUAL(qp.parse_query("\"北京大学\"").get_description(),
+		       "Query((北京@1 PHRASE 2 大学@1))");
+    return true;
+}
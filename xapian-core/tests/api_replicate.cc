@@ -30,6 +30,7 @@
 
 #include "apitest.h"
 #include "dbcheck.h"
+#include "envvar.h"
 #include "fd.h"
 #include "filetests.h"
 #include "safedirent.h"
@@ -37,17 +38,27 @@
 #include "safefcntl.h"
 #include "safesysstat.h"
 #include "safeunistd.h"
+#include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
 #include "unixcmds.h"
 
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+# include "net/replicatetcpclient.h"
+# include "net/replicatetcpserver.h"
+#endif
+
 #include <sys/types.h>
+#ifdef HAVE_SOCKETPAIR
+# include "safesyssocket.h"
+# include <signal.h>
+# include "safesyswait.h"
+#endif
 
 #include <cstdlib>
+#include <fstream>
 #include <string>
 
-#include <stdlib.h> // For setenv() or putenv()
-
 using namespace std;
 
 static void rmtmpdir(const string & path) {
@@ -233,28 +244,10 @@ check_equal_dbs(const string & masterpath, const string & replicapath)
     }
 }
 
-#if 0 // Dynamic version which we don't currently need.
 static void
 set_max_changesets(int count) {
-#ifdef HAVE__PUTENV_S
-    _putenv_s("XAPIAN_MAX_CHANGESETS", str(count).c_str());
-#elif defined HAVE_SETENV
-    setenv("XAPIAN_MAX_CHANGESETS", str(count).c_str(), 1);
-#else
-    static char buf[64] = "XAPIAN_MAX_CHANGESETS=";
-    sprintf(buf + CONST_STRLEN("XAPIAN_MAX_CHANGESETS="), "%d", count);
-    putenv(buf);
-#endif
+    set_env_var("XAPIAN_MAX_CHANGESETS", str(count));
 }
-#endif
-
-#ifdef HAVE__PUTENV_S
-# define set_max_changesets(N) _putenv_s("XAPIAN_MAX_CHANGESETS", #N)
-#elif defined HAVE_SETENV
-# define set_max_changesets(N) setenv("XAPIAN_MAX_CHANGESETS", #N, 1)
-#else
-# define set_max_changesets(N) putenv(const_cast<char*>("XAPIAN_MAX_CHANGESETS="#N))
-#endif
 
 struct unset_max_changesets_helper_ {
     unset_max_changesets_helper_() { }
@@ -909,3 +902,486 @@ DEFINE_TESTCASE(replicate7, replicas) {
     rmtmpdir(tempdir);
     return true;
 }
+
+// Test DatabaseMaster::has_changes_since(), which streaming replication uses
+// to decide when there's something to send.
+DEFINE_TESTCASE(replicate8, replicas) {
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::Document doc;
+    doc.add_term("foo");
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    string replicapath = tempdir + "/replica";
+    {
+	Xapian::DatabaseReplica replica(replicapath);
+
+	TEST(master.has_changes_since(string()));
+
+	orig.add_document(doc);
+	orig.commit();
+
+	// The replica is a different database until it has been copied.
+	TEST(master.has_changes_since(replica.get_revision_info()));
+	replicate(master, replica, tempdir, 0, 1, true);
+	TEST(!master.has_changes_since(replica.get_revision_info()));
+
+	orig.add_document(doc);
+	orig.commit();
+	TEST(master.has_changes_since(replica.get_revision_info()));
+
+	// Uncommitted changes shouldn't count.
+	orig.add_document(doc);
+	replicate(master, replica, tempdir, 1, 0, true);
+	TEST(!master.has_changes_since(replica.get_revision_info()));
+
+	orig.commit();
+	TEST(master.has_changes_since(replica.get_revision_info()));
+	replicate(master, replica, tempdir, 1, 0, true);
+	TEST(!master.has_changes_since(replica.get_revision_info()));
+
+	// We need this inner scope to we close the replica before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+    return true;
+}
+
+// Write a full copy of the master, as a delta against basis if non-empty.
+static off_t
+get_full_copy(const string & changesetpath,
+	      Xapian::DatabaseMaster & master,
+	      const string & basis)
+{
+    {
+	FD fd(open(changesetpath.c_str(),
+		   O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666));
+	if (fd == -1) {
+	    FAIL_TEST("Open failed (when creating a new changeset file at '"
+		      << changesetpath << "')");
+	}
+	Xapian::ReplicationInfo info;
+	master.write_changesets_to_fd(fd, string(), &info, basis);
+	TEST_EQUAL(info.fullcopy_count, 1);
+    }
+    return get_file_size(changesetpath);
+}
+
+// Test full copies sent as deltas, and resuming an interrupted copy.
+DEFINE_TESTCASE(replicate9, replicas) {
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    string replicapath = tempdir + "/replica";
+    string changesetpath = tempdir + "/changeset";
+    string brokenpath = tempdir + "/changeset_broken";
+
+    // Make tables which span a good number of chunks.
+    for (int i = 0; i < 2000; ++i) {
+	Xapian::Document doc;
+	doc.set_data(string(200, 'a' + i % 26) + str(i));
+	doc.add_term("Q" + str(i));
+	doc.add_term("all");
+	orig.add_document(doc);
+    }
+    orig.commit();
+    {
+	Xapian::DatabaseReplica replica(replicapath);
+
+	// There's nothing to reuse yet.
+	TEST_EQUAL(replica.get_copy_basis(), string());
+
+	int count = replicate(master, replica, tempdir, 0, 1, true);
+	TEST_EQUAL(count, 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	// Without an interrupted copy, we only get a basis if we ask for the
+	// live database to be used.
+	TEST_EQUAL(replica.get_copy_basis(), string());
+
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term("changed");
+	orig.replace_document(7, doc);
+	orig.commit();
+
+	off_t full_size = get_full_copy(changesetpath, master, string());
+	off_t delta_size = get_full_copy(changesetpath, master,
+					 replica.get_copy_basis(true));
+	tout << "Full copy " << full_size << " bytes, delta copy "
+	     << delta_size << " bytes\n";
+	TEST_REL(delta_size * 2,<,full_size);
+	apply_changeset(changesetpath, replica, 0, 1, true);
+	check_equal_dbs(masterpath, replicapath);
+
+	// Interrupt a copy part way through.
+	orig.replace_document(8, doc);
+	orig.commit();
+	full_size = get_full_copy(changesetpath, master, string());
+	truncated_copy(changesetpath, brokenpath, full_size * 3 / 4);
+	TEST_EXCEPTION(Xapian::NetworkError,
+		       apply_changeset(brokenpath, replica, 0, 1, true));
+    }
+    {
+	// Resuming should only need the part we didn't receive, even with a
+	// new DatabaseReplica object.
+	Xapian::DatabaseReplica replica(replicapath);
+	string basis = replica.get_copy_basis();
+	TEST(!basis.empty());
+	off_t full_size = get_full_copy(changesetpath, master, string());
+	off_t delta_size = get_full_copy(changesetpath, master, basis);
+	tout << "Full copy " << full_size << " bytes, resumed copy "
+	     << delta_size << " bytes\n";
+	TEST_REL(delta_size * 2,<,full_size);
+	apply_changeset(changesetpath, replica, 0, 1, true);
+	check_equal_dbs(masterpath, replicapath);
+	TEST_EQUAL(replica.get_copy_basis(), string());
+
+	// The chunk checksums only need to spot changed chunks, so the
+	// replica checks each file it builds against a digest of the master's
+	// copy.  Test this by damaging every chunk of the live database's
+	// files after checksumming them.
+	Xapian::Document doc;
+	doc.add_term("all");
+	orig.replace_document(9, doc);
+	orig.commit();
+	(void)get_full_copy(changesetpath, master,
+			    replica.get_copy_basis(true));
+	string livepath = replicapath + "/replica_";
+	{
+	    ifstream stub((replicapath + "/XAPIANDB").c_str());
+	    string line;
+	    while (getline(stub, line)) {
+		if (!line.empty() && line[0] != '#')
+		    livepath += line[line.size() - 1];
+	    }
+	}
+	static const char * const tables[] = {
+	    "docdata.glass", "postlist.glass", "termlist.glass"
+	};
+	for (const char * table : tables) {
+	    string file = livepath + "/" + table;
+	    int fd = open(file.c_str(), O_RDWR | O_BINARY);
+	    TEST(fd != -1);
+	    off_t size = get_file_size(file);
+	    for (off_t pos = 100; pos < size; pos += 8192) {
+		TEST_EQUAL(lseek(fd, pos, SEEK_SET), pos);
+		TEST_EQUAL(write(fd, "!", 1), 1);
+	    }
+	    TEST(close(fd) == 0);
+	}
+	TEST_EXCEPTION(Xapian::NetworkError,
+		       apply_changeset(changesetpath, replica, 0, 1, true));
+
+	// We need this inner scope to we close the replica before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+    return true;
+}
+
+static void
+set_changesets_compress(int on) {
+    set_env_var("XAPIAN_CHANGESETS_COMPRESS", str(on));
+}
+
+struct reset_changesets_compress_helper_ {
+    ~reset_changesets_compress_helper_() { set_changesets_compress(0); }
+};
+
+// Add some documents with compressible data and commit.
+static void
+add_docs_and_commit(Xapian::WritableDatabase & db)
+{
+    for (int i = 0; i < 100; ++i) {
+	Xapian::Document doc;
+	doc.set_data(string(500, 'x') + str(i));
+	doc.add_term("all");
+	db.add_document(doc);
+    }
+    db.commit();
+}
+
+// Return the size of the changeset file for the last commit to db.
+static off_t
+get_last_changeset_size(Xapian::WritableDatabase & db, const string & dbpath)
+{
+    return get_file_size(dbpath + "/changes" + str(db.get_revision() - 1));
+}
+
+// Return the format version of the changeset file for the last commit to db.
+static int
+get_changeset_version(Xapian::WritableDatabase & db, const string & dbpath)
+{
+    string path = dbpath + "/changes" + str(db.get_revision() - 1);
+    ifstream changes(path.c_str(), ios::binary);
+    // The version follows the 12 byte magic string.
+    char header[13];
+    TEST(changes.read(header, sizeof(header)));
+    return static_cast<unsigned char>(header[12]);
+}
+
+// Test replication with compressed and uncompressed changesets.
+DEFINE_TESTCASE(replicate10, replicas) {
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    reset_changesets_compress_helper_ reset_compress;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    string replicapath = tempdir + "/replica";
+    {
+	Xapian::DatabaseReplica replica(replicapath);
+
+	add_docs_and_commit(orig);
+	TEST_EQUAL(replicate(master, replica, tempdir, 0, 1, true), 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	// Compression is off by default, so older replicas can apply the
+	// changesets.  The setting applies to the transaction it's set for.
+	add_docs_and_commit(orig);
+	off_t uncompressed_size = get_last_changeset_size(orig, masterpath);
+	TEST_EQUAL(get_changeset_version(orig, masterpath), 4);
+	set_changesets_compress(1);
+	add_docs_and_commit(orig);
+	off_t compressed_size = get_last_changeset_size(orig, masterpath);
+	TEST_EQUAL(get_changeset_version(orig, masterpath), 5);
+	set_changesets_compress(0);
+
+	// The database check decompresses the changed blocks to check them.
+	TEST_EQUAL(Xapian::Database::check(masterpath, 0, &tout), 0);
+	tout << "Compressed changeset " << compressed_size << " bytes, "
+		"uncompressed changeset " << uncompressed_size << " bytes\n";
+	TEST_REL(compressed_size * 2,<,uncompressed_size);
+
+	// Both forms of changeset should apply.
+	TEST_EQUAL(replicate(master, replica, tempdir, 2, 0, true), 3);
+	check_equal_dbs(masterpath, replicapath);
+
+	// We need this inner scope to we close the replica before we remove
+	// the temporary directory on Windows.
+    }
+
+    rmtmpdir(tempdir);
+    return true;
+}
+
+#if defined XAPIAN_HAS_REMOTE_BACKEND && \
+    defined HAVE_FORK && defined HAVE_SOCKETPAIR
+/// ReplicateTcpServer which serves a connection without forking.
+class SingleReplicateTcpServer : public ReplicateTcpServer {
+  public:
+    explicit SingleReplicateTcpServer(const string & masterdir)
+	: ReplicateTcpServer("127.0.0.1", 0, masterdir) { }
+
+    /** Serve one connection in this process.
+     *
+     *  Unlike run_once(), this doesn't fork a process which calls exit().
+     */
+    void serve_one() {
+	int fd = accept_connection();
+	handle_one_connection(fd);
+	close(fd);
+    }
+};
+
+/** Start a replication server for one connection in a child process.
+ *
+ *  The server listens on a port the OS picks, which the child sends back
+ *  to us.
+ *
+ *  @param masterdir	The directory containing the master database.
+ *  @param port		Set to the port the server is listening on.
+ *
+ *  @return The process id of the child.
+ */
+static pid_t
+start_replicate_server(const string & masterdir, int & port)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, PF_UNSPEC, fds) < 0)
+	FAIL_TEST("socketpair() failed");
+    pid_t child = fork();
+    if (child == -1)
+	FAIL_TEST("fork() failed");
+    if (child == 0) {
+	// Make sure nothing in the child calls exit(), which would run the
+	// test harness's atexit() handlers and flush stdio buffers copied
+	// from the parent.
+	close(fds[1]);
+	try {
+	    SingleReplicateTcpServer server(masterdir);
+	    int server_port = server.get_port();
+	    if (write(fds[0], &server_port, sizeof(server_port)) !=
+		    ssize_t(sizeof(server_port))) {
+		_exit(1);
+	    }
+	    close(fds[0]);
+	    server.serve_one();
+	} catch (...) {
+	    _exit(1);
+	}
+	_exit(0);
+    }
+    close(fds[0]);
+    ssize_t r;
+    while ((r = read(fds[1], &port, sizeof(port))) < 0) {
+	if (errno != EINTR) break;
+    }
+    close(fds[1]);
+    if (r != ssize_t(sizeof(port))) {
+	int status;
+	while (waitpid(child, &status, 0) < 0) {
+	    if (errno != EINTR) FAIL_TEST("waitpid() failed");
+	}
+	FAIL_TEST("Replication server failed to start");
+    }
+    return child;
+}
+
+/// Wait for the server started by start_replicate_server() to exit cleanly.
+static void
+wait_for_replicate_server(pid_t child)
+{
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+	if (errno != EINTR) FAIL_TEST("waitpid() failed");
+    }
+    TEST(WIFEXITED(status));
+    TEST_EQUAL(WEXITSTATUS(status), 0);
+}
+#endif
+
+// Test streaming replication end-to-end over TCP.
+DEFINE_TESTCASE(replicate11, replicas) {
+#if defined XAPIAN_HAS_REMOTE_BACKEND && \
+    defined HAVE_FORK && defined HAVE_SOCKETPAIR
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+    string::size_type slash = masterpath.rfind('/');
+    string masterdir(masterpath, 0, slash);
+    string mastername(masterpath, slash + 1);
+
+    set_max_changesets(10);
+
+    int port;
+    pid_t child = start_replicate_server(masterdir, port);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::Document doc;
+    doc.add_term("foo");
+    orig.add_document(doc);
+    orig.commit();
+
+    string replicapath = tempdir + "/replica";
+    {
+	ReplicateTcpClient client("127.0.0.1", port, 10.0, 10.0);
+	Xapian::ReplicationInfo info;
+
+	// The client sends 'S', and gets a copy of the database followed by
+	// END_OF_CHANGES.
+	client.update_from_master(replicapath, mastername, info, 0.0, false,
+				  true);
+	TEST_EQUAL(info.fullcopy_count, 1);
+	check_equal_dbs(masterpath, replicapath);
+
+	// Each later update acknowledges the revision the replica reached with
+	// 'R', after which the master pushes the next commit.
+	for (int i = 0; i != 2; ++i) {
+	    orig.add_document(doc);
+	    orig.commit();
+	    client.update_from_master(replicapath, mastername, info, 0.0,
+				      false, true);
+	    TEST_EQUAL(info.fullcopy_count, 0);
+	    TEST_EQUAL(info.changeset_count, 1);
+	    TEST(info.changed);
+	    check_equal_dbs(masterpath, replicapath);
+	}
+    }
+
+    // The server should notice the client has gone and exit.
+    wait_for_replicate_server(child);
+
+    rmtmpdir(tempdir);
+    return true;
+#else
+    SKIP_TEST("Test needs the remote backend, fork() and socketpair()");
+#endif
+}
+
+// Test a delta copy over TCP, where the master asks for the checksums.
+DEFINE_TESTCASE(replicate12, replicas) {
+#if defined XAPIAN_HAS_REMOTE_BACKEND && \
+    defined HAVE_FORK && defined HAVE_SOCKETPAIR
+    UNSET_MAX_CHANGESETS_AFTERWARDS;
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+    string::size_type slash = masterpath.rfind('/');
+    string masterdir(masterpath, 0, slash);
+    string mastername(masterpath, slash + 1);
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    for (int i = 0; i < 2000; ++i) {
+	Xapian::Document doc;
+	doc.set_data(string(200, 'a' + i % 26) + str(i));
+	doc.add_term("Q" + str(i));
+	orig.add_document(doc);
+    }
+    orig.commit();
+
+    string replicapath = tempdir + "/replica";
+    for (int i = 0; i != 2; ++i) {
+	// The first time there's nothing to offer checksums of.  The second
+	// time we force a copy and offer the live database's checksums.
+	int port;
+	pid_t child = start_replicate_server(masterdir, port);
+	{
+	    ReplicateTcpClient client("127.0.0.1", port, 10.0, 10.0);
+	    Xapian::ReplicationInfo info;
+	    client.update_from_master(replicapath, mastername, info, 0.0,
+				      i == 1, true, true);
+	    TEST_EQUAL(info.fullcopy_count, 1);
+	    check_equal_dbs(masterpath, replicapath);
+
+	    // The connection should still be in step after the checksums.
+	    Xapian::Document doc;
+	    doc.add_term("new");
+	    orig.add_document(doc);
+	    orig.commit();
+	    client.update_from_master(replicapath, mastername, info, 0.0,
+				      false, true, true);
+	    TEST_EQUAL(info.changeset_count, 1);
+	    check_equal_dbs(masterpath, replicapath);
+	}
+	wait_for_replicate_server(child);
+    }
+
+    rmtmpdir(tempdir);
+    return true;
+#else
+    SKIP_TEST("Test needs the remote backend, fork() and socketpair()");
+#endif
+}
@@ -79,6 +79,28 @@ DEFINE_TESTCASE(snippet1, backend) {
     return true;
 }
 
+/// Test the query analysis is reused correctly between snippet() calls.
+DEFINE_TESTCASE(snippetreuse1, backend) {
+    Xapian::Enquire enquire(get_database("apitest_simpledata"));
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("rubbish"),
+				    Xapian::Query("mention")));
+    Xapian::MSet mset = enquire.get_mset(0, 0);
+
+    // The snippet window adjusts term relevances as it slides, so check
+    // that doesn't leak into later calls.
+    const char * text = "Rubbish mention where the start is better than the "
+			"rubbish ending";
+    for (int i = 0; i != 3; ++i) {
+	TEST_STRINGS_EQUAL(mset.snippet(text, 18),
+			   "<b>Rubbish</b> <b>mention</b>...");
+	TEST_STRINGS_EQUAL(mset.snippet("What a load of rubbish", 12),
+			   "...of <b>rubbish</b>");
+    }
+
+    return true;
+}
+
 /// Test snippets with stemming.
 DEFINE_TESTCASE(snippetstem1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
@@ -213,6 +235,143 @@ DEFINE_TESTCASE(snippetmisc1, generated) {
     return true;
 }
 
+static void
+make_offsets_db(Xapian::WritableDatabase &db, const string &)
+{
+    Xapian::TermGenerator tg;
+    tg.set_stemmer(Xapian::Stem("en"));
+    tg.set_offsets_slot(0);
+    string filler;
+    for (int i = 0; i != 200; ++i) {
+	filler += "Nothing to see here, move along. ";
+    }
+
+    Xapian::Document doc;
+    tg.set_document(doc);
+    string text = filler + "The rubbish examples are at the end. " + filler;
+    tg.index_text(text);
+    doc.set_data(text);
+    db.add_document(doc);
+
+    // Document without stored offsets.
+    tg.set_offsets_slot();
+    doc = Xapian::Document();
+    tg.set_document(doc);
+    text = "Rubbish examples at the start. " + filler;
+    tg.index_text(text);
+    doc.set_data(text);
+    db.add_document(doc);
+}
+
+/// Test snippets using stored term offsets.
+DEFINE_TESTCASE(snippetoffsets1, generated) {
+    Xapian::Database db = get_database("snippetoffsets", make_offsets_db, "");
+    Xapian::Enquire enquire(db);
+    Xapian::Stem stem("en");
+
+    static const char * const expect[] = {
+	"...<b>rubbish</b> <b>examples</b> are at the end. Nothing...",
+	"<b>Rubbish</b> <b>examples</b>..."
+    };
+    // Unstemmed, stemmed and phrase queries.
+    Xapian::Query queries[] = {
+	Xapian::Query("rubbish") | Xapian::Query("examples"),
+	Xapian::Query("Zrubbish") | Xapian::Query("Zexampl"),
+	Xapian::Query(Xapian::Query::OP_PHRASE,
+		      Xapian::Query("rubbish"), Xapian::Query("examples"))
+    };
+    for (auto&& query : queries) {
+	enquire.set_query(query);
+	Xapian::MSet mset = enquire.get_mset(0, 10);
+	TEST_EQUAL(mset.size(), 2);
+	for (Xapian::doccount i = 0; i != mset.size(); ++i) {
+	    Xapian::docid did = *mset[i];
+	    const string & text = mset[i].get_document().get_data();
+	    string result = mset.snippet(text, did, 0, 40, stem);
+	    TEST_STRINGS_EQUAL(result, mset.snippet(text, 40, stem));
+	    if (&query == &queries[0])
+		TEST_STRINGS_EQUAL(result, expect[did - 1]);
+	}
+    }
+
+    // Check the stored offsets are actually used: only the text around them
+    // is looked at, so query terms elsewhere aren't considered.
+    enquire.set_query(queries[0]);
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    string text = db.get_document(1).get_data();
+    text.replace(0, 25, "Rubbish examples rubbish.");
+    TEST(mset.snippet(text, 1, 0, 40, stem).find("at the end") != string::npos);
+    TEST(mset.snippet(text, 40, stem).find("at the end") == string::npos);
+
+    return true;
+}
+
+static void
+make_offsets_z_db(Xapian::WritableDatabase &db, const string &)
+{
+    Xapian::TermGenerator tg;
+    tg.set_stemmer(Xapian::Stem("en"));
+    tg.set_stemming_strategy(tg.STEM_ALL_Z);
+    tg.set_offsets_slot(0);
+    string filler;
+    for (int i = 0; i != 200; ++i) {
+	filler += "Nothing to see here, move along. ";
+    }
+
+    Xapian::Document doc;
+    tg.set_document(doc);
+    string text = filler + "The rubbish examples are at the end. " + filler;
+    tg.index_text(text);
+    doc.set_data(text);
+    db.add_document(doc);
+
+    // Add a document without the query terms so they get a positive weight.
+    doc = Xapian::Document();
+    tg.set_document(doc);
+    tg.index_text(filler);
+    doc.set_data(filler);
+    db.add_document(doc);
+}
+
+/// Test snippets using stored term offsets with STEM_ALL_Z.
+DEFINE_TESTCASE(snippetoffsets2, generated) {
+    Xapian::Database db = get_database("snippetoffsetsz", make_offsets_z_db,
+				       "");
+    Xapian::Enquire enquire(db);
+    Xapian::Stem stem("en");
+
+    // With STEM_ALL_Z, only the 'Z' stems have positions, and phrases are
+    // of 'Z' stems too.
+    Xapian::Query queries[] = {
+	Xapian::Query("Zrubbish") | Xapian::Query("Zexampl"),
+	Xapian::Query(Xapian::Query::OP_PHRASE,
+		      Xapian::Query("Zrubbish"), Xapian::Query("Zexampl"))
+    };
+    static const char * const expect[] = {
+	"The <b>rubbish</b> <b>examples</b> are at the end.",
+	"The <b>rubbish examples</b> are at the end."
+    };
+    for (size_t i = 0; i != sizeof(queries) / sizeof(queries[0]); ++i) {
+	enquire.set_query(queries[i]);
+	Xapian::MSet mset = enquire.get_mset(0, 10);
+	TEST_EQUAL(mset.size(), 1);
+	const string & text = mset[0].get_document().get_data();
+	string result = mset.snippet(text, 1, 0, 40, stem);
+	TEST_STRINGS_EQUAL(result, mset.snippet(text, 40, stem));
+	TEST_STRINGS_EQUAL(result, expect[i]);
+
+	// Check the stored offsets are actually used.
+	string changed = text;
+	changed.replace(0, 35, "Rubbish examples; rubbish examples.");
+	TEST(mset.snippet(changed, 1, 0, 40, stem).find("at the end") !=
+	     string::npos);
+	TEST(mset.snippet(changed, 40, stem).find("at the end") ==
+	     string::npos);
+    }
+
+    return true;
+}
+
 /// Test snippet term diversity.
 DEFINE_TESTCASE(snippet_termcover1, backend) {
     static const snippet_testcase testcases[] = {
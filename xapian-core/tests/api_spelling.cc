@@ -94,9 +94,10 @@ DEFINE_TESTCASE(spell1, spelling) {
     db.add_spelling("ch");
     // Transpositions:
     TEST_EQUAL(db.get_spelling_suggestion("hc"), "ch");
-    // Substitutions - we don't handle these for two character words:
-    TEST_EQUAL(db.get_spelling_suggestion("qh"), "");
-    TEST_EQUAL(db.get_spelling_suggestion("cq"), "");
+    // Substitutions - the trigram index can't find these for two character
+    // words, but the deletion index can:
+    TEST_EQUAL(db.get_spelling_suggestion("qh"), "ch");
+    TEST_EQUAL(db.get_spelling_suggestion("cq"), "ch");
     // Deletions would leave a single character, and we don't handle those.
     TEST_EQUAL(db.get_spelling_suggestion("c"), "");
     TEST_EQUAL(db.get_spelling_suggestion("h"), "");
@@ -314,3 +315,38 @@ DEFINE_TESTCASE(spell8, spelling) {
 
     return true;
 }
+
+/// Test suggestions found using the deletion index.
+DEFINE_TESTCASE(spell9, spelling) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    db.add_spelling("cat", 2);
+    db.add_spelling("cot");
+    db.add_spelling("\xc3\xa9t\xc3\xa9");
+    db.add_spelling("ox");
+    // Check uncommitted changes are used.
+    TEST_EQUAL(db.get_spelling_suggestion("cut"), "cat");
+    TEST_EQUAL(db.get_spelling_suggestion("cut", 1), "cat");
+    db.commit();
+    Xapian::Database dbr(get_writable_database_as_database());
+    TEST_EQUAL(dbr.get_spelling_suggestion("cut"), "cat");
+    TEST_EQUAL(dbr.get_spelling_suggestion("cat"), "");
+    TEST_EQUAL(dbr.get_spelling_suggestion("cot"), "cat");
+    // Substitution of a multi-byte character is a single edit.
+    TEST_EQUAL(dbr.get_spelling_suggestion("\xc3\xa9t\xc3\xa8", 1),
+	       "\xc3\xa9t\xc3\xa9");
+    TEST_EQUAL(dbr.get_spelling_suggestion("xo", 1), "ox");
+    TEST_EQUAL(dbr.get_spelling_suggestion("o", 1), "");
+    TEST_EQUAL(dbr.get_spelling_suggestion("cut", 0), "");
+
+    // Removing a word must remove it from the deletion index.
+    db.remove_spelling("cat", 2);
+    TEST_EQUAL(db.get_spelling_suggestion("cut"), "cot");
+    db.remove_spelling("cot");
+    db.commit();
+    TEST_EQUAL(db.get_spelling_suggestion("cut", 1), "");
+    db.add_spelling("cot");
+    TEST_EQUAL(db.get_spelling_suggestion("cut", 1), "cot");
+
+    return true;
+}
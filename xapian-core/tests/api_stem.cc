@@ -104,6 +104,60 @@ DEFINE_TESTCASE(stemempty1, !backend) {
     return true;
 }
 
+/// Test Stem::set_cache_size().
+DEFINE_TESTCASE(stemcache1, !backend) {
+    Xapian::Stem st("english");
+    TEST_EQUAL(st.get_cache_hits(), 0);
+    TEST_EQUAL(st.get_cache_misses(), 0);
+    string desc = st.get_description();
+
+    st.set_cache_size(4);
+    TEST_EQUAL(st.get_description(), desc);
+    TEST_EQUAL(st("loving"), "love");
+    TEST_EQUAL(st("loving"), "love");
+    TEST_EQUAL(st("cats"), "cat");
+    TEST_EQUAL(st.get_cache_hits(), 1);
+    TEST_EQUAL(st.get_cache_misses(), 2);
+
+    // Copies share the cache, so TermGenerator uses it.
+    Xapian::TermGenerator tg;
+    Xapian::Document doc;
+    tg.set_document(doc);
+    tg.set_stemmer(st);
+    tg.index_text("cats loving cats");
+    TEST_EQUAL(st.get_cache_hits(), 4);
+    TEST_EQUAL(st.get_cache_misses(), 2);
+    TEST_EQUAL(doc.termlist_count(), 4);
+
+    // Check eviction doesn't change the results.
+    static const char * const words[] = {
+	"running", "jumped", "cats", "happily", "generously", "loving",
+	"stemming", "cats", "running", "loving", NULL
+    };
+    Xapian::Stem uncached("english");
+    for (const char * const * w = words; *w; ++w) {
+	TEST_EQUAL(st(*w), uncached(*w));
+    }
+    TEST_EQUAL(st.get_cache_hits() + st.get_cache_misses(), 16);
+
+    // Empty words don't reach the stemmer, so aren't counted.
+    TEST_EQUAL(st(string()), string());
+    TEST_EQUAL(st.get_cache_hits() + st.get_cache_misses(), 16);
+
+    st.set_cache_size(0);
+    TEST_EQUAL(st.get_cache_hits(), 0);
+    TEST_EQUAL(st("loving"), "love");
+    TEST_EQUAL(st.get_description(), desc);
+
+    // Enabling a cache on a "none" stemmer does nothing.
+    Xapian::Stem none;
+    none.set_cache_size(10);
+    TEST_EQUAL(none("cats"), "cats");
+    TEST_EQUAL(none.get_cache_misses(), 0);
+
+    return true;
+}
+
 /// Test invalid language names with various characters in.
 DEFINE_TESTCASE(stemlangs2, !backend) {
     string lang("xdummy");
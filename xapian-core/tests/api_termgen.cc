@@ -878,3 +878,33 @@ DEFINE_TESTCASE(tg_max_word_length1, !backend) {
 
     return true;
 }
+
+/// Test segmenting CJK text into words with a dictionary.
+DEFINE_TESTCASE(tg_segmenter1, !backend) {
+    Xapian::DictionaryWordSegmenter seg;
+    seg.add("北京");
+    seg.add("北京大学");
+    seg.add("大学");
+    seg.add("学生");
+    TEST_EQUAL(seg.get_description(),
+	       "Xapian::DictionaryWordSegmenter(4 words)");
+
+    vector<string> words;
+    seg("北京大学生", words);
+    TEST_EQUAL(words.size(), 2);
+    TEST_STRINGS_EQUAL(words[0], "北京大学");
+    TEST_STRINGS_EQUAL(words[1], "生");
+
+    Xapian::TermGenerator termgen;
+    termgen.set_segmenter(&seg);
+    Xapian::Document doc;
+    termgen.set_document(doc);
+
+    // The segmenter takes precedence over FLAG_CJK_NGRAM.
+    termgen.set_flags(termgen.FLAG_CJK_NGRAM);
+    termgen.index_text("我在北京大学 hello学生");
+    TEST_STRINGS_EQUAL(format_doc_termlist(doc),
+		       "hello[4] 北京大学[3] 在[2] 学生[5] 我[1]");
+
+    return true;
+}
@@ -503,5 +503,10 @@ DEFINE_TESTCASE(unicodepredicates1, !backend) {
 	TEST(!Xapian::Unicode::is_whitespace(*p));
     }
 
+    // is_wordchar() has a fast path for ASCII, so check all of it.
+    for (unsigned ch = 0; ch < 128; ++ch) {
+	TEST_EQUAL(Xapian::Unicode::is_wordchar(ch), bool(isalnum(ch) || ch == '_'));
+    }
+
     return true;
 }
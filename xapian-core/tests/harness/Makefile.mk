@@ -12,6 +12,7 @@ noinst_HEADERS +=\
 	harness/backendmanager_remotetcp.h\
 	harness/backendmanager_singlefile.h\
 	harness/cputimer.h\
+	harness/envvar.h\
 	harness/fdtracker.h\
 	harness/index_utils.h\
 	harness/unixcmds.h\
@@ -25,6 +26,7 @@ testharness_sources =\
 	harness/backendmanager.cc\
 	harness/backendmanager_multi.cc\
 	harness/cputimer.cc\
+	harness/envvar.cc\
 	harness/fdtracker.cc\
 	harness/index_utils.cc\
 	harness/scalability.cc\
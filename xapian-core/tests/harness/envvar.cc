@@ -0,0 +1,53 @@
+/** @file envvar.cc
+ * @brief Set environment variables portably.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "envvar.h"
+
+#include <cstdlib>
+#ifndef HAVE__PUTENV_S
+# ifndef HAVE_SETENV
+#  include <cstring>
+#  include <map>
+#  include <memory>
+# endif
+#endif
+
+using namespace std;
+
+void
+set_env_var(const char * name, const string & value)
+{
+#ifdef HAVE__PUTENV_S
+    _putenv_s(name, value.c_str());
+#elif defined HAVE_SETENV
+    setenv(name, value.c_str(), 1);
+#else
+    // putenv() keeps a pointer to the string we pass, so it has to stay
+    // valid until the variable is next set.
+    static map<string, unique_ptr<char[]>> buffers;
+    string setting(name);
+    setting += '=';
+    setting += value;
+    unique_ptr<char[]> buf(new char[setting.size() + 1]);
+    memcpy(buf.get(), setting.c_str(), setting.size() + 1);
+    putenv(buf.get());
+    buffers[name] = std::move(buf);
+#endif
+}
@@ -0,0 +1,30 @@
+/** @file envvar.h
+ * @brief Set environment variables portably.
+ */
+/* This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_ENVVAR_H
+#define XAPIAN_INCLUDED_ENVVAR_H
+
+#include <string>
+
+/** Set environment variable @a name to @a value.
+ *
+ *  Uses _putenv_s() or setenv() if available, and otherwise putenv().
+ */
+void set_env_var(const char * name, const std::string & value);
+
+#endif // XAPIAN_INCLUDED_ENVVAR_H
@@ -25,8 +25,13 @@
 #include <cfloat>
 #include <climits>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <vector>
 
 #include "safeunistd.h"
 
@@ -79,6 +84,9 @@ using namespace std;
 #include "../net/serialise-error.cc"
 #include "../api/error.cc"
 #include "../api/sortable-serialise.cc"
+#include "../api/editdistance.cc"
+#include "../common/docidbitmap.cc"
+#include "../common/sha256.cc"
 
 // Stub replacement, which doesn't deal with escaping or producing valid UTF-8.
 // The full implementation needs Xapian::Utf8Iterator and
@@ -575,6 +583,178 @@ static bool test_closefrom1()
     return true;
 }
 
+// Check the bit-parallel edit distance calculation against the original
+// algorithm.
+static bool test_editdistance1()
+{
+    // Use a small alphabet so that we get plenty of matches and
+    // transpositions, plus some characters which aren't < 256.
+    static const unsigned alphabet[] = { 'a', 'b', 'c', 0xe9, 0x4e00 };
+    const int alphabet_size = int(sizeof(alphabet) / sizeof(alphabet[0]));
+    srand(42);
+    for (int n = 0; n < 5000; ++n) {
+	vector<unsigned> a(rand() % 12), b(rand() % 12);
+	for (size_t i = 0; i != a.size(); ++i)
+	    a[i] = alphabet[rand() % alphabet_size];
+	for (size_t i = 0; i != b.size(); ++i)
+	    b[i] = alphabet[rand() % alphabet_size];
+	int maxlen = int(max(a.size(), b.size()));
+	const unsigned * pa = a.empty() ? alphabet : &a[0];
+	const unsigned * pb = b.empty() ? alphabet : &b[0];
+	int expect = edit_distance_unsigned(pa, int(a.size()),
+					    pb, int(b.size()), maxlen);
+	EditDistanceCalculator edcalc(b);
+	TEST_EQUAL(edcalc(pa, int(a.size()), maxlen), expect);
+	// With a lower limit, we should get a value above the limit if the
+	// true distance is above it.
+	for (int limit = 0; limit <= maxlen; ++limit) {
+	    int d = edcalc(pa, int(a.size()), limit);
+	    if (expect <= limit) {
+		TEST_EQUAL(d, expect);
+	    } else {
+		TEST(d > limit);
+	    }
+	}
+    }
+
+    // Check we handle targets too long for the bit-parallel approach.
+    vector<unsigned> a(100, 'a'), b(99, 'a');
+    b.push_back('b');
+    EditDistanceCalculator edcalc(b);
+    TEST_EQUAL(edcalc(&a[0], int(a.size()), 5), 1);
+    b.resize(64);
+    EditDistanceCalculator edcalc64(b);
+    TEST_EQUAL(edcalc64(&a[0], 64, 5), 0);
+    TEST_EQUAL(edcalc64(&a[0], 65, 5), 1);
+    return true;
+}
+
+// Build a DocIdBitmap with the docids in @a dids.
+static DocIdBitmap *
+make_bitmap(const set<Xapian::docid> & dids)
+{
+    DocIdBitmap * bitmap = new DocIdBitmap;
+    for (Xapian::docid did : dids) bitmap->append(did);
+    return bitmap;
+}
+
+// Check iterating @a bitmap with lower_bound() gives @a dids.
+static void
+check_bitmap(const DocIdBitmap & bitmap, const set<Xapian::docid> & dids)
+{
+    TEST_EQUAL(bitmap.size(), dids.size());
+    size_t hint = 0;
+    Xapian::docid did = 1;
+    for (Xapian::docid expect : dids) {
+	did = bitmap.lower_bound(did, hint);
+	TEST_EQUAL(did, expect);
+	// Don't wrap at the end of the docid space.
+	if (did == Xapian::docid(-1)) return;
+	++did;
+    }
+    TEST_EQUAL(bitmap.lower_bound(did, hint), 0);
+}
+
+// Test DocIdBitmap with sparse and dense chunks.
+static bool test_docidbitmap1()
+{
+    srand(42);
+    vector<set<Xapian::docid>> sets(4);
+    for (int n = 0; n < 200000; ++n) {
+	// A dense chunk, a sparse one, and one which is dense for one set
+	// and sparse for the others.
+	Xapian::docid did = rand() % 65536 + 1;
+	sets[0].insert(did);
+	if (n % 3 == 0) sets[1].insert(did);
+	if (n % 50 == 0) sets[2].insert(did + 0x30000);
+	if (n % 10 == 0) {
+	    sets[n % 20 ? 3 : 0].insert(did + 0x50000);
+	}
+    }
+    // A chunk right at the end of the docid space.
+    sets[1].insert(0xfffffff0);
+    sets[1].insert(0xffffffff);
+    sets[3].insert(0xffffffff);
+
+    vector<unique_ptr<DocIdBitmap>> bitmaps;
+    for (const set<Xapian::docid> & dids : sets) {
+	bitmaps.emplace_back(make_bitmap(dids));
+	check_bitmap(*bitmaps.back(), dids);
+    }
+
+    // Skipping forwards should find the next docid.
+    size_t hint = 0;
+    TEST_EQUAL(bitmaps[2]->lower_bound(0x20000, hint),
+	       *sets[2].lower_bound(0x20000));
+    TEST_EQUAL(bitmaps[2]->lower_bound(0x40000, hint), 0);
+
+    for (size_t a = 0; a != sets.size(); ++a) {
+	for (size_t b = 0; b != sets.size(); ++b) {
+	    const set<Xapian::docid> & sa = sets[a];
+	    const set<Xapian::docid> & sb = sets[b];
+	    set<Xapian::docid> expect;
+	    set_intersection(sa.begin(), sa.end(), sb.begin(), sb.end(),
+			     inserter(expect, expect.begin()));
+	    unique_ptr<DocIdBitmap> result(
+		DocIdBitmap::combine(*bitmaps[a], *bitmaps[b], DocIdBitmap::AND));
+	    check_bitmap(*result, expect);
+
+	    expect.clear();
+	    set_union(sa.begin(), sa.end(), sb.begin(), sb.end(),
+		      inserter(expect, expect.begin()));
+	    result.reset(
+		DocIdBitmap::combine(*bitmaps[a], *bitmaps[b], DocIdBitmap::OR));
+	    check_bitmap(*result, expect);
+
+	    expect.clear();
+	    set_difference(sa.begin(), sa.end(), sb.begin(), sb.end(),
+			   inserter(expect, expect.begin()));
+	    result.reset(DocIdBitmap::combine(*bitmaps[a], *bitmaps[b],
+					      DocIdBitmap::AND_NOT));
+	    check_bitmap(*result, expect);
+	}
+    }
+    return true;
+}
+
+static string
+sha256_hex(const string & data, size_t step)
+{
+    SHA256 sha;
+    for (size_t i = 0; i < data.size(); i += step)
+	sha.update(data.data() + i, min(step, data.size() - i));
+    string digest = sha.digest();
+    TEST_EQUAL(digest.size(), SHA256_DIGEST_LEN);
+    string result;
+    for (unsigned char ch : digest) {
+	result += "0123456789abcdef"[ch >> 4];
+	result += "0123456789abcdef"[ch & 0x0f];
+    }
+    return result;
+}
+
+/// Check SHA256 against the test vectors from FIPS 180-4.
+DEFINE_TESTCASE_(sha256_1) {
+    // Check feeding data in different sized pieces gives the same result.
+    static const size_t steps[] = { 1, 3, 63, 64, 65, 1000 };
+    for (size_t step : steps) {
+	TEST_EQUAL(sha256_hex(string(), step),
+		   "e3b0c44298fc1c149afbf4c8996fb924"
+		   "27ae41e4649b934ca495991b7852b855");
+	TEST_EQUAL(sha256_hex("abc", step),
+		   "ba7816bf8f01cfea414140de5dae2223"
+		   "b00361a396177a9cb410ff61f20015ad");
+	TEST_EQUAL(sha256_hex("abcdbcdecdefdefgefghfghighijhijk"
+			      "ijkljklmklmnlmnomnopnopq", step),
+		   "248d6a61d20638b8e5c026930c3e6039"
+		   "a33ce45964ff2167f6ecedd419db06c1");
+	TEST_EQUAL(sha256_hex(string(1000000, 'a'), step),
+		   "cdc76e5c9914fb9281a1c7e284d73e67"
+		   "f1809a48a497200e046d39ccc7112cd0");
+    }
+    return true;
+}
+
 static const test_desc tests[] = {
     TESTCASE(simple_exceptions_work1),
     TESTCASE(class_exceptions_work1),
@@ -590,6 +770,9 @@ static const test_desc tests[] = {
     TESTCASE(tostring1),
     TESTCASE(strbool1),
     TESTCASE(closefrom1),
+    TESTCASE(editdistance1),
+    TESTCASE(docidbitmap1),
+    TESTCASE(sha256_1),
     END_OF_TESTCASES
 };
 
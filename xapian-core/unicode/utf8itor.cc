@@ -109,7 +109,9 @@ Utf8Iterator::calculate_sequence_length() const XAPIAN_NOEXCEPT
     return true;
 }
 
-unsigned Utf8Iterator::operator*() const XAPIAN_NOEXCEPT {
+unsigned
+Utf8Iterator::get_char() const XAPIAN_NOEXCEPT
+{
     if (p == NULL) return unsigned(-1);
     if (seqlen == 0) calculate_sequence_length();
     unsigned char ch = *p;
@@ -126,6 +126,10 @@ BM25Weight::init(double factor)
     }
 
     LOGVALUE(WTCALC, len_factor);
+
+    denom_len_factor = param_k1 * param_b * len_factor;
+    denom_min_len = param_k1 * param_b * param_min_normlen;
+    denom_const = param_k1 * (1 - param_b);
 }
 
 string
@@ -165,10 +169,11 @@ BM25Weight::get_sumpart(Xapian::termcount wdf, Xapian::termcount len,
 			Xapian::termcount) const
 {
     LOGCALL(WTCALC, double, "BM25Weight::get_sumpart", wdf | len);
-    Xapian::doclength normlen = max(len * len_factor, param_min_normlen);
-
+    // This is k1 * (normlen * b + (1 - b)) + wdf, but with the document
+    // independent parts precomputed by init().
     double wdf_double = wdf;
-    double denom = param_k1 * (normlen * param_b + (1 - param_b)) + wdf_double;
+    double denom = max(len * denom_len_factor, denom_min_len) + denom_const +
+		   wdf_double;
     AssertRel(denom,>,0);
     RETURN(termweight * (wdf_double / denom));
 }
@@ -177,24 +182,22 @@ double
 BM25Weight::get_maxpart() const
 {
     LOGCALL(WTCALC, double, "BM25Weight::get_maxpart", NO_ARGS);
-    double denom = param_k1;
-    if (param_k1 != 0.0) {
-	if (param_b != 0.0) {
-	    // "Upper-bound Approximations for Dynamic Pruning" Craig
-	    // Macdonald, Nicola Tonellotto and Iadh Ounis. ACM Transactions on
-	    // Information Systems. 29(4), 2011 shows that evaluating at
-	    // doclen=wdf_max is a good bound.
-	    //
-	    // However, we can do better if doclen_min > wdf_max since then a
-	    // better bound can be found by simply evaluating at
-	    // doclen=doclen_min and wdf=wdf_max.
-	    Xapian::doclength normlen_lb =
-		 max(max(get_wdf_upper_bound(), get_doclength_lower_bound()) * len_factor, param_min_normlen);
-	    denom *= (normlen_lb * param_b + (1 - param_b));
-	}
-    }
+    // "Upper-bound Approximations for Dynamic Pruning" Craig Macdonald,
+    // Nicola Tonellotto and Iadh Ounis. ACM Transactions on Information
+    // Systems. 29(4), 2011 shows that evaluating at doclen=wdf_max is a good
+    // bound.
+    //
+    // However, we can do better if doclen_min > wdf_max since then a better
+    // bound can be found by simply evaluating at doclen=doclen_min and
+    // wdf=wdf_max.
+    //
+    // We evaluate the denominator in exactly the same way as get_sumpart()
+    // so that rounding can't make the bound smaller than an actual weight.
     double wdf_max = get_wdf_upper_bound();
-    denom += wdf_max;
+    Xapian::termcount len_lb = max(get_wdf_upper_bound(),
+				   get_doclength_lower_bound());
+    double denom = max(len_lb * denom_len_factor, denom_min_len) +
+		   denom_const + wdf_max;
     AssertRel(denom,>,0);
     RETURN(termweight * (wdf_max / denom));
 }